@@ -0,0 +1,288 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "concurrent.hh"
+
+#include <algorithm>
+#include <thread>
+#include <functional>
+
+namespace json {
+
+    ConcurrentDocument::Slot* ConcurrentDocument::Node::find(const TString &key) const {
+        std::vector<std::pair<TString,Slot*> >::const_iterator it = std::lower_bound(members.begin(),members.end(),key,Node::before);
+        return it != members.end() && it->first == key ? it->second : NULL;
+    }
+
+    ConcurrentDocument::Guard::Guard(const ConcurrentDocument &document) {
+        // threads start looking for a free announcement in different places
+        size_t i = std::hash<std::thread::id>()(std::this_thread::get_id()) % ANNOUNCEMENTS;
+        for (;; i = (i+1) % ANNOUNCEMENTS) {
+            uint64_t idle = 0, now = document.epoch.load();
+            if (!document.announcements[i].epoch.compare_exchange_strong(idle,now)) continue;
+            announcement = &document.announcements[i];
+            // the epoch may have advanced before the announcement was visible to collect
+            for (uint64_t next; (next = document.epoch.load()) != now; now = next) announcement->epoch.store(next);
+            return;
+        }
+    }
+
+    ConcurrentDocument::Guard::~Guard() {
+        announcement->epoch.store(0);
+    }
+
+    ConcurrentDocument::ConcurrentDocument(const Value &value) : root(build(value)), epoch(1) {
+        for (size_t i = 0; i < ANNOUNCEMENTS; i++) announcements[i].epoch.store(0);
+    }
+
+    ConcurrentDocument::~ConcurrentDocument() {
+        destroy(root.node.load());
+        for (size_t i = 0; i < garbage.size(); i++) {
+            delete garbage[i].node;
+            delete garbage[i].slot;
+        }
+    }
+
+    const ConcurrentDocument::Node* ConcurrentDocument::build(const Value &value) {
+        Node *node = new Node;
+        if (value.getType() != TOBJECT) {
+            node->leaf = new Frozen(value);
+            return node;
+        }
+        const std::vector<std::string> keys = value.getMembers();
+        node->members.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); i++) node->members.push_back(std::make_pair(keys[i],create(value[keys[i]])));
+        return node;
+    }
+
+    ConcurrentDocument::Slot* ConcurrentDocument::create(const Value &value) {
+        return new Slot(build(value));
+    }
+
+    void ConcurrentDocument::destroy(const Node *node) {
+        for (size_t i = 0; i < node->members.size(); i++) {
+            destroy(node->members[i].second->node.load());
+            delete node->members[i].second;
+        }
+        delete node;
+    }
+
+    Value ConcurrentDocument::read(const Node *node) {
+        if (node->leaf) return node->leaf->root().thaw();
+        Value object(TOBJECT);
+        for (size_t i = 0; i < node->members.size(); i++) {
+            const TString &key = node->members[i].first;
+            object.setMember(key.data(),key.size(),read(node->members[i].second->node.load()));
+        }
+        return object;
+    }
+
+    const ConcurrentDocument::Slot* ConcurrentDocument::walk(const Path &path, size_t &step, std::vector<Slot*> *ancestors) const {
+        const Slot *slot = &root;
+        if (ancestors) ancestors->push_back((Slot*)slot);
+        for (step = 0; step < path.steps.size(); step++) {
+            const Node *node = slot->node.load();
+            if (node->leaf || path.steps[step].isIndex) return slot;
+            const Slot *child = node->find(path.steps[step].key);
+            if (!child) return slot;
+            slot = child;
+            if (ancestors) ancestors->push_back((Slot*)slot);
+        }
+        return slot;
+    }
+
+    Value ConcurrentDocument::get(const Path &path, uint64_t *version) const {
+        Guard guard(*this);
+        for (;;) {
+            size_t step;
+            const Slot *slot = walk(path,step);
+            const uint64_t before = slot->version.load();
+            const Node *node = slot->node.load();
+            if (step < path.steps.size() && !node->leaf) {
+                // the member is missing, unless it was created since the walk
+                if (!path.steps[step].isIndex && node->find(path.steps[step].key)) continue;
+                if (version) *version = 0;
+                return Value();
+            }
+            if (node->leaf) {
+                // a frozen buffer is read whole with one pointer, so it needs no validation
+                if (version) *version = before;
+                if (step == path.steps.size()) return node->leaf->root().thaw();
+                Path rest("");
+                rest.steps.assign(path.steps.begin()+step,path.steps.end());
+                return node->leaf->root().resolve(rest).thaw();
+            }
+            Value result = read(node);
+            if (stable(before) && slot->version.load() == before) {
+                if (version) *version = before;
+                return result;
+            }
+        }
+    }
+
+    uint64_t ConcurrentDocument::getVersion(const Path &path) const {
+        Guard guard(*this);
+        size_t step;
+        const Slot *slot = walk(path,step);
+        if (step < path.steps.size() && !slot->node.load()->leaf) return 0;
+        return slot->version.load();
+    }
+
+    void ConcurrentDocument::set(const Path &path, const Value &value) {
+        set(path,value,false,0);
+    }
+
+    bool ConcurrentDocument::set(const Path &path, const Value &value, uint64_t expected) {
+        return set(path,value,true,expected);
+    }
+
+    bool ConcurrentDocument::set(const Path &path, const Value &value, bool conditional, uint64_t expected) {
+        for (size_t i = 0; i < path.steps.size(); i++) {
+            if (path.steps[i].isIndex) throw std::runtime_error("Elements of arrays in a ConcurrentDocument are set with their array");
+        }
+        Guard guard(*this);
+        for (;;) {
+            size_t step;
+            std::vector<Slot*> ancestors;
+            Slot *slot = (Slot*)walk(path,step,&ancestors);
+            std::unique_lock<std::mutex> hold(slot->lock);
+            if (slot->detached) continue; //an ancestor was replaced since the walk
+            const Node *node = slot->node.load();
+            if (step == path.steps.size()) {
+                lockBelow(node);
+                if (conditional && slot->version.load() != expected) {
+                    unlockBelow(node);
+                    return false;
+                }
+                begin(ancestors);
+                slot->node.store(build(value));
+                discardBelow(node);
+                retire(node,NULL);
+                end(ancestors);
+                return true;
+            }
+            if (node->leaf) throw std::runtime_error("Path crosses a value that is not an object");
+            if (node->find(path.steps[step].key)) continue; //created since the walk
+            if (conditional && expected) return false;
+            // missing objects on the way are created with the value
+            Value nested = value;
+            for (size_t i = path.steps.size()-1; i > step; i--) {
+                Value parent(TOBJECT);
+                parent.setMember(path.steps[i].key,nested);
+                nested = parent;
+            }
+            const TString &key = path.steps[step].key;
+            Node *copy = new Node;
+            copy->members = node->members;
+            copy->members.insert(std::lower_bound(copy->members.begin(),copy->members.end(),key,Node::before),std::make_pair(key,create(nested)));
+            begin(ancestors);
+            slot->node.store(copy);
+            retire(node,NULL);
+            end(ancestors);
+            return true;
+        }
+    }
+
+    bool ConcurrentDocument::erase(const Path &path) {
+        if (path.steps.empty()) throw std::runtime_error("The root of a ConcurrentDocument cannot be erased");
+        Guard guard(*this);
+        for (;;) {
+            size_t step;
+            std::vector<Slot*> ancestors;
+            walk(path,step,&ancestors);
+            if (step < path.steps.size()) return false;
+            Slot *target = ancestors.back();
+            ancestors.pop_back();
+            Slot *parent = ancestors.back();
+            std::unique_lock<std::mutex> hold(parent->lock);
+            if (parent->detached) continue;
+            const Node *node = parent->node.load();
+            if (node->leaf || node->find(path.steps.back().key) != target) continue; //changed since the walk
+            target->lock.lock();
+            const Node *removed = target->node.load();
+            lockBelow(removed);
+            Node *copy = new Node;
+            copy->members.reserve(node->members.size()-1);
+            for (size_t i = 0; i < node->members.size(); i++) {
+                if (node->members[i].second != target) copy->members.push_back(node->members[i]);
+            }
+            begin(ancestors);
+            parent->node.store(copy);
+            retire(node,NULL);
+            target->detached = true;
+            discardBelow(removed);
+            retire(removed,target);
+            target->lock.unlock();
+            end(ancestors);
+            return true;
+        }
+    }
+
+    void ConcurrentDocument::lockBelow(const Node *node) {
+        for (size_t i = 0; i < node->members.size(); i++) {
+            Slot *slot = node->members[i].second;
+            slot->lock.lock();
+            lockBelow(slot->node.load());
+        }
+    }
+
+    void ConcurrentDocument::unlockBelow(const Node *node) {
+        for (size_t i = 0; i < node->members.size(); i++) {
+            Slot *slot = node->members[i].second;
+            unlockBelow(slot->node.load());
+            slot->lock.unlock();
+        }
+    }
+
+    void ConcurrentDocument::discardBelow(const Node *node) {
+        for (size_t i = 0; i < node->members.size(); i++) {
+            Slot *slot = node->members[i].second;
+            const Node *child = slot->node.load();
+            slot->detached = true;
+            discardBelow(child);
+            retire(child,slot);
+            slot->lock.unlock(); //writers waiting for it see that it is detached
+        }
+    }
+
+    void ConcurrentDocument::retire(const Node *node, Slot *slot) {
+        std::lock_guard<std::mutex> hold(garbageLock);
+        Retired retired = { epoch.load(), node, slot };
+        garbage.push_back(retired);
+        if (garbage.size() >= 256) collect();
+    }
+
+    void ConcurrentDocument::collect() {
+        // anything retired before the oldest announced epoch was unlinked before that operation started
+        uint64_t oldest = epoch.fetch_add(1) + 1;
+        for (size_t i = 0; i < ANNOUNCEMENTS; i++) {
+            const uint64_t announced = announcements[i].epoch.load();
+            if (announced && announced < oldest) oldest = announced;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < garbage.size(); i++) {
+            if (garbage[i].epoch < oldest) {
+                delete garbage[i].node;
+                delete garbage[i].slot;
+            } else {
+                garbage[kept++] = garbage[i];
+            }
+        }
+        garbage.resize(kept);
+    }
+
+}
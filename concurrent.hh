@@ -0,0 +1,181 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_CONCURRENT
+#define _JSON_CONCURRENT
+
+#include "frozen.hh"
+
+#include <atomic>
+#include <mutex>
+
+namespace json {
+
+    //A document that many threads read and a few threads write at once. Objects are trees of slots, one per
+    //member, and every other value (including arrays) is an immutable frozen buffer held by its slot. Readers
+    //never take a lock: they follow atomic pointers and copy what they find. Writers lock only the slot they
+    //change (and the slots below it, which a replaced subtree discards), and publish a new object node or frozen
+    //buffer with a single pointer swap, so writers to different members do not wait for each other.
+    //
+    //Every slot has a version counting the writes that started and finished inside its subtree. A read of an
+    //object is validated against the version of its slot and retried if a write overlapped it, so it returns a
+    //state the subtree really had. The version a read returns can be passed to unchanged, or to the conditional
+    //set, to detect that anything below a path changed since then (optimistic concurrency).
+    //
+    //Memory of replaced nodes is reclaimed by epochs: a node is freed once every operation that might have seen
+    //it has finished. A Value passed in or returned is never shared with the document, so Values need not have
+    //atomic reference counts.
+    class ConcurrentDocument {
+        public:
+            // Starts with a copy of a Value (an empty object by default)
+            explicit ConcurrentDocument(const Value &root = Value(TOBJECT));
+
+            // Frees the document, which no thread may still be using
+            ~ConcurrentDocument();
+
+            // Returns a copy of the value at a path, or null if it does not exist. If version is not NULL it
+            // receives the version of the subtree that was read, or zero if it does not exist. Paths may index
+            // into arrays.
+            Value get(const Path &path, uint64_t *version = NULL) const;
+
+            // Returns the version of the subtree at a path, or zero if it does not exist
+            uint64_t getVersion(const Path &path) const;
+
+            // True if nothing was written in the subtree at a path since a read returned version, and no write
+            // was in progress then
+            inline bool unchanged(const Path &path, uint64_t version) const { return stable(version) && getVersion(path) == version; }
+
+            // Replaces or creates the value at a path of object members, creating missing objects on the way.
+            // Throws a runtime_error if the path crosses a value that is not an object or indexes an array.
+            void set(const Path &path, const Value &value);
+
+            // Sets the value at a path only if its version is still expected (zero to require that it does not
+            // exist), returning false otherwise
+            bool set(const Path &path, const Value &value, uint64_t expected);
+
+            // Removes the member at a path, returning false if it does not exist
+            bool erase(const Path &path);
+
+            // True if no write was in progress when version was read
+            static inline bool stable(uint64_t version) { return (version >> 32) == (version & 0xFFFFFFFF); }
+
+        protected:
+            struct Slot;
+
+            //An immutable value: the members of an object, or a frozen buffer
+            struct Node {
+                std::vector<std::pair<TString,Slot*> > members; //in key order
+                Frozen *leaf;                                   //NULL for objects
+
+                Node() : leaf(NULL) { }
+                ~Node() { delete leaf; }
+
+                Slot* find(const TString &key) const;
+
+                static inline bool before(const std::pair<TString,Slot*> &member, const TString &key) { return member.first < key; }
+            };
+
+            //A place holding a value. A slot is written only with its lock held, and a slot that was discarded
+            //with a replaced subtree is detached and never written again.
+            struct Slot {
+                std::mutex lock;
+                std::atomic<const Node*> node;
+                std::atomic<uint64_t> version;  //writes started in the high half, finished in the low half
+                bool detached;
+
+                Slot(const Node *node_) : node(node_), version(INITIAL), detached(false) { }
+            };
+
+            //The version of a new slot, which is never zero
+            static const uint64_t INITIAL = 0x100000001ull;
+
+            //Epochs announced by operations in progress (zero if the entry is free), a cache line each
+            struct Announcement {
+                std::atomic<uint64_t> epoch;
+                char padding[56];
+            };
+            static const size_t ANNOUNCEMENTS = 64;
+
+            //Announces an epoch for the life of an operation
+            class Guard {
+                public:
+                    Guard(const ConcurrentDocument &document);
+                    ~Guard();
+                protected:
+                    Announcement *announcement;
+            };
+
+            //A node or slot discarded in an epoch
+            struct Retired {
+                uint64_t epoch;
+                const Node *node;
+                Slot *slot;
+            };
+
+            Slot root;
+            mutable Announcement announcements[ANNOUNCEMENTS];
+            mutable std::atomic<uint64_t> epoch;
+            std::mutex garbageLock;
+            std::vector<Retired> garbage;
+
+            //Builds the nodes and slots of a Value
+            static const Node* build(const Value &value);
+            static Slot* create(const Value &value);
+
+            //Copies a node (and the slots below it) into a Value
+            static Value read(const Node *node);
+
+            //Returns the slot at the end of the object members of a path, the step where they end, and the
+            //slots on the way (the root first)
+            const Slot* walk(const Path &path, size_t &step, std::vector<Slot*> *ancestors = NULL) const;
+
+            //Locks and unlocks the slots below a node, outermost first
+            static void lockBelow(const Node *node);
+            static void unlockBelow(const Node *node);
+
+            //Detaches and retires the slots below a node, which are locked, unlocking them
+            void discardBelow(const Node *node);
+
+            //Shared by both forms of set
+            bool set(const Path &path, const Value &value, bool conditional, uint64_t expected);
+
+            void retire(const Node *node, Slot *slot);
+
+            //Frees what no operation in progress can still see
+            void collect();
+
+            //Frees a node and the slots below it, for the destructor
+            static void destroy(const Node *node);
+
+            //Version changes of a write, applied to the slot written and every slot above it
+            static inline void begin(const std::vector<Slot*> &slots) {
+                for (size_t i = 0; i < slots.size(); i++) slots[i]->version.fetch_add(1ull << 32);
+            }
+            static inline void end(const std::vector<Slot*> &slots) {
+                for (size_t i = 0; i < slots.size(); i++) {
+                    uint64_t version = slots[i]->version.load();
+                    while (!slots[i]->version.compare_exchange_weak(version,(version & 0xFFFFFFFF00000000ull) | ((version+1) & 0xFFFFFFFF)));
+                }
+            }
+
+            ConcurrentDocument(const ConcurrentDocument &other);
+            ConcurrentDocument& operator=(const ConcurrentDocument &other);
+    };
+
+}
+
+#endif
@@ -0,0 +1,336 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dbserver.hh"
+
+#include <fstream>
+#include <cerrno>
+#include <map>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace json {
+
+    static sockaddr_un socketAddress(const std::string &socket) {
+        sockaddr_un addr;
+        memset(&addr,0,sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socket.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Socket path too long: " + socket);
+        strcpy(addr.sun_path,socket.c_str());
+        return addr;
+    }
+
+    //Reads exactly size bytes, returning false on EOF or error
+    static bool readFully(int fd, char *buffer, size_t size) {
+        while (size) {
+            const ssize_t got = read(fd,buffer,size);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            buffer += got;
+            size -= got;
+        }
+        return true;
+    }
+
+    static bool writeFully(int fd, const char *buffer, size_t size) {
+        while (size) {
+            const ssize_t put = write(fd,buffer,size);
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) return false;
+            buffer += put;
+            size -= put;
+        }
+        return true;
+    }
+
+    //Writes to a socket whose peer may have gone away, failing with EPIPE rather than raising SIGPIPE
+    static bool sendFully(int fd, const char *buffer, size_t size) {
+        while (size) {
+            const ssize_t put = send(fd,buffer,size,MSG_NOSIGNAL);
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) return false;
+            buffer += put;
+            size -= put;
+        }
+        return true;
+    }
+
+    //Sends what a non-blocking socket accepts now from the front of output, returning false if the peer is gone
+    static bool flush(int fd, std::string &output) {
+        size_t sent = 0;
+        while (sent < output.size()) {
+            const ssize_t put = send(fd,output.data()+sent,output.size()-sent,MSG_NOSIGNAL);
+            if (put < 0 && errno == EINTR) continue;
+            if (put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (put <= 0) return false;
+            sent += put;
+        }
+        output.erase(0,sent);
+        return true;
+    }
+
+    //Bytes of responses a client may leave unread before the server stops reading its requests
+    static const size_t MAX_OUTPUT = 1 << 16;
+
+    DBServer::DBServer(const std::string &socket_) : socket(socket_), memfd(-1), tables(TOBJECT), frozen(NULL) {
+        const sockaddr_un addr = socketAddress(socket);
+        listener = ::socket(AF_UNIX,SOCK_STREAM,0);
+        if (listener < 0) throw std::runtime_error("Could not create socket");
+        unlink(socket.c_str());
+        if (bind(listener,(const sockaddr*)&addr,sizeof(addr)) || listen(listener,64)) {
+            close(listener);
+            throw std::runtime_error("Could not listen on " + socket);
+        }
+        if (pipe(wakeup)) {
+            close(listener);
+            throw std::runtime_error("Could not create wakeup pipe");
+        }
+    }
+
+    DBServer::~DBServer() {
+        close(listener);
+        close(wakeup[0]);
+        close(wakeup[1]);
+        if (memfd >= 0) close(memfd);
+        unlink(socket.c_str());
+        delete frozen;
+    }
+
+    void DBServer::load(const std::string &filename) {
+        std::ifstream file(filename.c_str());
+        if (!file) throw std::runtime_error("Could not open " + filename);
+        Reader reader(file);
+        reader.setPrediction(true);
+        Value value;
+        while (reader.getValue(value)) {
+            if (value.getType() == TOBJECT && value.isMember("name")) add(value);
+        }
+    }
+
+    void DBServer::add(const Value &table) {
+        if (frozen) throw std::runtime_error("Cannot add tables to a frozen database");
+        const std::string name = table["name"].cast<std::string>();
+        const std::string index = table.isMember("index") ? table["index"].cast<std::string>() : "";
+        if (!tables.isMember(name)) tables[name] = Value(TOBJECT);
+        tables[name][index] = table;
+    }
+
+    void DBServer::freeze() {
+        if (frozen) return;
+        frozen = new Frozen(tables);
+        tables.reset(TOBJECT);
+        memfd = memfd_create("fastjson-db",MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        //sealed so that no client can write to or resize the database the others have mapped
+        if (memfd < 0 || !writeFully(memfd,frozen->bytes(),frozen->size())
+            || fcntl(memfd,F_ADD_SEALS,F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+            throw std::runtime_error("Could not create shared database");
+        }
+    }
+
+    FrozenValue DBServer::lookup(const std::string &name, const std::string &index, const std::string &path, DBStatus &status) const {
+        if (!frozen) throw std::runtime_error("Lookup in a DBServer before it is frozen");
+        FrozenValue table = frozen->root().getMember(name);
+        if (table.getType() == TOBJECT) table = table.getMember(index);
+        if (table.getType() != TOBJECT) {
+            status = DBMISSING;
+            return FrozenValue();
+        }
+        try {
+            const FrozenValue result = table.resolve(Path(path));
+            status = result.getType() == TNULL ? DBMISSING : DBFOUND;
+            return result;
+        } catch (std::runtime_error &e) {
+            status = DBBADPATH;
+            return FrozenValue();
+        }
+    }
+
+    void DBServer::run() {
+        freeze();
+        std::vector<pollfd> fds(2);
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakeup[0];
+        fds[1].events = POLLIN;
+        std::map<int,std::string> pending, output; //partial requests and unsent responses by client
+        for (;;) {
+            for (size_t i = 0; i < fds.size(); i++) fds[i].revents = 0;
+            if (poll(&fds[0],fds.size(),-1) < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Poll failed in DBServer");
+            }
+            if (fds[1].revents) break;
+            for (size_t i = 2; i < fds.size(); i++) {
+                if (!fds[i].revents) continue;
+                const int client = fds[i].fd;
+                std::string &data = pending[client], &responses = output[client];
+                bool ok = true;
+                if (fds[i].events & POLLIN) {
+                    char buffer[4096];
+                    const ssize_t got = read(client,buffer,sizeof(buffer));
+                    if (got > 0) {
+                        data.append(buffer,got);
+                    } else if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                        ok = false;
+                    }
+                }
+                size_t done = 0;
+                uint32_t length;
+                while (ok && data.size() - done >= sizeof(length)) {
+                    memcpy(&length,&data[done],sizeof(length));
+                    if (length > MAX_REQUEST) { //never buffered, so a client cannot hold the server's memory
+                        ok = false;
+                        break;
+                    }
+                    if (data.size() - done < sizeof(length) + length) break;
+                    const char *request = &data[done+sizeof(length)];
+                    const char *index = (const char*)memchr(request,'\0',length);
+                    const char *path = index ? (const char*)memchr(index+1,'\0',request+length-index-1) : NULL;
+                    DBResponse response;
+                    memset(&response,0,sizeof(response));
+                    if (path) {
+                        DBStatus status;
+                        response.slot = lookup(std::string(request,index),std::string(index+1,path),std::string(path+1,request+length),status).getSlot();
+                        response.status = status;
+                    } else {
+                        response.status = DBBADPATH;
+                    }
+                    responses.append((const char*)&response,sizeof(response));
+                    done += sizeof(length) + length;
+                }
+                data.erase(0,done);
+                //a client that does not read its responses waits alone while the others are served
+                ok = ok && flush(client,responses);
+                if (!ok) {
+                    pending.erase(client);
+                    output.erase(client);
+                    close(client);
+                    fds.erase(fds.begin()+i--);
+                    continue;
+                }
+                fds[i].events = responses.size() >= MAX_OUTPUT ? POLLOUT : responses.empty() ? POLLIN : POLLIN | POLLOUT;
+            }
+            if (fds[0].revents) {
+                const int client = accept(listener,NULL,NULL);
+                if (client < 0) continue;
+                //send the database size with the shared memory descriptor attached
+                uint64_t size = frozen->size();
+                iovec iov = { &size, sizeof(size) };
+                char control[CMSG_SPACE(sizeof(int))];
+                memset(control,0,sizeof(control));
+                msghdr msg;
+                memset(&msg,0,sizeof(msg));
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+                memcpy(CMSG_DATA(cmsg),&memfd,sizeof(int));
+                if (sendmsg(client,&msg,MSG_NOSIGNAL) != sizeof(size)) {
+                    close(client);
+                    continue;
+                }
+                if (fcntl(client,F_SETFL,fcntl(client,F_GETFL) | O_NONBLOCK)) {
+                    close(client);
+                    continue;
+                }
+                pollfd entry = { client, POLLIN, 0 };
+                fds.push_back(entry);
+            }
+        }
+        char drain;
+        if (read(wakeup[0],&drain,1) < 0) { } //consume the wakeup so run() may be called again
+        for (size_t i = 2; i < fds.size(); i++) close(fds[i].fd);
+    }
+
+    void DBServer::stop() {
+        const char wake = 0;
+        if (write(wakeup[1],&wake,1) < 0) { } //nothing more can be done from a signal handler
+    }
+
+    DBClient::DBClient(const std::string &socket) : database(NULL) {
+        const sockaddr_un addr = socketAddress(socket);
+        fd = ::socket(AF_UNIX,SOCK_STREAM,0);
+        if (fd < 0) throw std::runtime_error("Could not create socket");
+        if (connect(fd,(const sockaddr*)&addr,sizeof(addr))) {
+            close(fd);
+            throw std::runtime_error("Could not connect to " + socket);
+        }
+        uint64_t size;
+        iovec iov = { &size, sizeof(size) };
+        char control[CMSG_SPACE(sizeof(int))];
+        msghdr msg;
+        memset(&msg,0,sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr *cmsg;
+        if (recvmsg(fd,&msg,0) != sizeof(size) || !(cmsg = CMSG_FIRSTHDR(&msg)) || cmsg->cmsg_type != SCM_RIGHTS) {
+            close(fd);
+            throw std::runtime_error("Did not receive database from " + socket);
+        }
+        int memfd;
+        memcpy(&memfd,CMSG_DATA(cmsg),sizeof(int));
+        try {
+            database = new Frozen(Frozen::map(memfd));
+        } catch (...) {
+            close(memfd);
+            close(fd);
+            throw;
+        }
+        close(memfd);
+    }
+
+    DBClient::~DBClient() {
+        close(fd);
+        delete database;
+    }
+
+    FrozenValue DBClient::lookup(const std::string &name, const std::string &index, const std::string &path) {
+        const size_t length = name.size() + index.size() + path.size() + 2;
+        if (length > DBServer::MAX_REQUEST) throw std::runtime_error("Lookup request too long for DBServer");
+        const uint32_t announced = length;
+        request.resize(sizeof(announced));
+        memcpy(&request[0],&announced,sizeof(announced));
+        request.append(name);
+        request.push_back('\0');
+        request.append(index);
+        request.push_back('\0');
+        request.append(path);
+        DBResponse response;
+        if (!sendFully(fd,request.data(),request.size()) || !readFully(fd,(char*)&response,sizeof(response))) {
+            throw std::runtime_error("Lost connection to DBServer");
+        }
+        switch (response.status) {
+            case DBFOUND:
+                return FrozenValue(database->bytes(),response.slot);
+            case DBMISSING:
+                return FrozenValue();
+            default:
+                throw std::runtime_error("Malformed lookup path " + path);
+        }
+    }
+
+}
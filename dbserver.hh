@@ -0,0 +1,105 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_DBSERVER
+#define _JSON_DBSERVER
+
+#include "frozen.hh"
+
+namespace json {
+
+    //Status codes of a DBServer lookup
+    enum DBStatus {
+        DBFOUND,
+        DBMISSING,
+        DBBADPATH
+    };
+
+    //Answers table lookups from local processes over a Unix domain socket. The tables are frozen once into a
+    //sealed shared memory file that each client maps read-only when it connects, so a lookup response is only the
+    //slot of the result and clients read tables in place.
+    //
+    //Protocol: on connect the server sends the database size with the shared memory descriptor attached. Each
+    //request is a uint32_t length followed by "name\0index\0path", and each response is a DBResponse. A client
+    //that announces a request longer than MAX_REQUEST is disconnected, and one that leaves its responses unread
+    //has its further requests left waiting, without delaying other clients.
+    class DBServer {
+        public:
+            static const uint32_t MAX_REQUEST = 1 << 16;
+
+            // Listens on the given socket path (an existing socket file is replaced)
+            DBServer(const std::string &socket);
+
+            ~DBServer();
+
+            // Parses a RATDB/JSON file and adds every object with a "name" member as a table
+            void load(const std::string &filename);
+
+            // Adds a table, keyed by its "name" and optional "index" members
+            void add(const Value &table);
+
+            // Freezes the tables into shared memory (done by run if needed). No tables can be added afterwards.
+            void freeze();
+
+            // Serves clients until stop() is called
+            void run();
+
+            // Makes run() return (safe to call from another thread or a signal handler)
+            void stop();
+
+            // Looks up a table or a path within it in the frozen database as a client would (throws a runtime_error
+            // before freeze)
+            FrozenValue lookup(const std::string &name, const std::string &index, const std::string &path, DBStatus &status) const;
+
+        protected:
+            std::string socket;
+            int listener, wakeup[2], memfd;
+
+            // Tables by name then index
+            Value tables;
+            Frozen *frozen;
+    };
+
+    struct DBResponse {
+        uint32_t status;
+        uint32_t reserved;
+        FrozenSlot slot;
+    };
+
+    //Connects to a DBServer and maps its database
+    class DBClient {
+        public:
+            DBClient(const std::string &socket);
+
+            ~DBClient();
+
+            // Returns a table (or the Value at path inside it) viewed in the shared database, or a null view if the
+            // table or path does not exist. Throws a runtime_error for malformed paths or a broken connection.
+            FrozenValue lookup(const std::string &name, const std::string &index = "", const std::string &path = "");
+
+        protected:
+            int fd;
+            Frozen *database;
+            std::string request;
+
+            DBClient(const DBClient &other);
+            DBClient& operator=(const DBClient &other);
+    };
+
+}
+
+#endif
@@ -0,0 +1,435 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "extsort.hh"
+#include "frozen.hh"
+#include "tokenizer.hh"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <queue>
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+
+namespace json {
+
+    //Kinds of keys in sort order, as IndexKey orders them
+    enum SortKind { KNULL = 0, KBOOL = 1, KNUMBER = 2, KSTRING = 3 };
+
+    struct SortKey {
+        uint8_t kind;
+        long double number;
+        std::string string;
+
+        SortKey() : kind(KNULL), number(0) { }
+    };
+
+    static SortKey sortKey(const Value &value) {
+        SortKey key;
+        switch (value.getType()) {
+            case TINTEGER:
+                key.kind = KNUMBER;
+                key.number = value.getInteger();
+                break;
+            case TUINTEGER:
+                key.kind = KNUMBER;
+                key.number = value.getUInteger();
+                break;
+            case TREAL:
+                key.kind = KNUMBER;
+                key.number = value.getReal();
+                break;
+            case TBOOL:
+                key.kind = KBOOL;
+                key.number = value.getBool();
+                break;
+            case TSTRING:
+                key.kind = KSTRING;
+                key.string = value.getString();
+                break;
+            default:
+                break;
+        }
+        return key;
+    }
+
+    static inline int compareKeys(const SortKey &a, const SortKey &b) {
+        if (a.kind != b.kind) return a.kind < b.kind ? -1 : 1;
+        if (a.kind == KSTRING) return a.string.compare(b.string);
+        if (std::isnan(a.number) || std::isnan(b.number)) return std::isnan(a.number) - std::isnan(b.number); //NaN last
+        return a.number < b.number ? -1 : (b.number < a.number ? 1 : 0);
+    }
+
+    //A run is a file of records in key order, each
+    //  uint8_t kind, then a long double (KBOOL, KNUMBER) or a uint32_t length and bytes (KSTRING)
+    //  uint64_t size, then size bytes of a frozen buffer padded to a multiple of 8
+    static void writeRecord(std::ostream &out, const SortKey &key, const char *frozen, uint64_t size) {
+        out.put((char)key.kind);
+        if (key.kind == KBOOL || key.kind == KNUMBER) {
+            out.write((const char*)&key.number,sizeof(key.number));
+        } else if (key.kind == KSTRING) {
+            const uint32_t length = key.string.size();
+            out.write((const char*)&length,sizeof(length));
+            out.write(key.string.data(),length);
+        }
+        out.write((const char*)&size,sizeof(size));
+        out.write(frozen,size);
+        static const char padding[8] = { 0 };
+        out.write(padding,(8 - size % 8) % 8);
+    }
+
+    //Reads the records of a run one at a time into an aligned buffer
+    class RunReader {
+        public:
+            RunReader(const std::string &filename) : in(filename.c_str(), std::ios::binary) {
+                if (!in) throw std::runtime_error("Could not open sort run " + filename);
+            }
+
+            //Reads the next record, returning false at the end of the run
+            bool next() {
+                int kind = in.get();
+                if (kind == EOF) return false;
+                key.kind = kind;
+                if (kind == KBOOL || kind == KNUMBER) {
+                    in.read((char*)&key.number,sizeof(key.number));
+                } else if (kind == KSTRING) {
+                    uint32_t length;
+                    in.read((char*)&length,sizeof(length));
+                    key.string.resize(length);
+                    if (length) in.read(&key.string[0],length);
+                }
+                in.read((char*)&size,sizeof(size));
+                if (!in) throw std::runtime_error("Corrupt sort run");
+                const size_t padded = (size + 7) / 8;
+                if (words.size() < padded) words.resize(padded);
+                in.read((char*)words.data(),padded*8);
+                if (!in) throw std::runtime_error("Truncated sort run");
+                return true;
+            }
+
+            inline const char* bytes() const { return (const char*)words.data(); }
+            inline FrozenValue value() const { return Frozen::view(bytes(),size); }
+
+            SortKey key;
+            uint64_t size;
+
+        protected:
+            std::ifstream in;
+            std::vector<uint64_t> words;
+    };
+
+    //Orders the heads of runs for a merge, breaking ties by run so equal keys keep their input order
+    struct RunOrder {
+        const std::vector<RunReader*> &readers;
+        const bool descending;
+
+        RunOrder(const std::vector<RunReader*> &readers_, bool descending_) : readers(readers_), descending(descending_) { }
+
+        //priority_queue puts the greatest first, so this is true when run a should come after run b
+        inline bool operator()(size_t a, size_t b) const {
+            int order = compareKeys(readers[a]->key,readers[b]->key);
+            if (descending) order = -order;
+            return order ? order > 0 : a > b;
+        }
+    };
+
+    static void putString(std::string &out, const char *text, size_t length) {
+        out += '"';
+        size_t last = 0;
+        for (size_t i = 0; i < length; i++) {
+            const unsigned char c = text[i];
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            out.append(text+last,i-last);
+            last = i+1;
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default: {
+                    char escape[8];
+                    snprintf(escape,sizeof(escape),"\\u%04x",c);
+                    out += escape;
+                }
+            }
+        }
+        out.append(text+last,length-last);
+        out += '"';
+    }
+
+    //Writes a frozen record as compact JSON. Keys are kept as they were read, as Writer does.
+    static void putValue(std::string &out, const FrozenValue &value) {
+        char text[32];
+        switch (value.getType()) {
+            case TINTEGER:
+                snprintf(text,sizeof(text),"%ld",value.getInteger());
+                out += text;
+                break;
+            case TUINTEGER:
+                snprintf(text,sizeof(text),"%lu",value.getUInteger());
+                out += text;
+                break;
+            case TREAL: {
+                    const TReal real = value.getReal();
+                    if (std::isinf(real) || std::isnan(real)) {
+                        out += "null";
+                        break;
+                    }
+                    snprintf(text,sizeof(text),"%.17g",real);
+                    if (!strpbrk(text,".e")) strcat(text,".0"); //stays a real when read back
+                    out += text;
+                }
+                break;
+            case TBOOL:
+                out += value.getBool() ? "true" : "false";
+                break;
+            case TSTRING:
+                putString(out,value.getChars(),value.getStringLength());
+                break;
+            case TOBJECT: {
+                    out += '{';
+                    const size_t count = value.getMemberCount();
+                    for (size_t i = 0; i < count; i++) {
+                        const char *key;
+                        size_t length;
+                        const FrozenValue member = value.getMemberAt(i,&key,&length);
+                        if (i) out += ',';
+                        out += '"';
+                        out.append(key,length);
+                        out += "\":";
+                        putValue(out,member);
+                    }
+                    out += '}';
+                }
+                break;
+            case TARRAY: {
+                    out += '[';
+                    const size_t size = value.getArraySize();
+                    for (size_t i = 0; i < size; i++) {
+                        if (i) out += ',';
+                        putValue(out,value.getIndex(i));
+                    }
+                    out += ']';
+                }
+                break;
+            case TNULL:
+                out += "null";
+        }
+    }
+
+    ExternalSort::ExternalSort(const SortOptions &options_) : options(options_), path(options_.key), records(0), created(0) {
+        if (!options.threads) options.threads = std::max(1u,std::thread::hardware_concurrency());
+        if (options.fanIn < 2) options.fanIn = 2;
+        // each thread holds a batch of text and its parsed Values, plus the batch being read
+        batchBytes = std::max<size_t>(options.memory / (4*(options.threads+1)), 4096);
+    }
+
+    ExternalSort::~ExternalSort() {
+        for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+        for (size_t i = 0; i < runs.size(); i++) unlink(runs[i].c_str());
+    }
+
+    std::string ExternalSort::runName() {
+        std::stringstream name;
+        name << options.directory << "/extsort." << getpid() << '.' << (void*)this << '.' << created++;
+        return name.str();
+    }
+
+    void ExternalSort::add(std::istream &in) {
+        Tokenizer tokens(in);
+        std::string record, batch;
+        while (tokens.nextRecord(record)) {
+            batch += record;
+            batch += '\n';
+            records++;
+            if (batch.size() >= batchBytes) submit(batch);
+        }
+        if (!batch.empty()) submit(batch);
+        finish();
+    }
+
+    void ExternalSort::submit(std::string &batch) {
+        if (workers.size() >= options.threads) {
+            workers.front().join();
+            workers.erase(workers.begin());
+        }
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            error = failed;
+        }
+        if (error) std::rethrow_exception(error); //no more batches once one has failed
+        runs.push_back(runName());
+        std::string text;
+        text.swap(batch);
+        workers.push_back(std::thread(&ExternalSort::sortBatch,this,std::move(text),runs.back()));
+    }
+
+    void ExternalSort::finish() {
+        for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+        workers.clear();
+        if (failed) std::rethrow_exception(failed);
+    }
+
+    void ExternalSort::sortBatch(std::string batch, std::string filename) {
+        try {
+            std::vector<Value> values;
+            std::vector<std::pair<SortKey,size_t> > keys;
+            {
+                Reader reader(batch);
+                reader.setPrediction(true);
+                Value value;
+                while (reader.getValue(value)) {
+                    keys.push_back(std::make_pair(sortKey(path.get(value)),values.size()));
+                    values.push_back(value);
+                }
+            }
+            std::string().swap(batch);
+            const bool descending = options.descending;
+            std::stable_sort(keys.begin(),keys.end(),[descending](const std::pair<SortKey,size_t> &a, const std::pair<SortKey,size_t> &b) {
+                return descending ? compareKeys(b.first,a.first) < 0 : compareKeys(a.first,b.first) < 0;
+            });
+            std::ofstream out(filename.c_str(), std::ios::binary);
+            for (size_t i = 0; i < keys.size(); i++) {
+                Frozen frozen(values[keys[i].second]);
+                writeRecord(out,keys[i].first,frozen.bytes(),frozen.size());
+                values[keys[i].second].reset(); //frees the record once it is written
+            }
+            out.close();
+            if (!out) throw std::runtime_error("Could not write sort run " + filename);
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!failed) failed = std::current_exception();
+        }
+    }
+
+    std::string ExternalSort::mergeRuns(size_t begin, size_t end) {
+        const std::string filename = runName();
+        std::ofstream out(filename.c_str(), std::ios::binary);
+        std::vector<RunReader*> readers;
+        try {
+            RunOrder order(readers,options.descending);
+            std::priority_queue<size_t,std::vector<size_t>,RunOrder> heads(order);
+            for (size_t i = begin; i < end; i++) {
+                readers.push_back(new RunReader(runs[i]));
+                if (readers.back()->next()) heads.push(readers.size()-1);
+            }
+            while (!heads.empty()) {
+                const size_t top = heads.top();
+                heads.pop();
+                RunReader &reader = *readers[top];
+                writeRecord(out,reader.key,reader.bytes(),reader.size);
+                if (reader.next()) heads.push(top);
+            }
+            out.close();
+            if (!out) throw std::runtime_error("Could not write sort run " + filename);
+        } catch (...) {
+            for (size_t i = 0; i < readers.size(); i++) delete readers[i];
+            unlink(filename.c_str());
+            throw;
+        }
+        for (size_t i = 0; i < readers.size(); i++) delete readers[i];
+        return filename;
+    }
+
+    size_t ExternalSort::write(std::ostream &out) {
+        finish();
+
+        // merge passes combine consecutive runs, keeping the runs in input order for stability
+        while (runs.size() > options.fanIn) {
+            std::vector<std::string> merged;
+            for (size_t i = 0; i < runs.size(); i += options.fanIn) {
+                const size_t end = std::min(i+options.fanIn,runs.size());
+                if (end - i == 1) {
+                    merged.push_back(runs[i]);
+                    runs[i].clear();
+                    continue;
+                }
+                merged.push_back(mergeRuns(i,end));
+                for (size_t j = i; j < end; j++) {
+                    unlink(runs[j].c_str());
+                    runs[j].clear();
+                }
+            }
+            runs.swap(merged);
+        }
+
+        std::vector<RunReader*> readers;
+        size_t written = 0;
+        try {
+            RunOrder order(readers,options.descending);
+            std::priority_queue<size_t,std::vector<size_t>,RunOrder> heads(order);
+            for (size_t i = 0; i < runs.size(); i++) {
+                readers.push_back(new RunReader(runs[i]));
+                if (readers.back()->next()) heads.push(readers.size()-1);
+            }
+            std::string text;
+            SortKey group;
+            size_t count = 0;
+            while (!heads.empty()) {
+                const size_t top = heads.top();
+                heads.pop();
+                RunReader &reader = *readers[top];
+                const FrozenValue record = reader.value();
+                if (options.group) {
+                    if (!count || compareKeys(reader.key,group)) {
+                        if (count) text += "],\"count\":" + std::to_string(count) + "}\n";
+                        text += "{\"key\":";
+                        if (reader.key.kind == KNULL) {
+                            text += "null";
+                        } else {
+                            putValue(text,record.resolve(path));
+                        }
+                        text += ",\"records\":[";
+                        group = reader.key;
+                        count = 0;
+                        written++;
+                    } else {
+                        text += ',';
+                    }
+                    count++;
+                    putValue(text,record);
+                } else {
+                    putValue(text,record);
+                    text += '\n';
+                    written++;
+                }
+                if (text.size() >= 1 << 20) {
+                    out.write(text.data(),text.size());
+                    text.clear();
+                }
+                if (reader.next()) heads.push(top);
+            }
+            if (count) text += "],\"count\":" + std::to_string(count) + "}\n";
+            out.write(text.data(),text.size());
+            out.flush();
+        } catch (...) {
+            for (size_t i = 0; i < readers.size(); i++) delete readers[i];
+            throw;
+        }
+        for (size_t i = 0; i < readers.size(); i++) delete readers[i];
+        for (size_t i = 0; i < runs.size(); i++) unlink(runs[i].c_str());
+        runs.clear();
+        return written;
+    }
+
+}
@@ -0,0 +1,104 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_EXTSORT
+#define _JSON_EXTSORT
+
+#include "json.hh"
+
+#include <istream>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <exception>
+
+namespace json {
+
+    struct SortOptions {
+        std::string key;            //path of the sort key in each record (see Path)
+        bool descending;
+        bool group;                 //write one {"key","records","count"} object per distinct key
+        size_t memory;              //approximate bytes of records held in memory by all threads together
+        size_t threads;             //threads generating runs (0 = all cores)
+        size_t fanIn;               //runs merged at once; more runs are merged in several passes
+        std::string directory;      //where runs are spilled
+
+        SortOptions(const std::string &key_ = "") : key(key_), descending(false), group(false), memory(1 << 28), threads(0), fanIn(128), directory("/tmp") { }
+    };
+
+    //Sorts streams of records (top level values, e.g. NDJSON or RATDB files) by a key field, using memory for
+    //a fraction of the records rather than all of them. Records are split from the input with a Tokenizer,
+    //parsed and sorted in batches on several threads, and spilled as runs of frozen records; write merges the
+    //runs into JSON with one record (or group) per line.
+    //
+    //Keys order as the indexes of Value::findElements compare them: null, then booleans, numbers by value
+    //whatever their type (NaN after the others), then strings by bytes. A record without the key, or with a key that is an array or
+    //object, sorts as null. The sort is stable, so records with equal keys stay in input order.
+    class ExternalSort {
+        public:
+            ExternalSort(const SortOptions &options);
+
+            // Removes any runs left on disk
+            ~ExternalSort();
+
+            // Reads every record of a stream into sorted runs, throwing a parser_error for malformed input. Returns
+            // once every batch read is sorted, so an error in any of them is thrown here.
+            void add(std::istream &in);
+
+            // Merges the runs as JSON, returning the number of records (or groups) written. The sort can only be
+            // written once.
+            size_t write(std::ostream &out);
+
+            // Records read and runs spilled so far
+            inline size_t getRecords() const { return records; }
+            inline size_t getRuns() const { return runs.size(); }
+
+        protected:
+            SortOptions options;
+            Path path;
+            size_t records, batchBytes, created;
+
+            //Files of the runs, in input order
+            std::vector<std::string> runs;
+
+            //Threads sorting batches, and the first error any of them hit
+            std::vector<std::thread> workers;
+            std::mutex lock;
+            std::exception_ptr failed;
+
+            //Parses, sorts and spills one batch of record texts separated by newlines as a run
+            void sortBatch(std::string batch, std::string filename);
+
+            //Starts a thread for a batch, waiting for the oldest if all threads are busy, and rethrows the error of
+            //a batch that failed
+            void submit(std::string &batch);
+
+            //Waits for the batches being sorted, rethrowing an error from any of them
+            void finish();
+
+            //Merges runs [begin,end) into a new run
+            std::string mergeRuns(size_t begin, size_t end);
+
+            std::string runName();
+
+            ExternalSort(const ExternalSort &other);
+            ExternalSort& operator=(const ExternalSort &other);
+    };
+
+}
+
+#endif
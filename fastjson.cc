@@ -0,0 +1,338 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fastjson.h"
+#include "json.hh"
+
+#include <fstream>
+#include <cstring>
+#include <type_traits>
+#include <new>
+
+//A document is the values read from one text. Value handles are pointers to Values inside it.
+struct fj_document {
+    std::vector<json::Value> values;
+};
+
+namespace json {
+
+    static_assert(sizeof(TInteger) == sizeof(int64_t) && sizeof(TUInteger) == sizeof(uint64_t), "C numbers must match Value numbers");
+    static_assert((int)FJ_INTEGER == TINTEGER && (int)FJ_REAL == TREAL && (int)FJ_STRING == TSTRING && (int)FJ_OBJECT == TOBJECT
+        && (int)FJ_ARRAY == TARRAY && (int)FJ_NULL == TNULL, "fj_type must match Type");
+
+    //Reaches inside Values for the C interface, which borrows their storage instead of copying it
+    class CBinding {
+        public:
+            static inline const Value* of(const fj_value *value) { return (const Value*)value; }
+            static inline fj_value* handle(const Value *value) { return (fj_value*)value; }
+
+            static inline const TObject* object(const fj_value *value) {
+                return value && of(value)->type == TOBJECT ? of(value)->data.object : NULL;
+            }
+
+            static inline const TString& string(const fj_value *value) { return *of(value)->data.string; }
+
+            static inline const TArray* array(const fj_value *value) {
+                if (!value || of(value)->type != TARRAY) return NULL;
+                const TArray *elements = of(value)->data.array;
+                return elements->slice && !elements->slice->valid() ? NULL : elements; //a view its parent was shrunk past
+            }
+
+            //The stored element at an index, followed through views, or NULL for packed storage
+            static inline const Value* element(const TArray *elements, size_t index) {
+                if (elements->slice) {
+                    const TSlice &slice = *elements->slice;
+                    return element(slice.parent.data.array,slice.begin + index*slice.stride);
+                }
+                return elements->packed ? NULL : &(*elements)[index];
+            }
+
+            static inline const Value* find(const fj_value *value, const char *key, size_t length) {
+                const TObject *members = object(value);
+                return members ? members->member(key,length) : NULL;
+            }
+
+            //Packs nested arrays first, since TArray::pack only combines rows that are already packed
+            static bool pack(fj_value *value) {
+                TArray *elements = (TArray*)array(value);
+                if (!elements) return false;
+                if (!elements->packed && !elements->slice) {
+                    for (TArray::iterator it = elements->begin(); it != elements->end(); ++it) {
+                        if (it->type == TARRAY) pack(handle(&*it));
+                    }
+                    elements->pack();
+                }
+                return numbers(elements);
+            }
+
+            //True if an array is packed numbers, none of them null
+            static bool numbers(const TArray *elements) {
+                const TPacked *packed = elements->packed;
+                return packed && packed->type != TSTRING && packed->type != TBOOL && packed->nulls.empty();
+            }
+    };
+
+    //Members are iterated with map iterators constructed in the caller's fj_members, which C may copy. Members of
+    //objects sharing a shape are iterated by slot instead, with the object in the last word of the state.
+    typedef TObject::const_iterator MemberIterator;
+    static_assert(sizeof(MemberIterator) <= sizeof(void*) && std::is_trivially_copyable<MemberIterator>::value, "fj_members must hold two map iterators");
+
+    static void describe(const char *message, char *error, size_t error_size) {
+        if (!error || !error_size) return;
+        strncpy(error,message,error_size-1);
+        error[error_size-1] = '\0';
+    }
+
+    static fj_document* read(Reader &reader, char *error, size_t error_size) {
+        fj_document *document = new fj_document;
+        try {
+            Value value;
+            while (reader.getValue(value)) document->values.push_back(value);
+            return document;
+        } catch (parser_error &e) {
+            describe(e.what(),error,error_size);
+        } catch (std::exception &e) {
+            describe(e.what(),error,error_size);
+        }
+        delete document;
+        return NULL;
+    }
+
+}
+
+using json::CBinding;
+using json::Value;
+
+extern "C" {
+
+    int fj_abi_version(void) {
+        return FJ_ABI_VERSION;
+    }
+
+    fj_document* fj_parse(const char *text, size_t length, char *error, size_t error_size) {
+        try {
+            json::Reader reader(std::string(text,length));
+            return json::read(reader,error,error_size);
+        } catch (std::exception &e) {
+            json::describe(e.what(),error,error_size);
+            return NULL;
+        }
+    }
+
+    fj_document* fj_parse_file(const char *filename, char *error, size_t error_size) {
+        try {
+            std::ifstream file(filename);
+            if (!file) {
+                json::describe("Could not open file",error,error_size);
+                return NULL;
+            }
+            json::Reader reader(file);
+            return json::read(reader,error,error_size);
+        } catch (std::exception &e) {
+            json::describe(e.what(),error,error_size);
+            return NULL;
+        }
+    }
+
+    void fj_document_free(fj_document *document) {
+        delete document;
+    }
+
+    size_t fj_document_size(const fj_document *document) {
+        return document ? document->values.size() : 0;
+    }
+
+    fj_value* fj_document_get(const fj_document *document, size_t index) {
+        if (!document || index >= document->values.size()) return NULL;
+        return CBinding::handle(&document->values[index]);
+    }
+
+    fj_type fj_type_of(const fj_value *value) {
+        return value ? (fj_type)CBinding::of(value)->getType() : FJ_NULL;
+    }
+
+    int fj_get_integer(const fj_value *value, int64_t *result) {
+        if (fj_type_of(value) != FJ_INTEGER) return 0;
+        *result = CBinding::of(value)->getInteger();
+        return 1;
+    }
+
+    int fj_get_uinteger(const fj_value *value, uint64_t *result) {
+        if (fj_type_of(value) != FJ_UINTEGER) return 0;
+        *result = CBinding::of(value)->getUInteger();
+        return 1;
+    }
+
+    int fj_get_real(const fj_value *value, double *result) {
+        switch (fj_type_of(value)) {
+            case FJ_INTEGER:
+            case FJ_UINTEGER:
+            case FJ_REAL:
+                *result = CBinding::of(value)->cast<double>();
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+    int fj_get_bool(const fj_value *value, int *result) {
+        if (fj_type_of(value) != FJ_BOOL) return 0;
+        *result = CBinding::of(value)->getBool();
+        return 1;
+    }
+
+    int fj_get_string(const fj_value *value, const char **data, size_t *length) {
+        if (fj_type_of(value) != FJ_STRING) return 0;
+        const json::TString &string = CBinding::string(value);
+        *data = string.c_str();
+        *length = string.size();
+        return 1;
+    }
+
+    size_t fj_size(const fj_value *value) {
+        if (const json::TObject *members = CBinding::object(value)) return members->memberCount();
+        if (CBinding::array(value)) return CBinding::of(value)->getArraySize();
+        return 0;
+    }
+
+    fj_value* fj_member(const fj_value *object, const char *key, size_t length) {
+        try {
+            return CBinding::handle(CBinding::find(object,key,length));
+        } catch (std::exception &e) {
+            return NULL;
+        }
+    }
+
+    void fj_members_begin(const fj_value *object, fj_members *members) {
+        const json::TObject *values = CBinding::object(object);
+        if (values && values->shape) {
+            members->state[0] = NULL; //next slot
+            members->state[3] = values;
+            return;
+        }
+        new ((void*)&members->state[0]) json::MemberIterator(values ? values->begin() : json::MemberIterator());
+        new ((void*)&members->state[2]) json::MemberIterator(values ? values->end() : json::MemberIterator());
+        members->state[3] = NULL;
+    }
+
+    int fj_members_next(fj_members *members, const char **key, size_t *length, fj_value **value) {
+        if (const json::TObject *values = (const json::TObject*)members->state[3]) {
+            const size_t slot = (size_t)members->state[0];
+            if (slot == values->slots.size()) return 0;
+            *key = values->shape->keys[slot].c_str();
+            *length = values->shape->keys[slot].size();
+            *value = CBinding::handle(&values->slots[slot]);
+            members->state[0] = (const void*)(slot+1);
+            return 1;
+        }
+        json::MemberIterator &at = *(json::MemberIterator*)&members->state[0];
+        if (at == *(const json::MemberIterator*)&members->state[2]) return 0;
+        *key = at->first.c_str();
+        *length = at->first.size();
+        *value = CBinding::handle(&at->second);
+        ++at;
+        return 1;
+    }
+
+    fj_value* fj_index(const fj_value *array, size_t index) {
+        const json::TArray *elements = CBinding::array(array);
+        if (!elements || index >= CBinding::of(array)->getArraySize()) return NULL;
+        return CBinding::handle(CBinding::element(elements,index));
+    }
+
+    int fj_index_real(const fj_value *array, size_t index, double *result) {
+        const json::TArray *elements = CBinding::array(array);
+        if (!elements || index >= CBinding::of(array)->getArraySize()) return 0;
+        if (elements->packed) {
+            const json::TPacked &packed = *elements->packed;
+            if (packed.shape.size() != 1 || packed.type == json::TSTRING || packed.type == json::TBOOL || packed.isNull(index)) return 0;
+            switch (packed.type) {
+                case json::TINTEGER:
+                    *result = packed.integers[index];
+                    break;
+                case json::TUINTEGER:
+                    *result = packed.uintegers[index];
+                    break;
+                default:
+                    *result = packed.reals[index];
+            }
+            return 1;
+        }
+        return fj_get_real(fj_index(array,index),result);
+    }
+
+    int fj_index_string(const fj_value *array, size_t index, const char **data, size_t *length) {
+        const json::TArray *elements = CBinding::array(array);
+        if (!elements || index >= CBinding::of(array)->getArraySize()) return 0;
+        if (elements->packed) {
+            const json::TPacked &packed = *elements->packed;
+            if (packed.shape.size() != 1 || packed.type != json::TSTRING) return 0;
+            *data = packed.chars(index);
+            *length = packed.length(index);
+            return 1;
+        }
+        return fj_get_string(fj_index(array,index),data,length);
+    }
+
+    int fj_index_bool(const fj_value *array, size_t index, int *result) {
+        const json::TArray *elements = CBinding::array(array);
+        if (!elements || index >= CBinding::of(array)->getArraySize()) return 0;
+        if (elements->packed) {
+            const json::TPacked &packed = *elements->packed;
+            if (packed.shape.size() != 1 || packed.type != json::TBOOL) return 0;
+            *result = json::TPacked::bit(packed.bits,index);
+            return 1;
+        }
+        return fj_get_bool(fj_index(array,index),result);
+    }
+
+    int fj_numbers(const fj_value *array, fj_type *type, const void **data, size_t *count) {
+        const json::TArray *elements = CBinding::array(array);
+        if (!elements || !CBinding::numbers(elements)) return 0;
+        const json::TPacked &packed = *elements->packed;
+        *type = (fj_type)packed.type;
+        *count = packed.count();
+        switch (packed.type) {
+            case json::TINTEGER:
+                *data = packed.integers.data();
+                break;
+            case json::TUINTEGER:
+                *data = packed.uintegers.data();
+                break;
+            default:
+                *data = packed.reals.data();
+        }
+        return 1;
+    }
+
+    int fj_shape(const fj_value *array, const size_t **shape, size_t *dimensions) {
+        const json::TArray *elements = CBinding::array(array);
+        if (!elements || !elements->packed) return 0;
+        *shape = elements->packed->shape.data();
+        *dimensions = elements->packed->shape.size();
+        return 1;
+    }
+
+    int fj_pack(fj_value *array) {
+        try {
+            return CBinding::pack(array);
+        } catch (std::exception &e) {
+            return 0;
+        }
+    }
+
+}
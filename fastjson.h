@@ -0,0 +1,129 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* C interface to fastjson for C, Fortran (through ISO_C_BINDING) and other languages with a C FFI.
+ *
+ * Ownership: a document owns every value read from it. fj_parse and fj_parse_file return a document the caller
+ * must release with fj_document_free; everything else is borrowed. Value handles, strings and number arrays
+ * point into the document and stay valid until it is freed, or until fj_pack is called on an array containing
+ * them. Nothing here allocates except reading and packing, and no exception or error crosses this interface:
+ * functions report failure by returning NULL or 0.
+ *
+ * Reading a document from several threads at once is safe; fj_pack and fj_document_free are not.
+ */
+
+#ifndef FASTJSON_H
+#define FASTJSON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Changes only when existing declarations change incompatibly */
+#define FJ_ABI_VERSION 3
+
+typedef struct fj_document fj_document;
+typedef struct fj_value fj_value;
+
+/* Values match json::Type and never change */
+typedef enum {
+    FJ_INTEGER = 0,
+    FJ_UINTEGER = 1,
+    FJ_REAL = 2,
+    FJ_BOOL = 3,
+    FJ_STRING = 4,
+    FJ_OBJECT = 5,
+    FJ_ARRAY = 6,
+    FJ_NULL = 7
+} fj_type;
+
+/* Iteration state over the members of an object, kept wherever the caller likes (e.g. the stack) */
+typedef struct {
+    const void *state[4];
+} fj_members;
+
+/* FJ_ABI_VERSION of the library, to compare with the header a program was built against */
+int fj_abi_version(void);
+
+/* Reads every value in RATDB/JSON text or a file, or returns NULL with a message copied into error (which may
+ * be NULL, and is truncated to error_size bytes including its NUL) */
+fj_document* fj_parse(const char *text, size_t length, char *error, size_t error_size);
+fj_document* fj_parse_file(const char *filename, char *error, size_t error_size);
+
+/* Frees a document and everything borrowed from it */
+void fj_document_free(fj_document *document);
+
+/* Number of top level values, and the value at an index (NULL if out of range) */
+size_t fj_document_size(const fj_document *document);
+fj_value* fj_document_get(const fj_document *document, size_t index);
+
+fj_type fj_type_of(const fj_value *value);
+
+/* Scalar getters return 1 and store the value, or return 0 if the value has another type. fj_get_real also
+ * converts integers, as Value::cast<double> does. */
+int fj_get_integer(const fj_value *value, int64_t *result);
+int fj_get_uinteger(const fj_value *value, uint64_t *result);
+int fj_get_real(const fj_value *value, double *result);
+int fj_get_bool(const fj_value *value, int *result);
+
+/* Borrows the characters of a string, which are NUL terminated but may also contain NULs */
+int fj_get_string(const fj_value *value, const char **data, size_t *length);
+
+/* Elements of an array or members of an object, 0 for other types */
+size_t fj_size(const fj_value *value);
+
+/* The member of an object with a key of the given length, or NULL */
+fj_value* fj_member(const fj_value *object, const char *key, size_t length);
+
+/* Starts iterating over the members of an object in key order; fj_members_next returns 0 when done */
+void fj_members_begin(const fj_value *object, fj_members *members);
+int fj_members_next(fj_members *members, const char **key, size_t *length, fj_value **value);
+
+/* The element of an array at an index, or NULL if out of range. Packed arrays hold numbers, strings or bools
+ * rather than values, so their elements have no handles: read them with fj_index_real, fj_index_string,
+ * fj_index_bool or fj_numbers. */
+fj_value* fj_index(const fj_value *array, size_t index);
+
+/* A number of an array (packed or not) converted to double, returning 0 if it is not a number (or is null) */
+int fj_index_real(const fj_value *array, size_t index, double *result);
+
+/* Borrows the characters of a string of an array (packed or not), returning 0 if it is not a string */
+int fj_index_string(const fj_value *array, size_t index, const char **data, size_t *length);
+
+/* A bool of an array (packed or not), returning 0 if it is not a bool */
+int fj_index_bool(const fj_value *array, size_t index, int *result);
+
+/* Borrows the numbers of a packed array in row-major order: type is FJ_INTEGER (int64_t), FJ_UINTEGER
+ * (uint64_t) or FJ_REAL (double), count is the total of all dimensions. Returns 0 if the array is not packed
+ * numbers or some of them are null. */
+int fj_numbers(const fj_value *array, fj_type *type, const void **data, size_t *count);
+
+/* Borrows the extent of each dimension of a packed array, outermost first */
+int fj_shape(const fj_value *array, const size_t **shape, size_t *dimensions);
+
+/* Stores an array of numbers (or equally shaped arrays of numbers) contiguously so fj_numbers can borrow them.
+ * Handles to its elements become invalid. Returns 1 if the array holds packed numbers afterwards. */
+int fj_pack(fj_value *array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,586 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frozen.hh"
+
+#include <fstream>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace json {
+
+    const char FROZEN_MAGIC[8] = {'F','J','F','R','O','Z','E','2'}; //2: keys hashed with the length mixed in last
+
+    uint64_t hashKey(const char *key, size_t length) {
+        KeyHash hash;
+        size_t i = 0;
+        for ( ; i + 8 <= length; i += 8) {
+            uint64_t word;
+            memcpy(&word,key+i,8);
+            hash.add(word);
+        }
+        if (i < length) hash.addPartial(key+i,length-i);
+        return hash.finish(length);
+    }
+
+    //Appends the records of a frozen buffer. Records are addressed by offset because the buffer moves as it grows.
+    class FrozenBuilder {
+        public:
+
+            inline FrozenBuilder() : buffer(sizeof(FrozenHeader)) { }
+
+            //Reserves zeroed space for size bytes at an 8 byte aligned offset
+            uint64_t allocate(size_t size) {
+                const uint64_t offset = (buffer.size() + 7) & ~(uint64_t)7;
+                buffer.resize(offset + size);
+                return offset;
+            }
+
+            template <typename T> inline T* at(uint64_t offset) {
+                return (T*)&buffer[offset];
+            }
+
+            uint64_t putString(const char *chars, size_t length) {
+                const uint64_t offset = allocate(length+1);
+                memcpy(&buffer[offset],chars,length);
+                return offset;
+            }
+
+            template <typename T> uint64_t putNumbers(const std::vector<T> &numbers) {
+                const uint64_t offset = allocate(numbers.size()*sizeof(T));
+                if (numbers.size()) memcpy(&buffer[offset],&numbers[0],numbers.size()*sizeof(T));
+                return offset;
+            }
+
+            FrozenSlot freeze(const Value &value) {
+                FrozenSlot slot;
+                slot.type = value.type;
+                slot.packed = TNULL;
+                slot.count = 0;
+                slot.payload = 0;
+                switch (value.type) {
+                    case TINTEGER:
+                    case TUINTEGER:
+                    case TREAL:
+                        memcpy(&slot.payload,&value.data,sizeof(slot.payload));
+                        break;
+                    case TBOOL:
+                        slot.payload = value.data.boolean;
+                        break;
+                    case TSTRING:
+                        slot.count = value.data.string->size();
+                        slot.payload = putString(value.data.string->data(),slot.count);
+                        break;
+                    case TARRAY: {
+                        const TPacked *packed = value.data.array->packed;
+                        slot.count = value.getArraySize();
+                        if (packed && packed->shape.size() == 1 && packed->type != TSTRING && packed->type != TBOOL && packed->nulls.empty()) {
+                            slot.packed = packed->type;
+                            switch (packed->type) {
+                                case TINTEGER:
+                                    slot.payload = putNumbers(packed->integers);
+                                    break;
+                                case TUINTEGER:
+                                    slot.payload = putNumbers(packed->uintegers);
+                                    break;
+                                default:
+                                    slot.payload = putNumbers(packed->reals);
+                            }
+                        } else {
+                            slot.payload = allocate(slot.count*sizeof(FrozenSlot));
+                            for (size_t i = 0; i < slot.count; i++) {
+                                const FrozenSlot element = freeze(value.getElement(i));
+                                *at<FrozenSlot>(slot.payload + i*sizeof(FrozenSlot)) = element;
+                            }
+                        }
+                        break;
+                    }
+                    case TOBJECT: {
+                        const TObject &object = *value.data.object;
+                        slot.count = object.memberCount();
+                        uint64_t capacity = 1;
+                        while (capacity < 2*slot.count) capacity <<= 1;
+                        slot.payload = allocate(sizeof(FrozenTable) + capacity*sizeof(FrozenEntry) + slot.count*sizeof(uint32_t));
+                        const uint64_t entries = slot.payload + sizeof(FrozenTable);
+                        const uint64_t order = entries + capacity*sizeof(FrozenEntry);
+                        at<FrozenTable>(slot.payload)->capacity = capacity;
+                        at<FrozenTable>(slot.payload)->entries = entries;
+                        size_t i = 0;
+                        object.each([&](const TString &name, const Value &value) {
+                            const uint64_t hash = hashKey(name.data(),name.size());
+                            uint64_t pos = hash & (capacity-1);
+                            while (at<FrozenEntry>(entries + pos*sizeof(FrozenEntry))->key) pos = (pos+1) & (capacity-1);
+                            const uint64_t key = putString(name.data(),name.size());
+                            const FrozenSlot member = freeze(value);
+                            FrozenEntry *entry = at<FrozenEntry>(entries + pos*sizeof(FrozenEntry));
+                            entry->hash = hash;
+                            entry->key = key;
+                            entry->length = name.size();
+                            entry->value = member;
+                            at<uint32_t>(order)[i++] = pos;
+                        });
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                return slot;
+            }
+
+            //Copies a frozen value to dest for Frozen::relayout. In the hot pass, objects with looked up members
+            //get a hot table of those members with their keys and values right after it, and everything else is
+            //deferred to the cold pass so that it ends up after all of the hot data.
+            void relayout(const FrozenValue &value, const FrozenProfile &profile, bool hot, uint64_t dest) {
+                FrozenSlot slot = value.slot;
+                switch (slot.type) {
+                    case TSTRING:
+                        slot.payload = putString(value.base+slot.payload,slot.count);
+                        break;
+                    case TARRAY:
+                        if (slot.packed != TNULL) {
+                            slot.payload = allocate(slot.count*sizeof(uint64_t));
+                            memcpy(&buffer[slot.payload],value.base+value.slot.payload,slot.count*sizeof(uint64_t));
+                        } else {
+                            slot.payload = allocate(slot.count*sizeof(FrozenSlot));
+                            for (size_t i = 0; i < slot.count; i++) {
+                                relayout(value.getIndex(i),profile,hot,slot.payload + i*sizeof(FrozenSlot));
+                            }
+                        }
+                        break;
+                    case TOBJECT: {
+                        const std::vector<Member> members = byHits(value,profile);
+                        if (!hot) {
+                            slot.payload = putTable(value,members,profile,allocate(sizeof(FrozenTable)));
+                            break;
+                        }
+                        size_t nhot = 0;
+                        while (nhot < members.size() && members[nhot].hits) nhot++;
+                        if (!nhot) {
+                            cold.push_back(std::make_pair(value,dest));
+                            return;
+                        }
+                        uint32_t capacity = 1;
+                        while (capacity < 2*nhot) capacity <<= 1;
+                        slot.payload = allocate(sizeof(FrozenTable) + capacity*sizeof(FrozenEntry));
+                        at<FrozenTable>(slot.payload)->hot = capacity;
+                        const uint64_t entries = slot.payload + sizeof(FrozenTable);
+                        std::vector<uint64_t> placed(nhot);
+                        for (size_t i = 0; i < nhot; i++) {
+                            placed[i] = putEntry(value,*members[i].entry,entries,capacity,0);
+                        }
+                        for (size_t i = 0; i < nhot; i++) {
+                            relayout(FrozenValue(value.base,members[i].entry->value),profile,true,placed[i] + offsetof(FrozenEntry,value));
+                        }
+                        tables.push_back(std::make_pair(value,slot.payload));
+                        break;
+                    }
+                }
+                *at<FrozenSlot>(dest) = slot;
+            }
+
+            //Builds the full table of an object whose hot table was written by the hot pass
+            void finishTable(const FrozenValue &value, const FrozenProfile &profile, uint64_t table) {
+                putTable(value,byHits(value,profile),profile,table);
+            }
+
+            //A member of a source object and the number of times it was looked up
+            struct Member {
+                const FrozenEntry *entry;
+                uint64_t hits;
+                uint32_t rank; //position in key order
+
+                inline bool operator<(const Member &other) const { return hits > other.hits; }
+            };
+
+            //Returns the members of an object from most to least looked up
+            static std::vector<Member> byHits(const FrozenValue &value, const FrozenProfile &profile) {
+                const FrozenTable *table = (const FrozenTable*)(value.base+value.slot.payload);
+                const FrozenEntry *entries = (const FrozenEntry*)(value.base+table->entries);
+                const uint32_t *order = (const uint32_t*)(entries+table->capacity);
+                std::vector<Member> members(value.slot.count);
+                for (size_t i = 0; i < members.size(); i++) {
+                    const FrozenEntry &entry = entries[order[i]];
+                    members[i].entry = &entry;
+                    members[i].hits = profile.hits((const char*)&entry - value.base);
+                    members[i].rank = i;
+                    if (table->hot) { //lookups of a relaid buffer find the hot copy of a member
+                        const FrozenEntry *copy = FrozenValue::findIn(value.base,(const FrozenEntry*)(table+1),table->hot,value.base+entry.key,entry.length,entry.hash);
+                        if (copy) members[i].hits += profile.hits((const char*)copy - value.base);
+                    }
+                }
+                std::stable_sort(members.begin(),members.end());
+                return members;
+            }
+
+            //Inserts a member into a table of entries, copying its key unless it is given, and returns the entry
+            uint64_t putEntry(const FrozenValue &value, const FrozenEntry &member, uint64_t entries, uint64_t capacity, uint64_t key) {
+                uint64_t pos = member.hash & (capacity-1);
+                while (at<FrozenEntry>(entries + pos*sizeof(FrozenEntry))->key) pos = (pos+1) & (capacity-1);
+                if (!key) key = putString(value.base+member.key,member.length);
+                FrozenEntry *entry = at<FrozenEntry>(entries + pos*sizeof(FrozenEntry));
+                entry->hash = member.hash;
+                entry->key = key;
+                entry->length = member.length;
+                return entries + pos*sizeof(FrozenEntry);
+            }
+
+            //Writes the full table of an object for the FrozenTable at table, sharing the keys and values of its hot
+            //table if it has one, and copies the other members in place. Returns table.
+            uint64_t putTable(const FrozenValue &value, const std::vector<Member> &members, const FrozenProfile &profile, uint64_t table) {
+                const uint64_t capacity = ((const FrozenTable*)(value.base+value.slot.payload))->capacity;
+                const uint64_t entries = allocate(capacity*sizeof(FrozenEntry) + members.size()*sizeof(uint32_t));
+                const uint64_t order = entries + capacity*sizeof(FrozenEntry);
+                const uint32_t hot = at<FrozenTable>(table)->hot;
+                at<FrozenTable>(table)->capacity = capacity;
+                at<FrozenTable>(table)->entries = entries;
+                std::vector<uint64_t> placed(members.size());
+                std::vector<bool> shared(members.size());
+                for (size_t i = 0; i < members.size(); i++) {
+                    const FrozenEntry &member = *members[i].entry;
+                    const FrozenEntry *found = hot ? FrozenValue::findIn(&buffer[0],at<FrozenEntry>(table + sizeof(FrozenTable)),hot,
+                                                                         value.base+member.key,member.length,member.hash) : NULL;
+                    shared[i] = found;
+                    const FrozenEntry copy = found ? *found : FrozenEntry();
+                    placed[i] = putEntry(value,member,entries,capacity,copy.key);
+                    at<uint32_t>(order)[members[i].rank] = (placed[i] - entries)/sizeof(FrozenEntry);
+                    if (shared[i]) at<FrozenEntry>(placed[i])->value = copy.value;
+                }
+                for (size_t i = 0; i < members.size(); i++) {
+                    if (!shared[i]) relayout(FrozenValue(value.base,members[i].entry->value),profile,false,placed[i] + offsetof(FrozenEntry,value));
+                }
+                return table;
+            }
+
+            std::vector<char> buffer;
+
+            //Values deferred by the hot pass of relayout and the offset of the slot they belong in
+            std::vector<std::pair<FrozenValue,uint64_t> > cold;
+
+            //Objects given a hot table by the hot pass of relayout and the offset of their FrozenTable
+            std::vector<std::pair<FrozenValue,uint64_t> > tables;
+    };
+
+    Frozen::Frozen(const Value &value) : mapped(false) {
+        FrozenBuilder builder;
+        const FrozenSlot root = builder.freeze(value);
+        FrozenHeader *header = builder.at<FrozenHeader>(0);
+        memcpy(header->magic,FROZEN_MAGIC,sizeof(FROZEN_MAGIC));
+        header->size = builder.buffer.size();
+        header->root = root;
+        length = builder.buffer.size();
+        data = new char[length];
+        memcpy(data,&builder.buffer[0],length);
+    }
+
+    Frozen Frozen::relayout(const FrozenProfile &profile) const {
+        std::lock_guard<std::mutex> guard(FrozenProfile::lock); //threads may stop while the counts are read
+        FrozenBuilder builder;
+        builder.relayout(this->root(),profile,true,offsetof(FrozenHeader,root));
+        for (size_t i = 0; i < builder.tables.size(); i++) {
+            builder.finishTable(builder.tables[i].first,profile,builder.tables[i].second);
+        }
+        for (size_t i = 0; i < builder.cold.size(); i++) {
+            builder.relayout(builder.cold[i].first,profile,false,builder.cold[i].second);
+        }
+        FrozenHeader *header = builder.at<FrozenHeader>(0);
+        memcpy(header->magic,FROZEN_MAGIC,sizeof(FROZEN_MAGIC));
+        header->size = builder.buffer.size();
+        Frozen frozen;
+        frozen.length = builder.buffer.size();
+        frozen.data = new char[frozen.length];
+        memcpy(frozen.data,&builder.buffer[0],frozen.length);
+        return frozen;
+    }
+
+    Frozen::Frozen(const char *bytes, size_t size) : mapped(false) {
+        check(bytes,size);
+        length = size;
+        data = new char[length];
+        memcpy(data,bytes,length);
+    }
+
+    Frozen::Frozen(Frozen &&other) : data(other.data), length(other.length), mapped(other.mapped) {
+        other.data = NULL;
+        other.length = 0;
+        other.mapped = false;
+    }
+
+    Frozen::~Frozen() {
+        if (mapped) {
+            munmap(data,length);
+        } else {
+            delete [] data;
+        }
+    }
+
+    Frozen Frozen::map(const std::string &filename) {
+        const int fd = open(filename.c_str(),O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Could not open frozen file " + filename);
+        try {
+            Frozen frozen = map(fd);
+            close(fd);
+            return frozen;
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+    }
+
+    Frozen Frozen::map(int fd) {
+        struct stat info;
+        if (fstat(fd,&info) || (size_t)info.st_size < sizeof(FrozenHeader)) throw std::runtime_error("Frozen file is too small");
+        void *mem = mmap(NULL,info.st_size,PROT_READ,MAP_SHARED,fd,0);
+        if (mem == MAP_FAILED) throw std::runtime_error("Could not map frozen file");
+        Frozen frozen;
+        frozen.data = (char*)mem;
+        frozen.length = info.st_size;
+        frozen.mapped = true;
+        check(frozen.data,frozen.length);
+        return frozen;
+    }
+
+    FrozenValue Frozen::view(const char *bytes, size_t size) {
+        check(bytes,size);
+        return FrozenValue(bytes,offsetof(FrozenHeader,root));
+    }
+
+    void Frozen::save(const std::string &filename) const {
+        std::ofstream out(filename.c_str(),std::ios::binary);
+        out.write(data,length);
+        if (!out) throw std::runtime_error("Could not write frozen file " + filename);
+    }
+
+    void Frozen::check(const char *bytes, size_t size) {
+        FrozenHeader header; //copied, since bytes to be copied into a Frozen need not be aligned
+        if (size >= sizeof(FrozenHeader)) memcpy(&header,bytes,sizeof(header));
+        if (size < sizeof(FrozenHeader) || memcmp(header.magic,FROZEN_MAGIC,sizeof(FROZEN_MAGIC)) || header.size != size) {
+            throw std::runtime_error("Not a valid frozen buffer");
+        }
+    }
+
+    std::mutex FrozenProfile::lock;
+    thread_local std::shared_ptr<FrozenProfile::ThreadCounts> FrozenProfile::active;
+    thread_local FrozenProfile::ThreadCounts *FrozenProfile::counting = NULL;
+
+    FrozenProfile::FrozenProfile(const Frozen &frozen) : base(frozen.bytes()) {
+
+    }
+
+    FrozenProfile::~FrozenProfile() {
+        std::lock_guard<std::mutex> guard(lock);
+        // other threads keep their counts, which they own, until they start another profile or exit
+        for (size_t i = 0; i < threads.size(); i++) threads[i]->profile = NULL;
+        if (active && !active->profile) {
+            active.reset();
+            counting = NULL;
+        }
+    }
+
+    void FrozenProfile::start() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (active && active->profile == this) return;
+        if (active) detach(*active);
+        active = std::make_shared<ThreadCounts>();
+        active->base = base;
+        active->profile = this;
+        threads.push_back(active);
+        counting = active.get();
+    }
+
+    void FrozenProfile::stop() {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!active || active->profile != this) return;
+        detach(*active);
+        active.reset();
+        counting = NULL;
+    }
+
+    void FrozenProfile::detach(ThreadCounts &thread) {
+        FrozenProfile *profile = thread.profile;
+        if (!profile) return;
+        for (std::unordered_map<uint64_t,uint64_t>::const_iterator it = thread.counts.begin(); it != thread.counts.end(); ++it) {
+            profile->counts[it->first] += it->second;
+        }
+        for (size_t i = 0; i < profile->threads.size(); i++) {
+            if (profile->threads[i].get() == &thread) {
+                profile->threads.erase(profile->threads.begin()+i);
+                break;
+            }
+        }
+        thread.profile = NULL;
+    }
+
+    void FrozenProfile::clear() {
+        std::lock_guard<std::mutex> guard(lock);
+        counts.clear();
+    }
+
+    uint64_t FrozenProfile::hits(const FrozenValue &object, const TString &key) const {
+        std::lock_guard<std::mutex> guard(lock);
+        const FrozenEntry *entry = object.findEntry(key.data(),key.size(),hashKey(key.data(),key.size()));
+        return entry ? hits((const char*)entry-base) : 0;
+    }
+
+    void FrozenValue::wrongType(Type actual, Type requested) {
+        Value::wrongType(actual,requested);
+    }
+
+    FrozenValue FrozenValue::getMember(const TString &key) const {
+        return getMember(key.data(),key.size(),hashKey(key.data(),key.size()));
+    }
+
+    const FrozenEntry* FrozenValue::findIn(const char *base, const FrozenEntry *entries, uint64_t capacity, const char *key, size_t length, uint64_t hash) {
+        const uint64_t mask = capacity-1;
+        for (uint64_t pos = hash & mask; entries[pos].key; pos = (pos+1) & mask) {
+            const FrozenEntry &entry = entries[pos];
+            if (entry.hash == hash && entry.length == length && !memcmp(base+entry.key,key,length)) return &entry;
+        }
+        return NULL;
+    }
+
+    const FrozenEntry* FrozenValue::findEntry(const char *key, size_t length, uint64_t hash) const {
+        checkType(TOBJECT);
+        const FrozenTable *table = (const FrozenTable*)(base+slot.payload);
+        if (table->hot) {
+            const FrozenEntry *entry = findIn(base,(const FrozenEntry*)(table+1),table->hot,key,length,hash);
+            if (entry) return entry;
+        }
+        return findIn(base,(const FrozenEntry*)(base+table->entries),table->capacity,key,length,hash);
+    }
+
+    FrozenValue FrozenValue::getMember(const char *key, size_t length, uint64_t hash) const {
+        const FrozenEntry *entry = findEntry(key,length,hash);
+        if (!entry) return FrozenValue();
+        FrozenProfile::ThreadCounts *thread = FrozenProfile::counting;
+        if (thread && thread->base == base) thread->counts[(const char*)entry-base]++;
+        return FrozenValue(base,entry->value);
+    }
+
+    bool FrozenValue::isMember(const TString &key) const {
+        return findEntry(key.data(),key.size(),hashKey(key.data(),key.size())) != NULL;
+    }
+
+    FrozenValue FrozenValue::getMemberAt(size_t i, const char **key, size_t *length) const {
+        checkType(TOBJECT);
+        if (i >= slot.count) throw std::runtime_error("Member index out of bounds of frozen JSON object");
+        const FrozenTable *table = (const FrozenTable*)(base+slot.payload);
+        const FrozenEntry *entries = (const FrozenEntry*)(base+table->entries);
+        const uint32_t *order = (const uint32_t*)(entries+table->capacity);
+        const FrozenEntry &entry = entries[order[i]];
+        if (key) *key = base+entry.key;
+        if (length) *length = entry.length;
+        return FrozenValue(base,entry.value);
+    }
+
+    std::vector<std::string> FrozenValue::getMembers() const {
+        std::vector<std::string> keys(getMemberCount());
+        for (size_t i = 0; i < keys.size(); i++) {
+            const char *key;
+            size_t length;
+            getMemberAt(i,&key,&length);
+            keys[i].assign(key,length);
+        }
+        return keys;
+    }
+
+    FrozenValue FrozenValue::getIndex(size_t index) const {
+        checkType(TARRAY);
+        if (index >= slot.count) throw std::runtime_error("Index out of bounds of frozen JSON array");
+        if (slot.packed != TNULL) {
+            FrozenSlot number;
+            number.type = slot.packed;
+            number.packed = TNULL;
+            number.count = 0;
+            number.payload = ((const uint64_t*)(base+slot.payload))[index];
+            return FrozenValue(base,number);
+        }
+        return FrozenValue(base,slot.payload + index*sizeof(FrozenSlot));
+    }
+
+    FrozenValue FrozenValue::resolve(const Path &path) const {
+        FrozenValue value = *this;
+        for (size_t i = 0; i < path.steps.size(); i++) {
+            const Path::Step &step = path.steps[i];
+            if (step.isIndex) {
+                if (value.getType() != TARRAY || step.index >= value.slot.count) return FrozenValue();
+                value = value.getIndex(step.index);
+            } else {
+                if (value.getType() != TOBJECT) return FrozenValue();
+                value = value.getMember(step.key);
+            }
+        }
+        return value;
+    }
+
+    Value FrozenValue::thaw() const {
+        switch (slot.type) {
+            case TINTEGER:
+                return Value((TInteger)slot.payload);
+            case TUINTEGER:
+                return Value((TUInteger)slot.payload);
+            case TREAL:
+                return Value(getReal());
+            case TBOOL:
+                return Value(slot.payload != 0);
+            case TSTRING:
+                return Value(getString());
+            case TARRAY: {
+                Value array(TARRAY);
+                TArray &elements = *array.data.array;
+                if (slot.packed != TNULL && slot.count) {
+                    TPacked *packed = new TPacked((Type)slot.packed);
+                    packed->shape.push_back(slot.count);
+                    switch (packed->type) {
+                        case TINTEGER:
+                            packed->integers.assign((const TInteger*)(base+slot.payload),(const TInteger*)(base+slot.payload)+slot.count);
+                            break;
+                        case TUINTEGER:
+                            packed->uintegers.assign((const TUInteger*)(base+slot.payload),(const TUInteger*)(base+slot.payload)+slot.count);
+                            break;
+                        default:
+                            packed->reals.assign((const TReal*)(base+slot.payload),(const TReal*)(base+slot.payload)+slot.count);
+                    }
+                    elements.packed = packed;
+                } else {
+                    elements.resize(slot.count);
+                    for (size_t i = 0; i < slot.count; i++) {
+                        elements[i] = getIndex(i).thaw();
+                    }
+                    elements.pack(); //restores multi-dimensional packing
+                }
+                return array;
+            }
+            case TOBJECT: {
+                Value object(TOBJECT);
+                TObject &members = *object.data.object;
+                for (size_t i = 0; i < slot.count; i++) {
+                    const char *key;
+                    size_t length;
+                    const FrozenValue member = getMemberAt(i,&key,&length);
+                    members.insert(members.end(),std::make_pair(TString(key,length),member.thaw()));
+                }
+                return object;
+            }
+            default:
+                return Value();
+        }
+    }
+
+}
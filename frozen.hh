@@ -0,0 +1,304 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_FROZEN
+#define _JSON_FROZEN
+
+#include "json.hh"
+
+#include <stdint.h>
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+namespace json {
+
+    class Frozen;
+    class FrozenValue;
+    class FrozenProfile;
+
+    //The frozen format is a single position independent buffer of 8 byte aligned records that is read in place:
+    //
+    //  FrozenHeader    magic, total size, and the root slot
+    //  FrozenSlot      a Value: basic types inline, structured types as the offset of their data
+    //    TSTRING         count bytes (plus a NUL) at payload
+    //    TARRAY          count slots at payload, or count raw numbers if the element type is packed
+    //    TOBJECT         a FrozenTable at payload
+    //  FrozenTable     an open addressing hash table of capacity FrozenEntry followed by count uint32_t entry
+    //                  numbers in key order, normally right after the FrozenTable. Tables rearranged by
+    //                  Frozen::relayout are instead followed by a small table of the most looked up members
+    //                  that is probed first.
+    //
+    //All offsets are from the start of the buffer, so it may be mapped from a file or shared memory.
+
+    struct FrozenSlot {
+        uint16_t type;     //Type of the value
+        uint16_t packed;   //Type of the raw numbers of a packed TARRAY, otherwise TNULL
+        uint32_t count;    //length of a string or number of elements or members
+        uint64_t payload;  //value bits of basic types or offset of structured types
+    };
+
+    struct FrozenEntry {
+        uint64_t hash;     //hashKey of the key
+        uint64_t key;      //offset of the NUL terminated key, zero for an empty entry
+        uint64_t length;   //length of the key
+        FrozenSlot value;
+    };
+
+    struct FrozenTable {
+        uint32_t capacity; //power of two number of entries
+        uint32_t hot;      //power of two number of entries of the hot table following this, or zero
+        uint64_t entries;  //offset of the entries
+    };
+
+    //Identifies frozen buffers, and changes with their layout or key hash
+    extern const char FROZEN_MAGIC[8];
+
+    struct FrozenHeader {
+        char magic[8];
+        uint64_t size;
+        FrozenSlot root;
+    };
+
+    //A read-only view of a Value inside a frozen buffer. Views hold a copy of their slot and are only valid while
+    //the buffer is. The getters mirror Value and throw a runtime_error for the wrong type.
+    class FrozenValue {
+
+        friend class Frozen;
+        friend class FrozenBuilder;
+        friend class FrozenProfile;
+
+        public:
+
+            // A null view
+            inline FrozenValue() : base(NULL) { slot.type = TNULL; slot.packed = TNULL; slot.count = 0; slot.payload = 0; }
+
+            // Views the slot at an offset in a frozen buffer
+            inline FrozenValue(const char *base_, uint64_t offset) : base(base_), slot(*(const FrozenSlot*)(base_+offset)) { }
+
+            // Returns the type of the Value
+            inline Type getType() const { return (Type)slot.type; }
+
+            // Getters for basic types
+            inline TInteger getInteger() const { checkType(TINTEGER); return (TInteger)slot.payload; }
+            inline TUInteger getUInteger() const { checkType(TUINTEGER); return (TUInteger)slot.payload; }
+            inline TReal getReal() const { checkType(TREAL); TReal real; memcpy(&real,&slot.payload,sizeof(real)); return real; }
+            inline TBool getBool() const { checkType(TBOOL); return slot.payload != 0; }
+            inline TString getString() const { checkType(TSTRING); return TString(base+slot.payload,slot.count); }
+
+            // Borrowed access to the NUL terminated characters of a string
+            inline const char* getChars() const { checkType(TSTRING); return base+slot.payload; }
+            inline size_t getStringLength() const { checkType(TSTRING); return slot.count; }
+
+            // Returns a member of a JSON object, or a null view if there is no such member
+            FrozenValue getMember(const TString &key) const;
+            FrozenValue getMember(const char *key, size_t length, uint64_t hash) const;
+
+            // Returns a member without constructing a string (for code that must not allocate)
+            inline FrozenValue getMember(const char *key) const { const size_t length = strlen(key); return getMember(key,length,hashKey(key,length)); }
+
+            // Returns true if the key exists in the JSON object
+            bool isMember(const TString &key) const;
+
+            // Returns a vector of all the keys in the JSON object
+            std::vector<std::string> getMembers() const;
+
+            // Returns the number of members of a JSON object
+            inline size_t getMemberCount() const { checkType(TOBJECT); return slot.count; }
+
+            // Returns the key and value of the i'th member of a JSON object in key order
+            FrozenValue getMemberAt(size_t i, const char **key = NULL, size_t *length = NULL) const;
+
+            // Returns the size of a JSON array
+            inline size_t getArraySize() const { checkType(TARRAY); return slot.count; }
+
+            // Returns the Value at an index in a JSON array (packed numbers are returned as Values)
+            FrozenValue getIndex(size_t index) const;
+
+            // Borrowed access to the raw numbers of a packed array, NULL if the array is not packed as type
+            inline const void* getNumbers(Type type) const { checkType(TARRAY); return slot.packed == type ? base+slot.payload : NULL; }
+
+            // Follows a path of members and indices, returning a null view if any step is missing
+            FrozenValue resolve(const Path &path) const;
+
+            // Copies the view into a regular Value
+            Value thaw() const;
+
+            // Base address of the buffer
+            inline const char* buffer() const { return base; }
+
+            // The slot describing this view
+            inline const FrozenSlot& getSlot() const { return slot; }
+
+            // Views a slot (e.g. received from a DBServer) in a frozen buffer
+            inline FrozenValue(const char *base_, const FrozenSlot &slot_) : base(base_), slot(slot_) { }
+
+#ifndef __CINT__
+
+            // Casts basic types through Value::cast
+            template <typename T> inline T cast() const { return thaw().cast<T>(); }
+
+            // Templated vector constructing method (see Value::toVector)
+            template <typename T> inline std::vector<T> toVector() const { return thaw().toVector<T>(); }
+
+#endif
+
+        protected:
+
+            // Throws a runtime_error if the type of the view does not match the given Type
+            inline void checkType(Type type) const { if (slot.type != type) wrongType((Type)slot.type,type); }
+
+            static void wrongType(Type actual, Type requested);
+
+            // Returns the entry of a member of a JSON object, or NULL if there is no such member
+            const FrozenEntry* findEntry(const char *key, size_t length, uint64_t hash) const;
+
+            // Probes a table of entries in a buffer for a key
+            static const FrozenEntry* findIn(const char *base, const FrozenEntry *entries, uint64_t capacity, const char *key, size_t length, uint64_t hash);
+
+            const char *base;
+            FrozenSlot slot;
+    };
+
+    //An immutable frozen buffer owning its memory, which may be heap allocated or mapped from a file
+    class Frozen {
+        public:
+
+            // Freezes a Value into a new buffer
+            explicit Frozen(const Value &value);
+
+            // Copies an existing frozen buffer (e.g. read from a socket), checking its header
+            Frozen(const char *bytes, size_t size);
+
+            // Moves the buffer of another Frozen
+            Frozen(Frozen &&other);
+
+            ~Frozen();
+
+            // Maps a frozen buffer saved with save() read-only into memory
+            static Frozen map(const std::string &filename);
+
+            // Maps a frozen buffer read-only from an open file descriptor (e.g. shared memory)
+            static Frozen map(int fd);
+
+            // Views a frozen buffer in place without copying it, e.g. one compiled into the program by ratdbembed.
+            // The buffer must be 8 byte aligned and outlive the views.
+            static FrozenValue view(const char *bytes, size_t size);
+
+            // Copies the buffer into a new layout for the lookups counted by a profile: in each object the most
+            // looked up members take the first places in probe order and are stored next to the table, members that
+            // were never looked up are moved with their subtrees to the end of the buffer, and arrays stay with
+            // their parent. The profile does not apply to the result.
+            Frozen relayout(const FrozenProfile &profile) const;
+
+            // Writes the buffer to a file
+            void save(const std::string &filename) const;
+
+            // Returns a view of the frozen Value
+            inline FrozenValue root() const { return FrozenValue(data,offsetof(FrozenHeader,root)); }
+
+            // Returns the raw buffer
+            inline const char* bytes() const { return data; }
+            inline size_t size() const { return length; }
+
+            // Throws a runtime_error if the buffer does not start with a valid header
+            static void check(const char *bytes, size_t size);
+
+        protected:
+
+            Frozen(const Frozen &other);
+            Frozen& operator=(const Frozen &other);
+
+            inline Frozen() : data(NULL), length(0), mapped(false) { }
+
+            char *data;
+            size_t length;
+            bool mapped;
+    };
+
+    //Counts the member lookups made in one frozen buffer by the threads it is started on, for Frozen::relayout.
+    //Each thread counts on its own, and its counts are added to the profile when it stops.
+    class FrozenProfile {
+
+        friend class Frozen;
+        friend class FrozenValue;
+        friend class FrozenBuilder;
+
+        public:
+
+            explicit FrozenProfile(const Frozen &frozen);
+
+            // Stops counting on every thread it was started on (the counts of threads that did not stop are lost)
+            ~FrozenProfile();
+
+            // Starts or stops counting the lookups of the calling thread. A thread counts for one profile at a
+            // time, so starting a profile stops the one the thread was counting for.
+            void start();
+            void stop();
+
+            // Returns the number of times a member of an object in the profiled buffer was looked up by the
+            // threads that have stopped
+            uint64_t hits(const FrozenValue &object, const TString &key) const;
+
+            // Forgets the counts of the threads that have stopped
+            void clear();
+
+        protected:
+
+            // The counts of one thread, modified only by that thread
+            struct ThreadCounts {
+                const char *base;
+                FrozenProfile *profile; //NULL once stopped or the profile is destroyed (guarded by lock)
+                std::unordered_map<uint64_t,uint64_t> counts;
+            };
+
+            // Hit counts of the stopped threads by the offset of the FrozenEntry looked up
+            std::unordered_map<uint64_t,uint64_t> counts;
+
+            const char *base;
+
+            // The threads counting for this profile
+            std::vector<std::shared_ptr<ThreadCounts> > threads;
+
+            // Guards the counts of the profiles and the threads started on them. Lookups never take it, since
+            // they only count on their own thread.
+            static std::mutex lock;
+
+            // The counts of the calling thread, if it was started on a profile
+            static thread_local std::shared_ptr<ThreadCounts> active;
+
+            // The same counts for lookups, as a plain pointer so that a thread that never profiles does not allocate
+            // to register the destructor of active on its first lookup
+            static thread_local ThreadCounts *counting;
+
+            // Adds the counts of a thread to its profile and removes the thread from it (with lock held)
+            static void detach(ThreadCounts &thread);
+
+            inline uint64_t hits(uint64_t entry) const {
+                std::unordered_map<uint64_t,uint64_t>::const_iterator it = counts.find(entry);
+                return it == counts.end() ? 0 : it->second;
+            }
+
+            FrozenProfile(const FrozenProfile &other);
+            FrozenProfile& operator=(const FrozenProfile &other);
+    };
+
+}
+
+#endif
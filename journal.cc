@@ -0,0 +1,431 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "journal.hh"
+
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace json {
+
+    static const char SNAPSHOT_MAGIC[8] = {'F','J','S','N','A','P','S','H'};
+
+    //Checks records against torn writes. This was hashKey before keys were hashed with the length mixed in
+    //last, and stays as it was so existing journals still replay.
+    static uint32_t checksum(const char *body, size_t length) {
+        uint64_t hash = 0x9E3779B97F4A7C15ull ^ length;
+        for (size_t i = 0; i < length; i += 8) {
+            uint64_t word = 0;
+            memcpy(&word,body+i,length-i < 8 ? length-i : 8);
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 32;
+        }
+        hash ^= hash >> 29;
+        hash *= 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 32;
+        return (uint32_t)hash;
+    }
+
+    static bool writeFully(int fd, const char *bytes, size_t size) {
+        while (size) {
+            const ssize_t sent = ::write(fd,bytes,size);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) return false;
+            bytes += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    static std::string readFile(const std::string &filename) {
+        std::ifstream file(filename.c_str(),std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    static bool exists(const std::string &filename) {
+        return access(filename.c_str(),F_OK) == 0;
+    }
+
+    // Makes renames and new files in the directory of a file durable
+    static void syncDirectory(const std::string &filename) {
+        const size_t slash = filename.rfind('/');
+        const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : filename.substr(0,slash);
+        const int fd = open(directory.c_str(),O_RDONLY);
+        if (fd < 0) return;
+        fsync(fd);
+        close(fd);
+    }
+
+    //Record bodies are an operation byte, the path, and the operand, in native byte order like frozen buffers
+    template <typename T> static void put(std::string &body, const T &value) {
+        body.append((const char*)&value,sizeof(T));
+    }
+
+    static void putBytes(std::string &body, const char *bytes, uint32_t size) {
+        put(body,size);
+        body.append(bytes,size);
+    }
+
+    static void putPath(std::string &body, const Path &path) {
+        put(body,(uint32_t)path.steps.size());
+        for (size_t i = 0; i < path.steps.size(); i++) {
+            const Path::Step &step = path.steps[i];
+            put(body,(uint8_t)step.isIndex);
+            if (step.isIndex) {
+                put(body,(uint64_t)step.index);
+            } else {
+                putBytes(body,step.key.data(),step.key.size());
+            }
+        }
+    }
+
+    // Basic types are stored inline and structured types as a frozen buffer
+    static void putValue(std::string &body, const Value &value) {
+        const Type type = value.getType();
+        put(body,(uint8_t)type);
+        switch (type) {
+            case TINTEGER:
+                put(body,value.getInteger());
+                break;
+            case TUINTEGER:
+                put(body,value.getUInteger());
+                break;
+            case TREAL:
+                put(body,value.getReal());
+                break;
+            case TBOOL:
+                put(body,(uint8_t)value.getBool());
+                break;
+            case TSTRING: {
+                const TString string = value.getString();
+                putBytes(body,string.data(),string.size());
+                break;
+            }
+            case TARRAY:
+            case TOBJECT: {
+                const Frozen frozen(value);
+                put(body,(uint64_t)frozen.size());
+                body.append(frozen.bytes(),frozen.size());
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    //Reads a record body, throwing a runtime_error if it ends early
+    class RecordCursor {
+        public:
+            RecordCursor(const char *body, size_t size) : at(body), end(body+size) { }
+
+            template <typename T> T get() {
+                T value;
+                memcpy(&value,take(sizeof(T)),sizeof(T));
+                return value;
+            }
+
+            const char* take(size_t size) {
+                if ((size_t)(end-at) < size) throw std::runtime_error("Corrupt journal record");
+                const char *bytes = at;
+                at += size;
+                return bytes;
+            }
+
+            TString getBytes() {
+                const uint32_t size = get<uint32_t>();
+                return TString(take(size),size);
+            }
+
+            Path getPath() {
+                Path path("");
+                path.steps.resize(get<uint32_t>());
+                for (size_t i = 0; i < path.steps.size(); i++) {
+                    Path::Step &step = path.steps[i];
+                    step.isIndex = get<uint8_t>() != 0;
+                    step.index = step.isIndex ? get<uint64_t>() : 0;
+                    if (!step.isIndex) step.key = getBytes();
+                }
+                return path;
+            }
+
+            // Returns the value, or only skips it if not decode
+            Value getValue(bool decode) {
+                const Type type = (Type)get<uint8_t>();
+                switch (type) {
+                    case TNULL:
+                        return Value();
+                    case TINTEGER:
+                        return Value(get<TInteger>());
+                    case TUINTEGER:
+                        return Value(get<TUInteger>());
+                    case TREAL:
+                        return Value(get<TReal>());
+                    case TBOOL:
+                        return Value((TBool)(get<uint8_t>() != 0));
+                    case TSTRING:
+                        return Value(getBytes());
+                    case TARRAY:
+                    case TOBJECT: {
+                        const uint64_t size = get<uint64_t>();
+                        const char *bytes = take(size);
+                        return decode ? Frozen(bytes,size).root().thaw() : Value();
+                    }
+                    default:
+                        throw std::runtime_error("Corrupt journal record");
+                }
+            }
+
+            inline bool done() const { return at == end; }
+
+        protected:
+            const char *at, *end;
+    };
+
+    Journal::Journal(const std::string &filename_, size_t compactBytes_) : filename(filename_), compactBytes(compactBytes_), written(0), sequence(0), fd(-1), root(TOBJECT), compacting(false), rotated(false), broken(false) {
+        uint64_t snapshot = 0;
+        if (exists(filename)) {
+            const std::string bytes = readFile(filename);
+            const JournalSnapshot *header = (const JournalSnapshot*)bytes.data();
+            if (bytes.size() < sizeof(JournalSnapshot) || memcmp(header->magic,SNAPSHOT_MAGIC,sizeof(SNAPSHOT_MAGIC))) {
+                throw std::runtime_error("Not a journal snapshot: " + filename);
+            }
+            snapshot = sequence = header->sequence;
+            root = Frozen(bytes.data()+sizeof(JournalSnapshot),bytes.size()-sizeof(JournalSnapshot)).root().thaw();
+        }
+        const std::string journal = filename + ".journal", old = journal + ".old";
+        const bool interrupted = exists(old);
+        if (interrupted) replay(old,snapshot);
+        written = replay(journal,snapshot);
+        fd = open(journal.c_str(),O_WRONLY|O_CREAT|O_APPEND,0644);
+        if (fd < 0 || ftruncate(fd,written)) throw std::runtime_error("Could not open journal " + journal);
+        if (interrupted) {
+            // finish the compaction that was interrupted with everything replayed
+            writeSnapshot(filename,sequence,Frozen(root));
+            unlink(old.c_str());
+            if (ftruncate(fd,0)) throw std::runtime_error("Could not truncate journal " + journal);
+            written = 0;
+        }
+    }
+
+    Journal::~Journal() {
+        if (compactor.joinable()) compactor.join();
+        if (fd >= 0) close(fd);
+    }
+
+    size_t Journal::replay(const std::string &journal, uint64_t snapshot) {
+        if (!exists(journal)) return 0;
+        const std::string bytes = readFile(journal);
+        size_t offset = 0;
+        while (bytes.size() - offset >= sizeof(JournalRecord)) {
+            JournalRecord record;
+            memcpy(&record,bytes.data()+offset,sizeof(record));
+            const char *body = bytes.data() + offset + sizeof(record);
+            if (bytes.size() - offset - sizeof(record) < record.size) break;
+            if (checksum(body,record.size) != record.check) break;
+            if (record.sequence > snapshot) apply(body,record.size,true);
+            if (record.sequence > sequence) sequence = record.sequence;
+            offset += sizeof(record) + record.size;
+        }
+        return offset;
+    }
+
+    Value& Journal::locate(const Path &path) {
+        Value *value = &root;
+        for (size_t i = 0; i < path.steps.size(); i++) {
+            const Path::Step &step = path.steps[i];
+            if (step.isIndex) {
+                if (value->getType() != TARRAY || step.index >= value->getArraySize()) throw std::runtime_error("Journal path does not exist");
+                value = &value->getIndex(step.index);
+            } else {
+                if (value->getType() != TOBJECT || !value->isMember(step.key)) throw std::runtime_error("Journal path does not exist");
+                value = &value->getMember(step.key);
+            }
+        }
+        return *value;
+    }
+
+    void Journal::apply(const char *body, size_t size, bool modify) {
+        RecordCursor cursor(body,size);
+        const Operation operation = (Operation)cursor.get<uint8_t>();
+        Value &target = locate(cursor.getPath());
+        switch (operation) {
+            case SET_MEMBER: {
+                const TString key = cursor.getBytes();
+                const Value value = cursor.getValue(modify);
+                if (modify) target.setMember(key,value);
+                break;
+            }
+            case SET_INDEX: {
+                const uint64_t index = cursor.get<uint64_t>();
+                const Value value = cursor.getValue(modify);
+                if (target.getType() != TARRAY || index >= target.getArraySize()) throw std::runtime_error("Journal index out of range");
+                if (modify) target.setIndex(index,value);
+                break;
+            }
+            case SET_ARRAY_SIZE: {
+                const uint64_t length = cursor.get<uint64_t>();
+                if (modify) target.setArraySize(length);
+                break;
+            }
+            case RESET: {
+                const Type type = (Type)cursor.get<uint8_t>();
+                if (modify) target.reset(type);
+                break;
+            }
+            default:
+                throw std::runtime_error("Corrupt journal record");
+        }
+        if (!cursor.done()) throw std::runtime_error("Corrupt journal record");
+    }
+
+    void Journal::commit(const std::string &body) {
+        if (broken) throw std::runtime_error("Journal of " + filename + " holds a torn record and accepts no edits");
+        apply(body.data(),body.size(),false);
+        JournalRecord record;
+        record.size = body.size();
+        record.check = checksum(body.data(),body.size());
+        record.sequence = sequence+1;
+        std::string bytes((const char*)&record,sizeof(record));
+        bytes += body;
+        if (!writeFully(fd,bytes.data(),bytes.size())) {
+            // cut off what was written of the record, or replay would stop there and drop the records after it
+            if (ftruncate(fd,written)) broken = true;
+            throw std::runtime_error("Could not append to journal of " + filename);
+        }
+        sequence++;
+        written += bytes.size();
+        apply(body.data(),body.size(),true);
+        // the edit is saved whatever happens to the compaction, whose failure is kept for wait and sync
+        if (compactBytes && written > compactBytes && !compacting && !error) {
+            try {
+                compact();
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    void Journal::setMember(const Path &path, const TString &key, const Value &value) {
+        std::string body;
+        put(body,(uint8_t)SET_MEMBER);
+        putPath(body,path);
+        putBytes(body,key.data(),key.size());
+        putValue(body,value);
+        commit(body);
+    }
+
+    void Journal::setIndex(const Path &path, size_t index, const Value &value) {
+        std::string body;
+        put(body,(uint8_t)SET_INDEX);
+        putPath(body,path);
+        put(body,(uint64_t)index);
+        putValue(body,value);
+        commit(body);
+    }
+
+    void Journal::setArraySize(const Path &path, size_t size) {
+        std::string body;
+        put(body,(uint8_t)SET_ARRAY_SIZE);
+        putPath(body,path);
+        put(body,(uint64_t)size);
+        commit(body);
+    }
+
+    void Journal::reset(const Path &path, Type type) {
+        std::string body;
+        put(body,(uint8_t)RESET);
+        putPath(body,path);
+        put(body,(uint8_t)type);
+        commit(body);
+    }
+
+    void Journal::sync() {
+        if (fdatasync(fd)) throw std::runtime_error("Could not sync journal of " + filename);
+        if (rotated) {
+            syncDirectory(filename);
+            rotated = false;
+        }
+        if (!compacting) wait();
+    }
+
+    void Journal::compact() {
+        if (compactor.joinable()) compactor.join();
+        const std::string journal = filename + ".journal", old = journal + ".old";
+        if (exists(old)) {
+            // a failed compaction left records that only the old journal holds, so rotating again would lose
+            // them: the snapshot is written before returning, as after an interrupted compaction
+            writeSnapshot(filename,sequence,Frozen(root));
+            unlink(old.c_str());
+            if (ftruncate(fd,0)) throw std::runtime_error("Could not truncate journal " + journal);
+            written = 0;
+            return;
+        }
+        // Freezing is the only part proportional to the document done before returning; the snapshot is
+        // written from the frozen copy while edits continue into the new journal
+        std::shared_ptr<Frozen> frozen(new Frozen(root));
+        if (rename(journal.c_str(),old.c_str())) throw std::runtime_error("Could not rotate journal " + journal);
+        close(fd);
+        fd = open(journal.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_APPEND,0644);
+        if (fd < 0) throw std::runtime_error("Could not open journal " + journal);
+        written = 0;
+        rotated = true;
+        compacting = true;
+        const std::string snapshot = filename;
+        const uint64_t at = sequence;
+        compactor = std::thread([this,frozen,snapshot,old,at]() {
+            try {
+                writeSnapshot(snapshot,at,*frozen);
+                unlink(old.c_str());
+            } catch (...) {
+                error = std::current_exception();
+            }
+            compacting = false;
+        });
+    }
+
+    void Journal::wait() {
+        if (compactor.joinable()) compactor.join();
+        if (error) {
+            std::exception_ptr failed = error;
+            error = std::exception_ptr();
+            std::rethrow_exception(failed);
+        }
+    }
+
+    void Journal::writeSnapshot(const std::string &filename, uint64_t sequence, const Frozen &frozen) {
+        const std::string temporary = filename + ".tmp";
+        JournalSnapshot header;
+        memcpy(header.magic,SNAPSHOT_MAGIC,sizeof(SNAPSHOT_MAGIC));
+        header.sequence = sequence;
+        const int fd = open(temporary.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+        if (fd < 0) throw std::runtime_error("Could not create snapshot " + temporary);
+        const bool ok = writeFully(fd,(const char*)&header,sizeof(header)) && writeFully(fd,frozen.bytes(),frozen.size()) && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(temporary.c_str(),filename.c_str())) {
+            unlink(temporary.c_str());
+            throw std::runtime_error("Could not write snapshot " + filename);
+        }
+        syncDirectory(filename);
+    }
+
+}
@@ -0,0 +1,133 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_JOURNAL
+#define _JSON_JOURNAL
+
+#include "frozen.hh"
+
+#include <thread>
+#include <atomic>
+#include <exception>
+
+namespace json {
+
+    //A document saved as a snapshot plus a write-ahead journal of the edits made since. Each edit is appended
+    //to the journal as one binary record before it is applied, so saving costs the size of the edit, and loading
+    //replays the journal over the snapshot. When the journal grows past a threshold a new snapshot is written
+    //in the background and the journal starts over.
+    //
+    //Files: filename is the snapshot (a JournalSnapshot header and a frozen buffer), filename.journal holds the
+    //records after it, and filename.journal.old holds the records of a journal being compacted. Every record
+    //carries a sequence number, and replay skips records already contained in the snapshot, so a crash at any
+    //point of a compaction loses nothing. A torn record at the end of the journal is discarded on load. A
+    //compaction that fails leaves filename.journal.old in place, and is reported by wait and sync rather than by
+    //the edits that started it.
+    class Journal {
+        public:
+            // Loads the document saved at filename, or starts an empty object. Compaction starts when the journal
+            // exceeds compactBytes (never if zero).
+            explicit Journal(const std::string &filename, size_t compactBytes = 1 << 24);
+
+            // Waits for a running compaction
+            ~Journal();
+
+            // The document. Modify it only through the methods below, or the changes are not saved.
+            inline const Value& document() const { return root; }
+
+            // Edits the Value at path like the Value methods of the same name. Paths must exist, and the value is
+            // copied, so later changes to it through other references are not part of the document.
+            void setMember(const Path &path, const TString &key, const Value &value);
+            void setIndex(const Path &path, size_t index, const Value &value);
+            void setArraySize(const Path &path, size_t size);
+            void reset(const Path &path, Type type);
+
+            // Forces the records appended so far to stable storage (otherwise they survive a crash of the
+            // process but not of the machine), then rethrows the error of a compaction that has failed
+            void sync();
+
+            // Starts writing a snapshot of the document in the background and begins a new journal. If the last
+            // compaction failed the snapshot is written before returning instead, throwing if it fails again.
+            void compact();
+
+            // Waits for a running compaction, rethrowing the error of a compaction that failed since the last
+            // wait or sync
+            void wait();
+
+            // Bytes in the current journal
+            inline size_t journalSize() const { return written; }
+
+        protected:
+            enum Operation {
+                SET_MEMBER = 1,
+                SET_INDEX = 2,
+                SET_ARRAY_SIZE = 3,
+                RESET = 4
+            };
+
+            std::string filename;
+            size_t compactBytes, written;
+            uint64_t sequence;
+            int fd;
+            Value root;
+
+            std::thread compactor;
+            std::atomic<bool> compacting;
+            std::exception_ptr error;
+
+            // True if the journal was replaced since the last sync
+            bool rotated;
+
+            // True once a partly appended record could not be cut off the journal, after which edits are refused
+            bool broken;
+
+            // Returns the Value at the end of a path in the document, throwing a runtime_error if it is missing
+            Value& locate(const Path &path);
+
+            // Checks a record body against the document, appends it to the journal, applies it, and compacts if
+            // the journal has grown too large. An append that fails is cut off the journal and leaves the document
+            // unchanged.
+            void commit(const std::string &body);
+
+            // Reads the records of a journal file, applying those after the snapshot, and returns the bytes of
+            // complete records
+            size_t replay(const std::string &journal, uint64_t snapshot);
+
+            // Applies one record body, or only checks that it applies if not modify
+            void apply(const char *body, size_t size, bool modify);
+
+            // Writes a snapshot durably with a temporary file and a rename
+            static void writeSnapshot(const std::string &filename, uint64_t sequence, const Frozen &frozen);
+
+            Journal(const Journal &other);
+            Journal& operator=(const Journal &other);
+    };
+
+    struct JournalSnapshot {
+        char magic[8];
+        uint64_t sequence; //last record contained in the snapshot
+    };
+
+    struct JournalRecord {
+        uint32_t size;     //bytes of the body following the record
+        uint32_t check;    //checksum of the body
+        uint64_t sequence;
+    };
+
+}
+
+#endif
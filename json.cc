@@ -18,11 +18,16 @@
 #include "json.hh"
 
 #include <cstdlib>
+#include <cmath>
 #include <cstring>
 #include <sstream>
 #include <limits>
 #include <climits>
 #include <cerrno>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
 
 namespace json {
 
@@ -32,15 +37,15 @@ namespace json {
         switch (type) {
             case TSTRING:
                 data.string = new TString();
-                refcount = new TUInteger(0);
+                refcount = new TRefCount(0);
                 return;
             case TOBJECT:
                 data.object = new TObject();
-                refcount = new TUInteger(0);
+                refcount = new TRefCount(0);
                 return;
             case TARRAY:
                 data.array = new TArray();
-                refcount = new TUInteger(0);
+                refcount = new TRefCount(0);
                 return;
             default:
                 refcount = NULL;
@@ -66,8 +71,488 @@ namespace json {
         refcount = NULL;
     }
 
+    //A scalar member value used as an index key. Numbers are kept as long double so integers of any type and
+    //integral reals compare and hash as the same key.
+    struct IndexKey {
+        enum { KNULL, KBOOL, KNUMBER, KSTRING } kind;
+        long double number;
+        TString string;
+
+        //NaN orders after every other number and equals itself, or sorting by key would be undefined
+        inline bool operator<(const IndexKey &other) const {
+            if (kind != other.kind) return kind < other.kind;
+            if (kind == KSTRING) return string < other.string;
+            if (std::isnan(number) || std::isnan(other.number)) return !std::isnan(number);
+            return number < other.number;
+        }
+
+        inline bool operator==(const IndexKey &other) const {
+            if (kind != other.kind) return false;
+            if (kind == KSTRING) return string == other.string;
+            return number == other.number || (std::isnan(number) && std::isnan(other.number));
+        }
+    };
+
+    struct IndexKeyHash {
+        inline size_t operator()(const IndexKey &key) const {
+            return key.kind == IndexKey::KSTRING ? std::hash<TString>()(key.string) : std::hash<long double>()(key.number) + key.kind;
+        }
+    };
+
+    //Secondary indexes of a JSON array by member name, each valid for the array revision it was built at
+    class TIndexes {
+        public:
+            typedef std::unordered_map<IndexKey,std::vector<size_t>,IndexKeyHash> HashTable;
+            typedef std::vector<std::pair<IndexKey,size_t> > SortedTable;
+
+            struct Hashed {
+                Hashed() : revision(-1) { }
+                size_t revision;
+                HashTable elements;
+            };
+
+            struct Sorted {
+                Sorted() : revision(-1) { }
+                size_t revision;
+                SortedTable elements;
+            };
+
+            std::map<TString,Hashed> hashed;
+            std::map<TString,Sorted> sorted;
+
+            //Held while an index is rebuilt or searched, as const finds on one array may run in several threads
+            std::mutex lock;
+
+            //Returns the indexes of an array, creating them on first use
+            static TIndexes& of(const Value &array) {
+                std::atomic<TIndexes*> &indexes = array.data.array->indexes;
+                TIndexes *existing = indexes.load(std::memory_order_acquire);
+                if (existing) return *existing;
+                TIndexes *created = new TIndexes();
+                if (indexes.compare_exchange_strong(existing,created,std::memory_order_acq_rel)) return *created;
+                delete created; //another thread created them first
+                return *existing;
+            }
+
+            //Converts a scalar Value to a key, returning false for other types
+            static bool keyOf(const Value &value, IndexKey &key) {
+                switch (value.type) {
+                    case TNULL:
+                        key.kind = IndexKey::KNULL;
+                        key.number = 0;
+                        return true;
+                    case TBOOL:
+                        key.kind = IndexKey::KBOOL;
+                        key.number = value.data.boolean;
+                        return true;
+                    case TINTEGER:
+                        key.kind = IndexKey::KNUMBER;
+                        key.number = value.data.integer;
+                        return true;
+                    case TUINTEGER:
+                        key.kind = IndexKey::KNUMBER;
+                        key.number = value.data.uinteger;
+                        return true;
+                    case TREAL:
+                        key.kind = IndexKey::KNUMBER;
+                        key.number = std::isnan(value.data.real) ? NAN : value.data.real; //one NaN, which hashes alike
+                        return true;
+                    case TSTRING:
+                        key.kind = IndexKey::KSTRING;
+                        key.number = 0;
+                        key.string = *value.data.string;
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            //Converts a Value being looked up to a key
+            static IndexKey lookupKey(const Value &value) {
+                IndexKey key;
+                if (!keyOf(value,key)) throw std::runtime_error("Cannot look up " + Value::prettyType(value.type) + " in an index");
+                return key;
+            }
+
+            //The revision of the array including its parent if it is a view
+            static size_t revisionOf(const TArray &array) {
+                return array.slice ? array.revision + array.slice->parent.data.array->revision : array.revision;
+            }
+
+            //Calls add(key,index) for each object element of the array with a scalar member
+            template <typename Add> static void scan(const Value &array, const TString &member, Add add) {
+                const size_t size = array.getArraySize();
+                if (array.data.array->packed) return; //only numbers or strings
+                for (size_t i = 0; i < size; i++) {
+                    const Value element = array.getElement(i);
+                    if (element.type != TOBJECT) continue;
+                    const Value *value = element.data.object->member(member);
+                    IndexKey key;
+                    if (value && keyOf(*value,key)) add(key,i);
+                }
+            }
+
+            //Returns the up to date hashed index on member, with lock held
+            const HashTable& hashedIndex(const Value &array, const TString &member) {
+                const TArray &storage = *array.data.array;
+                Hashed &index = hashed[member];
+                const size_t revision = revisionOf(storage);
+                if (index.revision != revision) {
+                    HashTable &elements = index.elements;
+                    elements.clear();
+                    scan(array,member,[&elements](const IndexKey &key, size_t i) { elements[key].push_back(i); });
+                    index.revision = revision;
+                }
+                return index.elements;
+            }
+
+            //Returns the up to date sorted index on member, with lock held
+            const SortedTable& sortedIndex(const Value &array, const TString &member) {
+                const TArray &storage = *array.data.array;
+                Sorted &index = sorted[member];
+                const size_t revision = revisionOf(storage);
+                if (index.revision != revision) {
+                    SortedTable &elements = index.elements;
+                    elements.clear();
+                    scan(array,member,[&elements](const IndexKey &key, size_t i) { elements.push_back(std::make_pair(key,i)); });
+                    std::stable_sort(elements.begin(),elements.end(),byKey);
+                    index.revision = revision;
+                }
+                return index.elements;
+            }
+
+            static bool byKey(const std::pair<IndexKey,size_t> &a, const std::pair<IndexKey,size_t> &b) {
+                return a.first < b.first;
+            }
+    };
+
+    size_t TShape::find(const char *key, size_t length) const {
+        size_t lo = 0, hi = keys.size();
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            const int order = keys[mid].compare(0,TString::npos,key,length);
+            if (order == 0) return mid;
+            if (order < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return keys.size();
+    }
+
+    TObject::TObject(const TObject &other) : std::map<TString,Value>(other), shape(other.shape), slots(other.slots) {
+        TShape::acquire(shape);
+    }
+
+    TObject::~TObject() {
+        TShape::release(shape);
+    }
+
+    TObject& TObject::operator=(const TObject &other) {
+        if (this == &other) return *this;
+        TShape::acquire(other.shape);
+        TShape::release(shape);
+        std::map<TString,Value>::operator=(other);
+        shape = other.shape;
+        slots = other.slots;
+        return *this;
+    }
+
+    void TObject::expand() {
+        TShape *keys = shape;
+        shape = NULL;
+        for (size_t i = 0; i < slots.size(); i++) {
+            emplace_hint(end(),keys->keys[i],slots[i]); //already in key order
+        }
+        std::vector<Value>().swap(slots);
+        TShape::release(keys);
+    }
+
+    TArray::TArray(const TArray &other) : std::vector<Value>() {
+        *this = other;
+    }
+
+    TArray::~TArray() {
+        delete slice;
+        delete packed;
+        delete indexes;
+    }
+
+    TArray& TArray::operator=(const TArray &other) {
+        if (this == &other) return *this;
+        delete slice;
+        slice = NULL;
+        delete packed;
+        packed = NULL;
+        revision++;
+        if (other.slice) {
+            other.slice->check();
+            const Value &parent = other.slice->parent;
+            resize(other.slice->size);
+            for (size_t i = 0; i < other.slice->size; i++) {
+                (*this)[i] = parent.getElement(other.slice->begin + i*other.slice->stride);
+            }
+        } else {
+            std::vector<Value>::operator=(other);
+            if (other.packed) packed = new TPacked(*other.packed);
+        }
+        return *this;
+    }
+
+    void TArray::detach() {
+        slice->check();
+        TSlice *view = slice;
+        slice = NULL;
+        resize(view->size);
+        for (size_t i = 0; i < view->size; i++) {
+            (*this)[i] = view->parent.getElement(view->begin + i*view->stride);
+        }
+        delete view;
+    }
+
+    void TArray::pack() {
+        if (slice || packed || empty()) return;
+        const Value &first = front();
+        TPacked *result;
+        if (first.type == TARRAY) {
+            const TPacked *row = first.data.array->packed;
+            if (!row) return;
+            bool nulls = false;
+            for (const_iterator it = begin(); it != end(); ++it) {
+                if (it->type != TARRAY) return;
+                const TPacked *other = it->data.array->packed;
+                if (!other || other->type != row->type || other->shape != row->shape) return;
+                nulls = nulls || !other->nulls.empty();
+            }
+            result = new TPacked(row->type);
+            result->shape.push_back(size());
+            result->shape.insert(result->shape.end(),row->shape.begin(),row->shape.end());
+            const size_t count = size() * row->count();
+            if (row->type == TBOOL) {
+                result->bits.resize(TPacked::words(count));
+                result->booleans = count;
+            }
+            if (nulls) result->nulls.resize(TPacked::words(count));
+            size_t offset = 0;
+            for (const_iterator it = begin(); it != end(); ++it, offset += row->count()) {
+                const TPacked *other = it->data.array->packed;
+                switch (row->type) {
+                    case TINTEGER:
+                        result->integers.reserve(count);
+                        result->integers.insert(result->integers.end(),other->integers.begin(),other->integers.end());
+                        break;
+                    case TUINTEGER:
+                        result->uintegers.reserve(count);
+                        result->uintegers.insert(result->uintegers.end(),other->uintegers.begin(),other->uintegers.end());
+                        break;
+                    case TSTRING:
+                        result->ends.reserve(count);
+                        for (size_t i = 0; i < other->ends.size(); i++) result->ends.push_back(result->characters.size() + other->ends[i]);
+                        result->characters += other->characters;
+                        break;
+                    case TBOOL:
+                        for (size_t i = 0; i < other->booleans; i++) TPacked::setBit(result->bits,offset+i,TPacked::bit(other->bits,i));
+                        break;
+                    default:
+                        result->reals.reserve(count);
+                        result->reals.insert(result->reals.end(),other->reals.begin(),other->reals.end());
+                }
+                if (!other->nulls.empty()) {
+                    for (size_t i = 0; i < other->count(); i++) TPacked::setBit(result->nulls,offset+i,other->isNull(i));
+                }
+            }
+        } else {
+            // one type throughout, except that numbers may be null
+            Type type = TNULL;
+            bool nulls = false;
+            for (const_iterator it = begin(); it != end(); ++it) {
+                if (it->type == TNULL) {
+                    nulls = true;
+                } else if (type == TNULL) {
+                    type = it->type;
+                } else if (it->type != type) {
+                    return;
+                }
+            }
+            const bool number = type == TINTEGER || type == TUINTEGER || type == TREAL;
+            if (!number && (nulls || (type != TSTRING && type != TBOOL))) return;
+            result = new TPacked(type);
+            result->shape.push_back(size());
+            if (nulls) {
+                result->nulls.resize(TPacked::words(size()));
+                for (size_t i = 0; i < size(); i++) TPacked::setBit(result->nulls,i,(*this)[i].type == TNULL);
+            }
+            switch (type) {
+                case TINTEGER:
+                    result->integers.resize(size());
+                    for (size_t i = 0; i < size(); i++) result->integers[i] = (*this)[i].type == TNULL ? 0 : (*this)[i].data.integer;
+                    break;
+                case TUINTEGER:
+                    result->uintegers.resize(size());
+                    for (size_t i = 0; i < size(); i++) result->uintegers[i] = (*this)[i].type == TNULL ? 0 : (*this)[i].data.uinteger;
+                    break;
+                case TSTRING: {
+                        size_t characters = 0;
+                        for (size_t i = 0; i < size(); i++) characters += (*this)[i].data.string->size() + 1;
+                        result->characters.reserve(characters);
+                        result->ends.reserve(size());
+                        for (size_t i = 0; i < size(); i++) result->push((*this)[i].data.string->data(),(*this)[i].data.string->size());
+                    }
+                    break;
+                case TBOOL:
+                    result->bits.resize(TPacked::words(size()));
+                    result->booleans = size();
+                    for (size_t i = 0; i < size(); i++) TPacked::setBit(result->bits,i,(*this)[i].data.boolean);
+                    break;
+                default:
+                    result->reals.resize(size());
+                    for (size_t i = 0; i < size(); i++) result->reals[i] = (*this)[i].type == TNULL ? 0 : (*this)[i].data.real;
+            }
+        }
+        std::vector<Value>().swap(*this);
+        packed = result;
+    }
+
+    void TArray::expand() {
+        TPacked *numbers = packed;
+        packed = NULL;
+        const size_t rows = numbers->shape[0];
+        resize(rows);
+        if (numbers->shape.size() == 1) {
+            for (size_t i = 0; i < rows; i++) {
+                (*this)[i] = numbers->at(i);
+            }
+        } else {
+            const std::vector<size_t> shape(numbers->shape.begin()+1,numbers->shape.end());
+            const size_t size = numbers->count() / rows;
+            for (size_t i = 0; i < rows; i++) {
+                Value &row = (*this)[i];
+                row.reset(TARRAY);
+                row.data.array->packed = numbers->range(i*size,size,shape);
+            }
+        }
+        delete numbers;
+    }
+
+    TPacked* TPacked::range(size_t begin, size_t size, const std::vector<size_t> &shape_) const {
+        TPacked *result = new TPacked(type);
+        result->shape = shape_;
+        switch (type) {
+            case TINTEGER:
+                result->integers.assign(integers.begin()+begin,integers.begin()+begin+size);
+                break;
+            case TUINTEGER:
+                result->uintegers.assign(uintegers.begin()+begin,uintegers.begin()+begin+size);
+                break;
+            case TSTRING: {
+                    if (!size) break;
+                    const size_t first = start(begin);
+                    result->characters.assign(characters,first,ends[begin+size-1]+1-first);
+                    result->ends.resize(size);
+                    for (size_t i = 0; i < size; i++) result->ends[i] = ends[begin+i] - first;
+                }
+                break;
+            case TBOOL:
+                result->bits.resize(words(size));
+                result->booleans = size;
+                for (size_t i = 0; i < size; i++) setBit(result->bits,i,bit(bits,begin+i));
+                break;
+            default:
+                result->reals.assign(reals.begin()+begin,reals.begin()+begin+size);
+        }
+        if (!nulls.empty()) {
+            bool any = false;
+            result->nulls.resize(words(size));
+            for (size_t i = 0; i < size; i++) {
+                setBit(result->nulls,i,bit(nulls,begin+i));
+                any = any || bit(nulls,begin+i);
+            }
+            if (!any) result->nulls.clear();
+        }
+        return result;
+    }
+
+    std::vector<size_t> Value::findElements(const TString &key, const Value &match, IndexType kind) const {
+        checkType(TARRAY);
+        const IndexKey lookup = TIndexes::lookupKey(match);
+        TIndexes &indexes = TIndexes::of(*this);
+        std::lock_guard<std::mutex> guard(indexes.lock);
+        if (kind == HASHED) {
+            const TIndexes::HashTable &index = indexes.hashedIndex(*this,key);
+            TIndexes::HashTable::const_iterator it = index.find(lookup);
+            return it == index.end() ? std::vector<size_t>() : it->second;
+        }
+        const TIndexes::SortedTable &index = indexes.sortedIndex(*this,key);
+        const std::pair<IndexKey,size_t> bound(lookup,0);
+        TIndexes::SortedTable::const_iterator first = std::lower_bound(index.begin(),index.end(),bound,TIndexes::byKey);
+        TIndexes::SortedTable::const_iterator last = std::upper_bound(first,index.end(),bound,TIndexes::byKey);
+        std::vector<size_t> result;
+        for ( ; first != last; ++first) result.push_back(first->second);
+        return result;
+    }
+
+    std::vector<size_t> Value::findRange(const TString &key, const Value &lo, const Value &hi) const {
+        checkType(TARRAY);
+        const std::pair<IndexKey,size_t> lower(TIndexes::lookupKey(lo),0), upper(TIndexes::lookupKey(hi),0);
+        TIndexes &indexes = TIndexes::of(*this);
+        std::lock_guard<std::mutex> guard(indexes.lock);
+        const TIndexes::SortedTable &index = indexes.sortedIndex(*this,key);
+        TIndexes::SortedTable::const_iterator first = std::lower_bound(index.begin(),index.end(),lower,TIndexes::byKey);
+        TIndexes::SortedTable::const_iterator last = std::upper_bound(first,index.end(),upper,TIndexes::byKey);
+        std::vector<size_t> result;
+        for ( ; first < last; ++first) result.push_back(first->second);
+        return result;
+    }
+
+    Value Value::getElement(const std::vector<size_t> &index) const {
+        Value element = *this;
+        for (size_t i = 0; i < index.size(); ) {
+            element.checkType(TARRAY);
+            const TPacked *packed = element.data.array->packed;
+            if (packed && index.size() - i == packed->shape.size()) { //address the number directly
+                size_t offset = 0;
+                for (size_t d = 0; d < packed->shape.size(); d++, i++) {
+                    if (index[i] >= packed->shape[d]) throw std::runtime_error("Index out of bounds of JSON array");
+                    offset = offset*packed->shape[d] + index[i];
+                }
+                return packed->at(offset);
+            }
+            element = element.getElement(index[i++]);
+        }
+        return element;
+    }
+
+    std::vector<size_t> Value::shape() const {
+        const size_t size = getArraySize();
+        const TArray &array = *data.array;
+        const TPacked *packed = array.slice ? array.slice->parent.data.array->packed : array.packed;
+        std::vector<size_t> result = packed ? packed->shape : std::vector<size_t>(1);
+        result[0] = size;
+        return result;
+    }
+
+    Value Value::slice(size_t begin, size_t end, size_t stride) const {
+        const size_t size = getArraySize();
+        if (begin > end || end > size || stride == 0) {
+            std::stringstream pretty;
+            pretty << "Invalid slice [" << begin << ',' << end << ") step " << stride << " of JSON array of size " << size;
+            throw std::runtime_error(pretty.str());
+        }
+        Value view(TARRAY);
+        const size_t count = (end - begin + stride - 1) / stride;
+        if (data.array->slice) { //view the original parent rather than chaining views
+            const TSlice &outer = *data.array->slice;
+            view.data.array->slice = new TSlice(outer.parent, outer.begin + begin*outer.stride, count, stride*outer.stride);
+        } else {
+            view.data.array->slice = new TSlice(*this, begin, count, stride);
+        }
+        return view;
+    }
+
     std::vector<std::string> Value::getMembers() const {
         checkType(TOBJECT);
+        if (data.object->shape) return data.object->shape->keys;
         std::vector<std::string> keys(data.object->size());
         size_t i = 0;
         for (TObject::iterator pair = data.object->begin(); pair != data.object->end(); ++pair) {
@@ -78,7 +563,344 @@ namespace json {
 
     bool Value::isMember(std::string key) const {
         checkType(TOBJECT);
-        return (data.object->find(key) != data.object->end());
+        return data.object->member(key) != NULL;
+    }
+
+    //Implements the numeric reductions over JSON arrays. Kernels are written against an element accessor with
+    //independent accumulator lanes so the same code vectorizes over packed numbers and runs over TArray
+    //elements, and ranges of elements can be reduced on separate threads and merged in order.
+    class Reduction {
+        public:
+
+            //Smallest number of elements worth handing to a thread
+            static const size_t MIN_CHUNK = 1 << 18;
+
+            //Accessors reading element i as a TReal
+            template <typename T> struct Packed {
+                const T *v;
+                inline TReal operator()(size_t i) const { return v[i]; }
+            };
+            template <typename T> struct StridedPacked {
+                const T *v;
+                size_t stride;
+                inline TReal operator()(size_t i) const { return v[i*stride]; }
+            };
+            struct Integers {
+                const Value *v;
+                inline TReal operator()(size_t i) const { return v[i].data.integer; }
+            };
+            struct UIntegers {
+                const Value *v;
+                inline TReal operator()(size_t i) const { return v[i].data.uinteger; }
+            };
+            struct Reals {
+                const Value *v;
+                inline TReal operator()(size_t i) const { return v[i].data.real; }
+            };
+            struct Numbers {
+                const Value *v;
+                inline TReal operator()(size_t i) const { return v[i].cast<double>(); }
+            };
+            struct Elements {
+                const Value *array;
+                inline TReal operator()(size_t i) const { return array->getElement(i).cast<double>(); }
+            };
+
+            //Sum of the elements, or of their squared deviations from a known mean
+            struct Sum {
+                struct Result { TReal sum; size_t n; };
+                bool deviation;
+                TReal mean;
+                template <typename Get> Result operator()(const Get &get, size_t i, size_t end) const {
+                    Result r = { 0.0, end - i };
+                    TReal lane[4] = {0.0, 0.0, 0.0, 0.0};
+                    if (deviation) {
+                        for ( ; i+4 <= end; i += 4) {
+                            const TReal d0 = get(i) - mean, d1 = get(i+1) - mean, d2 = get(i+2) - mean, d3 = get(i+3) - mean;
+                            lane[0] += d0*d0;
+                            lane[1] += d1*d1;
+                            lane[2] += d2*d2;
+                            lane[3] += d3*d3;
+                        }
+                        for ( ; i < end; i++) {
+                            const TReal d = get(i) - mean;
+                            lane[0] += d*d;
+                        }
+                    } else {
+                        for ( ; i+4 <= end; i += 4) {
+                            lane[0] += get(i);
+                            lane[1] += get(i+1);
+                            lane[2] += get(i+2);
+                            lane[3] += get(i+3);
+                        }
+                        for ( ; i < end; i++) lane[0] += get(i);
+                    }
+                    r.sum = (lane[0] + lane[1]) + (lane[2] + lane[3]);
+                    return r;
+                }
+                Result merge(const Result &a, const Result &b) const {
+                    Result r = { a.sum + b.sum, a.n + b.n };
+                    return r;
+                }
+            };
+
+            struct Extrema {
+                struct Result { TReal min, max; size_t argmax, n; };
+                template <typename Get> Result operator()(const Get &get, size_t i, size_t end) const {
+                    if (i == end) {
+                        Result r = { 0.0, 0.0, 0, 0 };
+                        return r;
+                    }
+                    Result r = { get(i), get(i), i, end - i };
+                    for (i++ ; i < end; i++) {
+                        const TReal x = get(i);
+                        if (x < r.min) r.min = x;
+                        if (x > r.max) { r.max = x; r.argmax = i; }
+                    }
+                    return r;
+                }
+                Result merge(const Result &a, const Result &b) const {
+                    if (!a.n) return b;
+                    if (!b.n) return a;
+                    Result r = a;
+                    r.n += b.n;
+                    if (b.min < r.min) r.min = b.min;
+                    if (b.max > r.max) { r.max = b.max; r.argmax = b.argmax; }
+                    return r;
+                }
+            };
+
+            struct Histogram {
+                typedef std::vector<size_t> Result;
+                size_t nbins;
+                TReal lo, hi;
+                template <typename Get> Result operator()(const Get &get, size_t i, size_t end) const {
+                    Result bins(nbins);
+                    const TReal scale = nbins / (hi - lo);
+                    for ( ; i < end; i++) {
+                        const TReal x = get(i);
+                        if (x >= lo && x < hi) {
+                            const size_t bin = (size_t)((x - lo) * scale);
+                            bins[bin < nbins ? bin : nbins-1]++;
+                        }
+                    }
+                    return bins;
+                }
+                Result merge(const Result &a, const Result &b) const {
+                    Result r = a;
+                    for (size_t i = 0; i < nbins; i++) r[i] += b[i];
+                    return r;
+                }
+            };
+
+            //Applies op over [0,size) with up to nthreads threads, merging partial results in element order
+            template <typename Op, typename Get> static typename Op::Result run(const Op &op, const Get &get, size_t size, unsigned int nthreads) {
+                if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+                if (nthreads > size / MIN_CHUNK) nthreads = size / MIN_CHUNK;
+                if (nthreads <= 1) return op(get,0,size);
+                std::vector<typename Op::Result> partial(nthreads);
+                std::vector<std::thread> threads;
+                const size_t chunk = size / nthreads;
+                for (unsigned int t = 1; t < nthreads; t++) {
+                    const size_t begin = t*chunk, end = t+1 == nthreads ? size : begin+chunk;
+                    threads.push_back(std::thread([&op,&get,&partial,t,begin,end]() { partial[t] = op(get,begin,end); }));
+                }
+                partial[0] = op(get,0,chunk);
+                typename Op::Result result = partial[0];
+                for (unsigned int t = 1; t < nthreads; t++) {
+                    threads[t-1].join();
+                    result = op.merge(result,partial[t]);
+                }
+                return result;
+            }
+
+            //Applies op over contiguous or strided packed numbers
+            template <typename Op, typename T> static typename Op::Result numbers(const Op &op, const T *v, size_t size, size_t stride, unsigned int nthreads) {
+                if (stride == 1) {
+                    Packed<T> get = { v };
+                    return run(op,get,size,nthreads);
+                }
+                StridedPacked<T> get = { v, stride };
+                return run(op,get,size,nthreads);
+            }
+
+            //Picks the fastest accessor for the elements of the array and applies op over all of them, flattening
+            //nested arrays
+            template <typename Op> static typename Op::Result apply(const Value &array, const Op &op, unsigned int nthreads) {
+                size_t size = array.getArraySize();
+                const TArray &storage = *array.data.array;
+                const TPacked *packed = storage.packed;
+                size_t begin = 0, stride = 1;
+                if (storage.slice && storage.slice->parent.data.array->packed) {
+                    packed = storage.slice->parent.data.array->packed;
+                    if (packed->shape.size() == 1) {
+                        begin = storage.slice->begin;
+                        stride = storage.slice->stride;
+                    } else {
+                        packed = NULL; //rows of a view are flattened below
+                    }
+                } else if (packed) {
+                    size = packed->count();
+                }
+                if (packed && !packed->nulls.empty()) return flattened(array,op,nthreads); //throws at the first null read
+                if (packed) {
+                    switch (packed->type) {
+                        case TINTEGER:
+                            return numbers(op,&packed->integers[begin],size,stride,nthreads);
+                        case TUINTEGER:
+                            return numbers(op,&packed->uintegers[begin],size,stride,nthreads);
+                        case TSTRING:
+                        case TBOOL:
+                            throw std::runtime_error("Cannot cast " + Value::prettyType(packed->type) + " to double");
+                        default:
+                            return numbers(op,&packed->reals[begin],size,stride,nthreads);
+                    }
+                }
+                if (storage.slice) {
+                    Elements get = { &array };
+                    for (size_t i = 0; i < size; i++) {
+                        if (array.getElement(i).type == TARRAY) return flattened(array,op,nthreads);
+                    }
+                    return run(op,get,size,nthreads);
+                }
+                const Value *v = size ? &storage[0] : NULL;
+                Type type = size ? v[0].type : TNULL;
+                for (size_t i = 0; i < size; i++) {
+                    switch (v[i].type) {
+                        case TINTEGER:
+                        case TUINTEGER:
+                        case TREAL:
+                            if (v[i].type != type) type = TNULL;
+                            break;
+                        case TARRAY:
+                            return flattened(array,op,nthreads);
+                        default:
+                            throw std::runtime_error("Cannot cast " + Value::prettyType(v[i].type) + " to double");
+                    }
+                }
+                switch (type) {
+                    case TINTEGER: {
+                        Integers get = { v };
+                        return run(op,get,size,nthreads);
+                    }
+                    case TUINTEGER: {
+                        UIntegers get = { v };
+                        return run(op,get,size,nthreads);
+                    }
+                    case TREAL: {
+                        Reals get = { v };
+                        return run(op,get,size,nthreads);
+                    }
+                    default: {
+                        Numbers get = { v };
+                        return run(op,get,size,nthreads);
+                    }
+                }
+            }
+
+            //Applies op over a copy of the numbers of a nested array
+            template <typename Op> static typename Op::Result flattened(const Value &array, const Op &op, unsigned int nthreads) {
+                const std::vector<double> flat = array.toVector<double>();
+                return numbers(op,flat.empty() ? NULL : &flat[0],flat.size(),1,nthreads);
+            }
+
+            //Sum of the (optionally squared deviations of) elements
+            static Sum::Result sum(const Value &array, unsigned int nthreads, bool deviation = false, TReal mean = 0.0) {
+                Sum op = { deviation, mean };
+                return apply(array,op,nthreads);
+            }
+
+            //Extrema of the elements, throwing a runtime_error if there are none
+            static Extrema::Result extrema(const Value &array, unsigned int nthreads) {
+                const Extrema::Result r = apply(array,Extrema(),nthreads);
+                if (!r.n) throw std::runtime_error("Cannot reduce an empty JSON array");
+                return r;
+            }
+    };
+
+    TReal Value::sum(unsigned int nthreads) const {
+        return Reduction::sum(*this,nthreads).sum;
+    }
+
+    TReal Value::min(unsigned int nthreads) const {
+        return Reduction::extrema(*this,nthreads).min;
+    }
+
+    TReal Value::max(unsigned int nthreads) const {
+        return Reduction::extrema(*this,nthreads).max;
+    }
+
+    TReal Value::mean(unsigned int nthreads) const {
+        const Reduction::Sum::Result r = Reduction::sum(*this,nthreads);
+        if (!r.n) throw std::runtime_error("Cannot reduce an empty JSON array");
+        return r.sum / r.n;
+    }
+
+    TReal Value::variance(unsigned int nthreads) const {
+        const Reduction::Sum::Result r = Reduction::sum(*this,nthreads,true,mean(nthreads));
+        return r.sum / r.n;
+    }
+
+    size_t Value::argmax(unsigned int nthreads) const {
+        return Reduction::extrema(*this,nthreads).argmax;
+    }
+
+    std::vector<size_t> Value::histogram(size_t nbins, TReal lo, TReal hi, unsigned int nthreads) const {
+        if (nbins == 0 || !(hi > lo)) throw std::runtime_error("Histogram needs at least one bin over a non-empty range");
+        Reduction::Histogram op;
+        op.nbins = nbins;
+        op.lo = lo;
+        op.hi = hi;
+        return Reduction::apply(*this,op,nthreads);
+    }
+
+    size_t Value::countTrue() const {
+        const size_t size = getArraySize();
+        const TArray &array = *data.array;
+        if (array.packed && array.packed->type == TBOOL && array.packed->shape.size() == 1) {
+            // four independent counts so the words are counted in parallel lanes
+            const std::vector<uint64_t> &bits = array.packed->bits;
+            size_t lanes[4] = { 0, 0, 0, 0 }, i = 0;
+            for ( ; i + 4 <= bits.size(); i += 4) {
+                lanes[0] += __builtin_popcountll(bits[i]);
+                lanes[1] += __builtin_popcountll(bits[i+1]);
+                lanes[2] += __builtin_popcountll(bits[i+2]);
+                lanes[3] += __builtin_popcountll(bits[i+3]);
+            }
+            for ( ; i < bits.size(); i++) lanes[0] += __builtin_popcountll(bits[i]);
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+        if (array.packed) wrongType(array.packed->shape.size() == 1 ? array.packed->type : TARRAY,TBOOL);
+        size_t count = 0;
+        for (size_t i = 0; i < size; i++) count += getElement(i).getBool();
+        return count;
+    }
+
+    bool Value::any() const {
+        checkType(TARRAY);
+        const TArray &array = *data.array;
+        if (array.packed && array.packed->type == TBOOL && array.packed->shape.size() == 1) {
+            const std::vector<uint64_t> &bits = array.packed->bits;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < bits.size(); i++) seen |= bits[i];
+            return seen != 0;
+        }
+        return countTrue() != 0;
+    }
+
+    bool Value::all() const {
+        checkType(TARRAY);
+        const TArray &array = *data.array;
+        if (array.packed && array.packed->type == TBOOL && array.packed->shape.size() == 1) {
+            // every word but the last is all ones, and the last has ones up to the last bool
+            const std::vector<uint64_t> &bits = array.packed->bits;
+            const size_t full = array.packed->booleans >> 6, rest = array.packed->booleans & 63;
+            uint64_t missing = 0;
+            for (size_t i = 0; i < full; i++) missing |= ~bits[i];
+            if (rest) missing |= bits[full] ^ ((1ull << rest) - 1);
+            return missing == 0;
+        }
+        return countTrue() == getArraySize();
     }
 
     std::string Value::toJSONString() {
@@ -117,6 +939,86 @@ namespace json {
         throw std::runtime_error(pretty.str());
     }
 
+    Path::Path(const std::string &path) {
+        size_t pos = 0;
+        while (pos < path.size()) {
+            Step step;
+            if (path[pos] == '[') {
+                const size_t close = path.find(']',pos);
+                char *end;
+                step.isIndex = true;
+                step.index = strtoul(path.c_str()+pos+1,&end,10);
+                if (close == std::string::npos || end != path.c_str()+close || close == pos+1) {
+                    throw std::runtime_error("Malformed index in path " + path);
+                }
+                pos = close+1;
+            } else {
+                const size_t end = path.find_first_of(".[",pos);
+                step.isIndex = false;
+                step.index = 0;
+                step.key = path.substr(pos,end == std::string::npos ? std::string::npos : end-pos);
+                if (step.key.empty()) throw std::runtime_error("Empty member name in path " + path);
+                pos = end == std::string::npos ? path.size() : end;
+            }
+            steps.push_back(step);
+            if (pos < path.size() && path[pos] == '.') {
+                if (++pos == path.size()) throw std::runtime_error("Empty member name in path " + path);
+            }
+        }
+    }
+
+    Value Path::get(const Value &root) const {
+        return find(root).copy();
+    }
+
+    ConstValueRef Path::find(ConstValueRef root) const {
+        ConstValueRef value = root;
+        for (size_t i = 0; i < steps.size(); i++) {
+            const Step &step = steps[i];
+            if (step.isIndex) {
+                if (value.getType() != TARRAY || step.index >= value.getArraySize()) return ConstValueRef::null;
+                value = value.getIndex(step.index);
+            } else {
+                if (value.getType() != TOBJECT) return ConstValueRef::null;
+                value = value.getMember(step.key); //null if missing
+            }
+        }
+        return value;
+    }
+
+    const Value ConstValueRef::null;
+
+    ConstValueRef ConstValueRef::getMember(const TString &key) const {
+        checkType(TOBJECT);
+        const Value *member = value->data.object->member(key);
+        return ConstValueRef(member ? *member : null);
+    }
+
+    ConstValueRef ConstValueRef::getStored(size_t index) const {
+        const TArray &array = *value->data.array;
+        if (!position && array.slice) {
+            array.slice->check();
+            return ConstValueRef(array.slice->parent).getIndex(array.slice->begin + index*array.slice->stride);
+        }
+        const TPacked &packed = storage();
+        if (packed.shape.size() > 0xFFFF) throw std::runtime_error("Packed array has too many dimensions to be borrowed");
+        size_t stride = 1;
+        for (size_t d = dim()+1; d < packed.shape.size(); d++) stride *= packed.shape[d];
+        return ConstValueRef(*value,dim()+1,offset() + index*stride);
+    }
+
+    Value ConstValueRef::copy() const {
+        if (!position) return *value;
+        const TPacked &packed = storage();
+        if (dim() == packed.shape.size()) return packed.at(offset());
+        const std::vector<size_t> shape(packed.shape.begin()+dim(),packed.shape.end());
+        size_t size = 1;
+        for (size_t d = 0; d < shape.size(); d++) size *= shape[d];
+        Value row(TARRAY);
+        row.data.array->packed = packed.range(offset(),size,shape);
+        return row;
+    }
+
     parser_error::parser_error(const int line_, const int pos_, std::string desc_) : line(line_), pos(pos_), desc(desc_)  {
         std::stringstream prettyss;
         prettyss << '[' << line << ':' << pos << "] " << desc;
@@ -129,6 +1031,19 @@ namespace json {
         return pretty.c_str();
     }
 
+    limit_error::limit_error(const int line_, const int pos_, std::string desc_) : parser_error(line_,pos_,desc_) { }
+
+    ReaderLimits ReaderLimits::untrusted() {
+        ReaderLimits limits;
+        limits.maxBytes = 256 << 20;
+        limits.maxElements = 16 << 20;
+        limits.maxRepetitions = 1 << 20;
+        limits.maxDepth = 256;
+        limits.maxString = 16 << 20;
+        limits.maxSeconds = 10;
+        return limits;
+    }
+
     Reader::Reader(std::istream &in) {
         std::string ret;
         char buffer[4096];
@@ -139,8 +1054,11 @@ namespace json {
         cur = data;
         memcpy(data,ret.c_str(),ret.length());
         data[ret.length()] = '\0';
+        end = data + ret.length() + 1;
         line = 1;
         lastbr = cur;
+        predicting = false;
+        setLimits(ReaderLimits());
     }
 
     Reader::Reader(const std::string &str) {
@@ -148,15 +1066,53 @@ namespace json {
         cur = data;
         memcpy(data,str.c_str(),str.length());
         data[str.length()] = '\0';
+        end = data + str.length() + 1;
         line = 1;
         lastbr = cur;
+        predicting = false;
+        setLimits(ReaderLimits());
     }
 
     Reader::~Reader() {
         delete [] data;
+        for (size_t i = 0; i < shapes.size(); i++) TShape::release(shapes[i]);
+        setPrediction(false);
+    }
+
+    void Reader::setPrediction(bool enabled) {
+        predicting = enabled;
+        if (enabled) return;
+        for (size_t i = 0; i < predictions.size(); i++) {
+            for (size_t j = 0; j < predictions[i].size(); j++) TShape::release(predictions[i][j]);
+        }
+        predictions.clear();
+    }
+
+    void Reader::setLimits(const ReaderLimits &limits) {
+        const size_t unbounded = std::numeric_limits<size_t>::max();
+        maxBytes = limits.maxBytes ? limits.maxBytes : unbounded;
+        maxElements = limits.maxElements ? limits.maxElements : unbounded;
+        maxRepetitions = limits.maxRepetitions ? limits.maxRepetitions : unbounded;
+        maxDepth = limits.maxDepth ? limits.maxDepth : unbounded;
+        maxString = limits.maxString ? limits.maxString : unbounded;
+        timed = limits.maxSeconds > 0;
+        maxTime = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(limits.maxSeconds));
+    }
+
+    void Reader::exceeded(const char *desc) {
+        throw limit_error(line,cur-lastbr,desc);
     }
 
     bool Reader::getValue(Value &result) {
+        bytes = elements = depth = 0;
+        keys.clear();
+        values.clear();
+        if (timed) deadline = std::chrono::steady_clock::now() + maxTime;
+        return readValue(result);
+    }
+
+    bool Reader::readValue(Value &result) {
+        charge(sizeof(Value),1);
         for (;;) {
             switch (*cur) {
                 case '\n':
@@ -399,16 +1355,20 @@ namespace json {
         throw parser_error(line,cur-lastbr,"Should never reach here. Probably hardware error.");
     }
 
-    Value Reader::readString() {
+    char* Reader::scanString(size_t &length, bool &escaped) {
         char *start = ++cur;
+        escaped = false;
         for (;;) {
             switch (*(cur++)) {
                 case '\\':
                     cur++; //definitely an escape, so skip next character
+                    escaped = true;
                     break;
                 case '\"':
+                    length = cur-1-start;
+                    if (length > maxString) exceeded("String exceeds the length limit");
                     cur[-1] = '\0';
-                    return Value(unescapeString(std::string(start)));
+                    return start;
                 case '\0':
                     throw parser_error(line,cur-lastbr,"Reached EOF while parsing string");
             }
@@ -416,10 +1376,29 @@ namespace json {
         throw parser_error(line,cur-lastbr,"Should never reach here. Probably hardware error.");
     }
 
-    Value Reader::readObject() {
+    Value Reader::readString() {
+        size_t length;
+        bool escaped;
+        const char *start = scanString(length,escaped);
+        charge(sizeof(TString)+length,0);
+        return Value(escaped ? unescapeString(std::string(start,length)) : TString(start,length));
+    }
+
+    Value Reader::readObject(bool shared) {
+        if (++depth > maxDepth) exceeded("Object exceeds the depth limit");
+        charge(sizeof(TObject),0);
         Value object = Value();
         object.reset(TOBJECT);
-        char *key = NULL;
+        const size_t first = keys.size();
+        // the predicted shape, while the keys read match it
+        TShape *guess = NULL;
+        if (predicting) {
+            shared = true;
+            if (predictions.size() < depth) predictions.resize(depth);
+        }
+        // keys are used where they lie in the data, so they are only scanned once
+        const char *key = NULL;
+        size_t length = 0;
         bool keyfound = false;
         Value val = Value();
         cur++;
@@ -435,7 +1414,7 @@ namespace json {
                 case ' ':
                 case '\t':
                     if (key && !keyfound) {
-                        *cur = '\0';
+                        length = cur-key;
                         keyfound = true;
                     }
                     cur++;
@@ -445,6 +1424,17 @@ namespace json {
                     if (key) {
                         throw parser_error(line,cur-lastbr,"} found where value expected");
                     }
+                    depth--;
+                    if (!predicting) {
+                        if (shared) shapeObject(*object.data.object,first,shapes[depth-1]);
+                    } else if (guess && guess->order.size() == keys.size()-first) {
+                        fillObject(*object.data.object,first,guess);
+                        predict(guess);
+                    } else if (keys.size() > first) {
+                        TShape *made = NULL;
+                        shapeObject(*object.data.object,first,made);
+                        predict(made);
+                    }
                     return object;
                 case ',':
                     cur++;
@@ -456,37 +1446,148 @@ namespace json {
                     if (!key) {
                         throw parser_error(line,cur-lastbr,": found where field expected");
                     }
-                    if (key && !keyfound) *cur = '\0';
+                    if (!keyfound) length = cur-key;
                     cur++;
-                    if (!getValue(val)) {
+                    if (length > maxString) exceeded("Key exceeds the length limit");
+                    charge(length+64,0); //roughly a map node and the key
+                    if (!readValue(val)) {
                         throw parser_error(line,cur-lastbr,"EOF reached while parsing object");
                     }
-                    object.setMember(std::string(key),val);
+                    if (shared) {
+                        keys.push_back(std::make_pair(key,length));
+                        values.push_back(val);
+                    } else {
+                        object.setMember(key,length,val);
+                    }
                     key = NULL;
                     keyfound = false;
                     break;
-                case '\"':
-                    cur++;
-                    key = cur;
-                    readString();
+                case '\"': {
+                    key = cur+1;
+                    const char *quote = predicting && predictKey(guess,keys.size()-first,key,true,length) ? key+length : scanKey(key,end,NULL);
+                    if (*quote != '"') {
+                        cur = (char*)quote;
+                        throw parser_error(line,cur-lastbr,"Reached EOF while parsing string");
+                    }
+                    length = quote-key;
+                    cur = (char*)quote+1;
                     keyfound = true;
                     break;
+                }
                 case '\0':
                     throw parser_error(line,cur-lastbr,"Reached EOF while parsing object");
                 default:
                     if (keyfound) {
                         throw parser_error(line,cur-lastbr,"Unexpected character where value expected");
                     }
-                    if (!key) key = cur;
+                    if (!key) {
+                        key = cur;
+                        if (predicting && predictKey(guess,keys.size()-first,key,false,length)) {
+                            cur += length;
+                            keyfound = true;
+                            break;
+                        }
+                    }
                     cur++;
             }
         }
         throw parser_error(line,cur-lastbr,"Should never reach here. Probably hardware error.");
     }
 
+    void Reader::shapeObject(TObject &object, size_t first, TShape *&shape) {
+        const size_t count = keys.size() - first;
+        const std::pair<const char*,size_t> *read = &keys[first];
+        bool same = shape && shape->order.size() == count;
+        for (size_t i = 0; same && i < count; i++) {
+            const TString &key = shape->keys[shape->order[i]];
+            same = key.size() == read[i].second && !memcmp(key.data(),read[i].first,key.size());
+        }
+        if (!same) {
+            std::vector<size_t> sorted(count);
+            for (size_t i = 0; i < count; i++) sorted[i] = i;
+            std::stable_sort(sorted.begin(),sorted.end(),[read](size_t a, size_t b) {
+                const int order = memcmp(read[a].first,read[b].first,std::min(read[a].second,read[b].second));
+                return order ? order < 0 : read[a].second < read[b].second;
+            });
+            TShape *made = new TShape;
+            made->order.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                const std::pair<const char*,size_t> &key = read[sorted[i]];
+                if (made->keys.empty() || made->keys.back().compare(0,TString::npos,key.first,key.second)) {
+                    made->keys.push_back(TString(key.first,key.second));
+                }
+                made->order[sorted[i]] = made->keys.size()-1; //so later duplicates replace earlier ones
+            }
+            TShape::release(shape);
+            shape = made;
+        }
+        fillObject(object,first,shape);
+    }
+
+    void Reader::fillObject(TObject &object, size_t first, TShape *shape) {
+        const size_t count = keys.size() - first;
+        TShape::acquire(shape);
+        object.shape = shape;
+        object.slots.resize(shape->keys.size());
+        for (size_t i = 0; i < count; i++) {
+            object.slots[shape->order[i]] = values[first+i];
+        }
+        keys.resize(first);
+        values.resize(first);
+    }
+
+    bool Reader::predictKey(TShape *&guess, size_t position, const char *text, bool quoted, size_t &length) {
+        // the predicted key must lie within the data and be followed by the end of a quoted or bare key
+        const char *last = end;
+        auto matches = [text,quoted,last,position,&length](const TShape *shape) {
+            const TString &key = shape->keys[shape->order[position]];
+            if (key.size() >= (size_t)(last-text)) return false;
+            const char after = text[key.size()];
+            if (quoted ? after != '"' : after != ':' && after != ' ' && after != '\t' && after != '\n' && after != '\r') return false;
+            if (memcmp(text,key.data(),key.size())) return false;
+            length = key.size();
+            return true;
+        };
+        if (position == 0) {
+            const std::vector<TShape*> &recent = predictions[depth-1];
+            for (size_t i = 0; i < recent.size(); i++) {
+                if (!recent[i]->order.empty() && matches(recent[i])) {
+                    guess = recent[i];
+                    return true;
+                }
+            }
+        } else if (guess && position < guess->order.size() && matches(guess)) {
+            return true;
+        }
+        guess = NULL;
+        return false;
+    }
+
+    void Reader::predict(TShape *shape) {
+        std::vector<TShape*> &recent = predictions[depth];
+        std::vector<TShape*>::iterator at = std::find(recent.begin(),recent.end(),shape);
+        if (at != recent.end()) {
+            std::rotate(recent.begin(),at,at+1);
+            return;
+        }
+        if (recent.size() == PREDICTIONS) {
+            TShape::release(recent.back());
+            recent.pop_back();
+        }
+        recent.insert(recent.begin(),shape);
+    }
+
     Value Reader::readArray() {
+        if (++depth > maxDepth) exceeded("Array exceeds the depth limit");
+        charge(sizeof(TArray),0);
+        if (shapes.size() < depth) shapes.resize(depth,NULL);
+        TShape::release(shapes[depth-1]);
+        shapes[depth-1] = NULL;
         Value array = Value();
         array.reset(TARRAY);
+        TArray &storage = *array.data.array;
+        // strings are read straight into packed storage until an element of another type turns up
+        TPacked *strings = NULL;
         Value next = Value();
         cur++;
         for (;;) {
@@ -506,31 +1607,85 @@ namespace json {
                 case ':':  { //non-json value repetition
                     cur++;
                     Value reps;
-                    if (!getValue(reps) || reps.getType() != TINTEGER || reps.getInteger() < 0) {
+                    if (!readValue(reps) || reps.getType() != TINTEGER || reps.getInteger() < 0) {
                         throw parser_error(line,cur-lastbr,"Array value repetition syntax error");
                     }
-                    const int nreps = reps.getInteger();
+                    const size_t nreps = reps.getInteger();
+                    const size_t last = strings ? strings->count()-1 : 0;
+                    const size_t each = strings ? sizeof(size_t) + strings->length(last) : sizeof(Value);
+                    // Checked before reserving, and without overflow since the counts come from the input
+                    if (nreps > maxRepetitions) exceeded("Array value repetition exceeds the repetition limit");
+                    if (nreps > maxElements - elements) exceeded("Array value repetition exceeds the element limit");
+                    if (nreps > (maxBytes - bytes)/each) exceeded("Array value repetition exceeds the byte limit");
                     // The value to be repeated has already been pushed once
                     if (nreps == 0) {
-                        array.data.array->pop_back();
+                        if (!strings) {
+                            storage.pop_back();
+                        } else if (last) {
+                            strings->ends.pop_back();
+                            strings->characters.resize(strings->ends.back()+1);
+                        } else { //packed arrays are never empty
+                            delete strings;
+                            storage.packed = strings = NULL;
+                        }
+                    } else if (strings) {
+                        charge((nreps-1)*each,nreps-1);
+                        const size_t length = strings->length(last);
+                        strings->characters.reserve(strings->characters.size() + (nreps-1)*(length+1));
+                        strings->ends.reserve(strings->ends.size() + nreps - 1);
+                        for (size_t i = 1; i < nreps; i++) {
+                            strings->push(strings->chars(last),length);
+                        }
                     } else {
-                        array.data.array->reserve(array.data.array->size() + nreps - 1);
-                        for (int i = 1; i < nreps; i++) {
-                            array.data.array->push_back(next);
+                        charge((nreps-1)*each,nreps-1);
+                        storage.reserve(storage.size() + nreps - 1);
+                        for (size_t i = 1; i < nreps; i++) {
+                            storage.push_back(next);
                         }
                     }
                     break;
                 }
                 case ']':
                     cur++;
+                    if (strings) {
+                        strings->shape.push_back(strings->count());
+                    } else {
+                        storage.pack();
+                    }
+                    TShape::release(shapes[depth-1]);
+                    shapes[depth-1] = NULL;
+                    depth--;
                     return array;
                 case '\0':
                     throw parser_error(line,cur-lastbr,"Reached EOF while parsing array");
+                case '"':
+                    if (strings || storage.empty()) {
+                        size_t length;
+                        bool escaped;
+                        const char *start = scanString(length,escaped);
+                        charge(sizeof(size_t)+length,1);
+                        if (!strings) storage.packed = strings = new TPacked(TSTRING);
+                        if (escaped) {
+                            const std::string unescaped = unescapeString(std::string(start,length));
+                            strings->push(unescaped.data(),unescaped.size());
+                        } else {
+                            strings->push(start,length);
+                        }
+                        break;
+                    }
                 default:
-                    if (!getValue(next)) {
+                    if (strings) { //not all strings after all
+                        strings->shape.push_back(strings->count());
+                        storage.expand();
+                        strings = NULL;
+                    }
+                    if (*cur == '{') {
+                        charge(sizeof(Value),1);
+                        next = readObject(true);
+                    } else if (!readValue(next)) {
                         throw parser_error(line,cur-lastbr,"EOF reached while parsing array");
                     }
-                    array.data.array->push_back(next);
+                    storage.push_back(next);
             }
         }
         throw parser_error(line,cur-lastbr,"Should never reach here. Probably hardware error.");
@@ -566,32 +1721,32 @@ namespace json {
                 break;
             case TOBJECT: {
                     const std::string nextdepth(depth+"    ");
-                    TObject::iterator it = value.data.object->begin();
-                    TObject::iterator end = value.data.object->end();
+                    bool first = true;
                     out << "{\n";
-                    if (it != end) {
-                        out << nextdepth << '\"' << it->first << "\" : ";
-                        writeValue(it->second,nextdepth);
-                        it++;
-                    }
-                    for ( ; it != end; it++) {
-                        out << ",\n" << nextdepth << '\"' << it->first << "\" : ";
-                        writeValue(it->second,nextdepth);
-                    }
+                    value.data.object->each([&](const TString &key, const Value &member) {
+                        out << (first ? "" : ",\n") << nextdepth << '\"' << key << "\" : ";
+                        writeValue(member,nextdepth);
+                        first = false;
+                    });
                     out << '\n' << depth << '}';
                 }
                 break;
             case TARRAY: {
-                    TArray::iterator it = value.data.array->begin();
-                    TArray::iterator end = value.data.array->end();
-                    out << '[';
-                    if (it != end) {
-                        writeValue(*it);
-                        it++;
+                    if (value.data.array->packed) {
+                        size_t offset = 0;
+                        writePacked(*value.data.array->packed,0,offset);
+                        break;
                     }
-                    for ( ; it != end; it++) {
-                        out << ", ";
-                        writeValue(*it);
+                    const size_t size = value.getArraySize();
+                    const bool view = value.data.array->slice;
+                    out << '[';
+                    for (size_t i = 0; i < size; i++) {
+                        if (i) out << ", ";
+                        if (view) {
+                            writeValue(value.getElement(i));
+                        } else {
+                            writeValue((*value.data.array)[i]);
+                        }
                     }
                     out << ']';
                 }
@@ -604,6 +1759,21 @@ namespace json {
         }
     }
 
+    void Writer::writePacked(const TPacked &packed, size_t dim, size_t &offset) {
+        const size_t size = packed.shape[dim];
+        const bool inner = dim+1 == packed.shape.size();
+        out << '[';
+        for (size_t i = 0; i < size; i++) {
+            if (i) out << ", ";
+            if (inner) {
+                writeValue(packed.at(offset++));
+            } else {
+                writePacked(packed,dim+1,offset);
+            }
+        }
+        out << ']';
+    }
+
     //https://tools.ietf.org/rfc/rfc7159.txt
     std::string Writer::escapeString(std::string unescaped) {
         std::stringstream escaped;
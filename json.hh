@@ -19,16 +19,36 @@
 #define _JSON
 
 #include <vector>
+#include <cstring>
+#include <cstdint>
 #include <map>
+#include <unordered_map>
+#include <iterator>
+#include <type_traits>
 #include <stdexcept>
 #include <string>
 #include <sstream>
+#include <chrono>
+#include <atomic>
 
 namespace json {
 
     class Value;
     class Reader;
     class Writer;
+    class Reduction;
+    class TSlice;
+    class TPacked;
+    class TObject;
+    class TIndexes;
+    class Frozen;
+    class FrozenValue;
+    class FrozenBuilder;
+    class CBinding;
+    class ConstValueRef;
+    namespace parallel {
+        class Elements;
+    }
 
     //types used by Value
     typedef long int TInteger;
@@ -36,8 +56,106 @@ namespace json {
     typedef double TReal;
     typedef bool TBool;
     typedef std::string TString;
-    typedef std::map<TString,Value> TObject;
-    typedef std::vector<Value> TArray;
+
+    //Reference counts of structured types. Build with -DJSON_ATOMIC_REFCOUNT to copy and destroy Values that share
+    //data on several threads at once, at the cost of an atomic operation per copy.
+#ifdef JSON_ATOMIC_REFCOUNT
+    typedef std::atomic<TUInteger> TRefCount;
+#else
+    typedef TUInteger TRefCount;
+#endif
+
+    //The sorted keys shared by objects read with the same members (see TObject). Shapes are not modified once
+    //made, and are freed with the last object using them.
+    class TShape {
+        public:
+            inline TShape() : references(0) { }
+
+            //Returns the slot of a key, or the number of keys if it is not one of them
+            size_t find(const char *key, size_t length) const;
+            inline size_t find(const TString &key) const { return find(key.data(),key.size()); }
+
+            std::vector<TString> keys;
+
+            //The slot of each key in the order they were read, so that objects written alike match in order
+            std::vector<size_t> order;
+
+            //Adds or drops a reference, freeing the shape with the last one
+            static inline void acquire(TShape *shape) { if (shape) shape->references++; }
+            static inline void release(TShape *shape) { if (shape && !(shape->references--)) delete shape; }
+
+            //Holders of the shape, less one (as for Values). Always atomic, whatever TRefCount is: the elements of
+            //an array read with the same keys share one shape, so copying, expanding or destroying distinct elements
+            //on different threads touches this one count.
+            std::atomic<size_t> references;
+    };
+
+    //JSON objects are a map of members, unless they were read with the same keys as other objects (arrays of
+    //records, see Reader), in which case they share a TShape of the keys and hold only the values, one slot per
+    //key. The map then stays empty until a member is added, when the object is expanded.
+    class TObject : public std::map<TString,Value> {
+        public:
+            using std::map<TString,Value>::map;
+            inline TObject() { }
+            TObject(const TObject &other);
+            ~TObject();
+            TObject& operator=(const TObject &other);
+
+            //Moves the slots into the map, so the object no longer uses its shape
+            void expand();
+
+            //Number of members
+            inline size_t memberCount() const { return shape ? slots.size() : size(); }
+
+            //The value of a member, or NULL if there is none
+            inline Value* member(const TString &key);
+            inline const Value* member(const TString &key) const { return const_cast<TObject*>(this)->member(key); }
+
+            //The value of a member, or NULL, without making a TString of the key. Objects that are not shaped (e.g.
+            //modified since they were read) are searched member by member.
+            inline const Value* member(const char *key, size_t length) const;
+
+            //Calls f(key,value) for each member in key order
+            template <typename F> inline void each(F f) const;
+
+            //Non-NULL if the values of the members are slots in the order of the keys of a shape
+            TShape *shape = NULL;
+            std::vector<Value> slots;
+    };
+
+    //JSON arrays are a vector of Values, unless they are a view of part of another array (see Value::slice) or
+    //hold their numbers, strings or bools contiguously (see TPacked), in which case the vector stays empty until
+    //the array is detached or expanded.
+    class TArray : public std::vector<Value> {
+        public:
+            using std::vector<Value>::vector;
+            inline TArray() { }
+            TArray(const TArray &other);
+            ~TArray();
+            TArray& operator=(const TArray &other);
+
+            //Copies the viewed elements into this array so it no longer depends on the parent
+            void detach();
+
+            //Stores the elements contiguously if they are numbers of one type (some of which may be null), strings,
+            //bools, or equally shaped packed arrays
+            void pack();
+
+            //Converts packed elements into Values (nested dimensions become packed arrays of their own)
+            void expand();
+
+            //Non-NULL if this array is a view
+            TSlice *slice = NULL;
+
+            //Non-NULL if this array stores its elements contiguously
+            TPacked *packed = NULL;
+
+            //Cached secondary indexes (see Value::findElements), created by whichever find comes first
+            std::atomic<TIndexes*> indexes{NULL};
+
+            //Counts modifications through the setters so that stale indexes are rebuilt
+            size_t revision = 0;
+    };
 
     typedef union {
         //basic types by value
@@ -51,6 +169,12 @@ namespace json {
         TArray *array;
     } TData;
 
+    //kinds of secondary index on the members of a JSON array of objects
+    enum IndexType {
+        HASHED, //equality lookups in constant time
+        SORTED  //equality and range lookups in logarithmic time
+    };
+
     //type ids used by Value
     enum Type {
         TINTEGER,
@@ -63,11 +187,47 @@ namespace json {
         TNULL
     };
 
+#ifndef __CINT__
+    //How arrays of a C++ type are stored: numbers (other than bool) are packed into contiguous storage of the
+    //Type they convert to, and anything else becomes a Value per element
+    template <typename T, typename Enable = void> struct Packing {
+        static const bool packed = false;
+    };
+
+    template <typename T> struct Packing<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+        static const bool packed = true;
+        static const Type type = TREAL;
+        typedef TReal Storage;
+    };
+
+    template <typename T> struct Packing<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type> {
+        static const bool packed = true;
+        static const Type type = TINTEGER;
+        typedef TInteger Storage;
+    };
+
+    template <typename T> struct Packing<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && !std::is_same<T,bool>::value>::type> {
+        static const bool packed = true;
+        static const Type type = TUINTEGER;
+        typedef TUInteger Storage;
+    };
+#endif
+
     //JSON Value container class. Basic types (int,uint,real,bool) are stored by value, and structured types are stored by reference.
     class Value {
 
         friend class Reader;
         friend class Writer;
+        friend class Reduction;
+        friend class TArray;
+        friend class TSlice;
+        friend class TIndexes;
+        friend class Frozen;
+        friend class FrozenValue;
+        friend class FrozenBuilder;
+        friend class parallel::Elements;
+        friend class CBinding;
+        friend class ConstValueRef;
 
         public:
 
@@ -88,18 +248,44 @@ namespace json {
             explicit inline Value(int integer) : refcount(NULL), type(TINTEGER) { data.integer = (TInteger)integer; }
 
             // Construct structured types. These values are copied into the Value and subsequently passed by reference with refcount.
-            explicit inline Value(TString string) : refcount(new TUInteger(0)), type(TSTRING) { data.string = new TString(string); }
-            explicit inline Value(TObject object) : refcount(new TUInteger(0)), type(TOBJECT) { data.object = new TObject(object); }
-            explicit inline Value(TArray array) : refcount(new TUInteger(0)), type(TARRAY) { data.array = new TArray(array); }
+            explicit inline Value(TString string) : refcount(new TRefCount(0)), type(TSTRING) { data.string = new TString(string); }
+            explicit inline Value(TObject object) : refcount(new TRefCount(0)), type(TOBJECT) { data.object = new TObject(object); }
+            explicit inline Value(TArray array) : refcount(new TRefCount(0)), type(TARRAY) { data.array = new TArray(array); }
 
-            // Constructs a JSON array from a vector (assuming the compile type conversions are possible)
-            template <typename T> Value(const std::vector<T> &ref) : refcount(new TUInteger(0)), type(TARRAY) {
+#ifndef __CINT__
+            // Bulk constructors of JSON arrays. Elements that are numbers (see Packing) are converted straight into
+            // packed storage with one allocation, and other elements are constructed as Values (assuming the
+            // compile type conversions are possible).
+            template <typename T> Value(const std::vector<T> &ref) : refcount(NULL), type(TNULL) { assign(ref.begin(),ref.end()); }
+            template <typename T> Value(const T *elements, size_t count) : refcount(NULL), type(TNULL) { assign(elements,elements+count); }
+            template <typename It, typename = typename std::iterator_traits<It>::iterator_category> Value(It begin, It end) : refcount(NULL), type(TNULL) { assign(begin,end); }
+
+            // Moves a vector into a JSON array. Vectors of TInteger, TUInteger, TReal or Value become its storage
+            // without copying their elements.
+            template <typename T> Value(std::vector<T> &&ref) : refcount(NULL), type(TNULL) { adopt(ref); }
+
+            // Constructs a JSON object from the members of a map
+            template <typename T> explicit Value(const std::map<std::string,T> &members) : refcount(new TRefCount(0)), type(TOBJECT) {
+                data.object = new TObject;
+                for (typename std::map<std::string,T>::const_iterator it = members.begin(); it != members.end(); ++it) {
+                    data.object->emplace_hint(data.object->end(),it->first,Value(it->second)); //already in key order
+                }
+            }
+            template <typename T> explicit Value(const std::unordered_map<std::string,T> &members) : refcount(new TRefCount(0)), type(TOBJECT) {
+                data.object = new TObject;
+                for (typename std::unordered_map<std::string,T>::const_iterator it = members.begin(); it != members.end(); ++it) {
+                    data.object->emplace(it->first,Value(it->second));
+                }
+            }
+#else
+            template <typename T> Value(const std::vector<T> &ref) : refcount(new TRefCount(0)), type(TARRAY) {
                 const size_t size = ref.size();
                 data.array = new TArray(size);
                 for (size_t i = 0; i < size; i++) {
                     (*data.array)[i] = Value(ref[i]);
                 }
             }
+#endif
 
             // Copy constructor - preserves structured types and refcount tracking
             inline Value(const Value &other) : refcount(other.refcount), type(other.type), data(other.data) { incref(); }
@@ -111,8 +297,10 @@ namespace json {
             inline Value& operator=(const Value& other) { decref(); data = other.data; type = other.type; refcount = other.refcount; incref(); return *this; }
             template <typename T> inline Value& operator=(const T& val) { return operator=(Value(val)); }
 
-            inline Value& operator[](const std::string &key) const { return getMember(key); }
-            inline Value& operator[](const size_t index) const { return getIndex(index); }
+            inline Value& operator[](const std::string &key) { return getMember(key); }
+            inline const Value& operator[](const std::string &key) const { return getMember(key); }
+            inline Value& operator[](const size_t index) { return getIndex(index); }
+            inline ConstValueRef operator[](const size_t index) const;
 
             // Initializes the state of the Value to the default for structured types or unspecified for basic types
             void reset(Type type);
@@ -130,14 +318,43 @@ namespace json {
             inline TBool getBool() const { checkType(TBOOL); return data.boolean; }
             inline TString getString() const { checkType(TSTRING); return *data.string; }
 
-            // Returns a member of a JSON object
-            inline Value& getMember(TString key) const { checkType(TOBJECT); return (*data.object)[key]; }
+            // Returns a member of a JSON object, adding a null member if there is none. References to members
+            // of objects sharing a shape (see TObject) are invalidated when a member is added.
+            inline Value& getMember(TString key);
+
+            // Reads a member of a JSON object, or null if there is none, without modifying the object (so
+            // several threads may read one document through const Values)
+            inline const Value& getMember(TString key) const;
 
             // Returns the size of a JSON array
-            inline size_t getArraySize() const { checkType(TARRAY); return data.array->size(); }
+            inline size_t getArraySize() const;
+
+            // Returns the Value at an index in a JSON array, expanding packed arrays into Values first
+            inline Value& getIndex(size_t index);
+
+            // Reads the element at an index of a JSON array in place, without expanding packed arrays or
+            // modifying the array (so several threads may read one document through const Values)
+            inline ConstValueRef getIndex(size_t index) const;
+
+            // Returns a copy of the Value at an index in a JSON array. Like const getIndex this never expands packed
+            // numbers (rows of a multi-dimensional array are returned as new arrays).
+            inline Value getElement(size_t index) const;
 
-            // Returns the Value at an index in a JSON array
-            inline Value& getIndex(size_t index) const { checkType(TARRAY); return (*data.array)[index]; }
+            // Borrowed access to the NUL terminated characters of the string at an index in a JSON array, without
+            // expanding packed strings. The characters are valid until the array is modified.
+            inline const char* getChars(size_t index, size_t &length) const;
+
+            // Returns a copy of the Value at a multi-dimensional index, i.e. array[i][j][k]...
+            Value getElement(const std::vector<size_t> &index) const;
+
+            // Returns the extent of each dimension of a rectangular numeric JSON array, outermost first. Other
+            // arrays have a single dimension.
+            std::vector<size_t> shape() const;
+
+            // Returns an array viewing the elements [begin,end) in steps of stride without copying them. The view
+            // shares the elements of this array (setIndex writes through) until it is resized. If this array is
+            // shrunk past the view, reading, writing or resizing the view throws a runtime_error.
+            Value slice(size_t begin, size_t end, size_t stride = 1) const;
 
 #ifndef __CINT__
 
@@ -146,15 +363,9 @@ namespace json {
                 throw std::runtime_error("Cannot cast Value to desired type"); // Arbitrary type casts are impossible
             }
 
-            // Templated vector constructing method (uses templated casters to convert types)
-            template <typename T> inline std::vector<T> toVector() const {
-                const size_t size = getArraySize(); //will check that we are an array
-                std::vector<T> result(size);
-                for (size_t  i = 0; i < size; i++) {
-                    result[i] = (*data.array)[i].cast<T>();
-                }
-                return result;
-            }
+            // Templated vector constructing method (uses templated casters to convert types). Nested arrays are
+            // flattened in row-major order.
+            template <typename T> inline std::vector<T> toVector() const;
 
 #endif
 
@@ -164,6 +375,29 @@ namespace json {
             // Returns true if the key exists in the JSON object
             bool isMember(std::string key) const;
 
+            // Numeric reductions over a JSON array of numbers (throw a runtime_error for non-numeric elements).
+            // Nested arrays are reduced over all their numbers, and packed numbers are read in place. Arrays
+            // larger than a few hundred thousand elements are split across nthreads threads (0 = all cores).
+            TReal sum(unsigned int nthreads = 1) const;
+            TReal min(unsigned int nthreads = 1) const;
+            TReal max(unsigned int nthreads = 1) const;
+            TReal mean(unsigned int nthreads = 1) const;
+
+            // Population variance of the elements of a JSON array
+            TReal variance(unsigned int nthreads = 1) const;
+
+            // Returns the (flattened) index of the first largest element of a JSON array
+            size_t argmax(unsigned int nthreads = 1) const;
+
+            // Counts the elements of a JSON array falling in nbins uniform bins over [lo,hi) (others are ignored)
+            std::vector<size_t> histogram(size_t nbins, TReal lo, TReal hi, unsigned int nthreads = 1) const;
+
+            // Counts of a JSON array of bools (throw a runtime_error for other elements). Packed bools are counted
+            // a word of 64 at a time.
+            size_t countTrue() const;
+            bool any() const;
+            bool all() const;
+
             // Setters will reset the type if necessary
             inline void setInteger(TInteger integer)  { checkTypeReset(TINTEGER); data.integer = integer; }
             inline void setUINteger(TUInteger uinteger) { checkTypeReset(TUINTEGER); data.uinteger = uinteger; }
@@ -172,13 +406,46 @@ namespace json {
             inline void setString(TString string) { checkTypeReset(TSTRING); *data.string = string; }
 
             // Sets a member of a JSON object
-            inline void setMember(TString key, Value value) { checkTypeReset(TOBJECT); (*data.object)[key] = value; }
+            inline void setMember(TString key, Value value) { checkTypeReset(TOBJECT); getMember(key) = value; }
+
+            // Sets a member named by characters that need not be NUL terminated, constructing the key once.
+            // Appending in key order (as Writer writes objects) costs one comparison instead of a tree search.
+            inline void setMember(const char *key, size_t length, const Value &value) {
+                checkTypeReset(TOBJECT);
+                TObject &members = *data.object;
+                if (members.shape) {
+                    const size_t slot = members.shape->find(key,length);
+                    if (slot < members.slots.size()) {
+                        members.slots[slot] = value;
+                        return;
+                    }
+                    members.expand();
+                }
+                TString name(key,length);
+                if (members.empty() || members.rbegin()->first < name) {
+                    members.emplace_hint(members.end(),std::move(name),value);
+                } else {
+                    members[std::move(name)] = value;
+                }
+            }
 
-            // Sets the size of a JSON array
-            inline void setArraySize(size_t size) { checkTypeReset(TARRAY); data.array->resize(size); }
+            // Sets the size of a JSON array (views are detached from their parent first)
+            inline void setArraySize(size_t size);
 
             // Sets the Value at an index in a JSON array
-            inline void setIndex(size_t index, Value value) { checkTypeReset(TARRAY); (*data.array)[index] = value; }
+            inline void setIndex(size_t index, Value value);
+
+            // Returns the indices of the elements of a JSON array of objects whose member key equals match (numbers
+            // compare by value whatever their type). The index on key is built on first use and kept with the
+            // array until the array is modified through its setters. Finds on one array may run in several threads
+            // at once, but not while the array is modified.
+            std::vector<size_t> findElements(const TString &key, const Value &match, IndexType kind = HASHED) const;
+
+            // Returns the indices of the elements whose member key is within [lo,hi], ordered by that member
+            std::vector<size_t> findRange(const TString &key, const Value &lo, const Value &hi) const;
+
+            // Marks the indexes of a JSON array stale after elements were modified in place through references
+            inline void invalidateIndexes() const { checkType(TARRAY); data.array->revision++; }
 
             // Convenience method (for Python, uses Writer) to return a JSON-compliant string representing this object.
             std::string toJSONString();
@@ -195,7 +462,29 @@ namespace json {
             inline void checkType(Type type_) const { if (this->type != type_) { wrongType(this->type,type_); } }
 
             // Resets the type of Value of the current type does not match the given Type
-            inline void checkTypeReset(Type type_) { if (this->type != type_) reset(TOBJECT); }
+            inline void checkTypeReset(Type type_) { if (this->type != type_) reset(type_); }
+
+#ifndef __CINT__
+            // Appends the (flattened) elements of this JSON array to result
+            template <typename T> inline void appendTo(std::vector<T> &result) const;
+
+            // Appends all packed numbers or strings to result, copying strings straight from their buffer
+            template <typename T> static inline void appendPacked(std::vector<T> &result, const TPacked &packed);
+            static inline void appendPacked(std::vector<std::string> &result, const TPacked &packed);
+            static inline void appendPacked(std::vector<bool> &result, const TPacked &packed);
+
+            // Makes this null Value an array of the elements of a range, packed if they are numbers
+            template <typename It> inline void assign(It begin, It end);
+            template <typename It> inline void assign(It begin, It end, std::true_type packed);
+            template <typename It> inline void assign(It begin, It end, std::false_type packed);
+
+            // Makes this null Value an array taking the storage of a vector
+            inline void adopt(std::vector<TInteger> &elements);
+            inline void adopt(std::vector<TUInteger> &elements);
+            inline void adopt(std::vector<TReal> &elements);
+            inline void adopt(std::vector<Value> &elements);
+            template <typename T> inline void adopt(std::vector<T> &elements) { assign(elements.begin(),elements.end()); }
+#endif
 
             // Decreases the refcount of the Value and cleans up if necessary
             inline void decref() { if (refcount && !((*refcount)--)) clean(); }
@@ -207,7 +496,7 @@ namespace json {
             void clean();
 
             // Pointer to the number of references of a structured type
-            TUInteger *refcount;
+            TRefCount *refcount;
 
             // The current type of the Value
             Type type;
@@ -216,6 +505,237 @@ namespace json {
             TData data;
     };
 
+    //A strided range of the elements of a parent array, which is kept alive by holding a reference to it
+    class TSlice {
+        public:
+            inline TSlice(const Value &parent_, size_t begin_, size_t size_, size_t stride_) : parent(parent_), begin(begin_), size(size_), stride(stride_) { }
+
+            //True while every viewed element is still in the parent, which may have been shrunk since
+            inline bool valid() const { return !size || begin + (size-1)*stride < parent.getArraySize(); }
+
+            //Throws a runtime_error if the parent was shrunk past the view
+            inline void check() const { if (!valid()) throw std::runtime_error("View of a JSON array that was shrunk past it"); }
+
+            inline Value& at(size_t index) { check(); return parent.getIndex(begin + index*stride); }
+
+            //Always a non-view array
+            Value parent;
+            size_t begin, size, stride;
+    };
+
+    //Contiguous row-major storage for a rectangular (possibly nested) JSON array of numbers of a single type, of
+    //strings, whose characters are concatenated in one buffer, or of bools, one bit each. Numbers may be null,
+    //which is marked in a mask of bits beside them.
+    class TPacked {
+        public:
+            inline TPacked(Type type_) : type(type_), booleans(0) { }
+
+            //Number of stored numbers, strings, or bools
+            inline size_t count() const {
+                switch (type) {
+                    case TINTEGER:
+                        return integers.size();
+                    case TUINTEGER:
+                        return uintegers.size();
+                    case TSTRING:
+                        return ends.size();
+                    case TBOOL:
+                        return booleans;
+                    default:
+                        return reals.size();
+                }
+            }
+
+            //Returns the number, string, bool, or null at a flat index
+            inline Value at(size_t index) const {
+                if (isNull(index)) return Value();
+                switch (type) {
+                    case TINTEGER:
+                        return Value(integers[index]);
+                    case TUINTEGER:
+                        return Value(uintegers[index]);
+                    case TSTRING:
+                        return Value(TString(chars(index),length(index)));
+                    case TBOOL:
+                        return Value(bit(bits,index));
+                    default:
+                        return Value(reals[index]);
+                }
+            }
+
+            //Borrowed NUL terminated characters of the string at a flat index
+            inline const char* chars(size_t index) const { return characters.data() + start(index); }
+            inline size_t length(size_t index) const { return ends[index] - start(index); }
+            inline size_t start(size_t index) const { return index ? ends[index-1] + 1 : 0; }
+
+            //Appends a string to packed strings
+            inline void push(const char *string, size_t size) {
+                characters.append(string,size);
+                ends.push_back(characters.size());
+                characters += '\0';
+            }
+
+            //True if the number at a flat index is null
+            inline bool isNull(size_t index) const { return !nulls.empty() && bit(nulls,index); }
+
+            //Bits of a mask, 64 to a word starting from the lowest
+            static inline bool bit(const std::vector<uint64_t> &mask, size_t index) { return (mask[index >> 6] >> (index & 63)) & 1; }
+            static inline void setBit(std::vector<uint64_t> &mask, size_t index, bool value) {
+                if (value) {
+                    mask[index >> 6] |= 1ull << (index & 63);
+                } else {
+                    mask[index >> 6] &= ~(1ull << (index & 63));
+                }
+            }
+            static inline size_t words(size_t nbits) { return (nbits + 63) >> 6; }
+
+            //Copies the numbers or strings [begin,begin+size) into a new packed array with the given shape
+            TPacked* range(size_t begin, size_t size, const std::vector<size_t> &shape_) const;
+
+            //The vector of a storage type (TInteger, TUInteger or TReal)
+            template <typename S> inline std::vector<S>& numbers();
+
+            //TINTEGER, TUINTEGER, TREAL, TSTRING, or TBOOL
+            Type type;
+
+            //Extent of each dimension, outermost first
+            std::vector<size_t> shape;
+
+            //Only the vector matching the type is used
+            std::vector<TInteger> integers;
+            std::vector<TUInteger> uintegers;
+            std::vector<TReal> reals;
+
+            //Strings are the characters up to each end, where a NUL separates them from the next string
+            std::string characters;
+            std::vector<size_t> ends;
+
+            //Bools are bits, with the bits past the last bool of the last word zero
+            std::vector<uint64_t> bits;
+            size_t booleans;
+
+            //Numbers that are null have their bit set (and a zero stored), and the mask is empty if none are
+            std::vector<uint64_t> nulls;
+    };
+
+    inline Value* TObject::member(const TString &key) {
+        if (shape) {
+            const size_t slot = shape->find(key);
+            return slot < slots.size() ? &slots[slot] : NULL;
+        }
+        const iterator it = find(key);
+        return it == end() ? NULL : &it->second;
+    }
+
+    inline const Value* TObject::member(const char *key, size_t length) const {
+        if (shape) {
+            const size_t slot = shape->find(key,length);
+            return slot < slots.size() ? &slots[slot] : NULL;
+        }
+        for (const_iterator it = begin(); it != end(); ++it) {
+            const int order = it->first.compare(0,TString::npos,key,length);
+            if (order == 0) return &it->second;
+            if (order > 0) break; //past where the key would be
+        }
+        return NULL;
+    }
+
+    template <typename F> inline void TObject::each(F f) const {
+        if (shape) {
+            for (size_t i = 0; i < slots.size(); i++) f(shape->keys[i],slots[i]);
+        } else {
+            for (const_iterator it = begin(); it != end(); ++it) f(it->first,it->second);
+        }
+    }
+
+    inline Value& Value::getMember(TString key) {
+        checkType(TOBJECT);
+        TObject &members = *data.object;
+        if (members.shape) {
+            const size_t slot = members.shape->find(key);
+            if (slot < members.slots.size()) return members.slots[slot];
+            members.expand(); //adding a member
+        }
+        return members[key];
+    }
+
+    inline size_t Value::getArraySize() const {
+        checkType(TARRAY);
+        const TArray &array = *data.array;
+        if (array.slice) {
+            array.slice->check();
+            return array.slice->size;
+        }
+        return array.packed ? array.packed->shape[0] : array.size();
+    }
+
+    inline Value& Value::getIndex(size_t index) {
+        checkType(TARRAY);
+        TArray &array = *data.array;
+        if (array.slice) return array.slice->at(index);
+        if (array.packed) array.expand();
+        return array[index];
+    }
+
+    inline void Value::setArraySize(size_t size) {
+        checkTypeReset(TARRAY);
+        TArray &array = *data.array;
+        array.revision++;
+        if (array.slice) array.detach();
+        if (array.packed) array.expand();
+        array.resize(size);
+    }
+
+    inline void Value::setIndex(size_t index, Value value) {
+        checkTypeReset(TARRAY);
+        TArray &array = *data.array;
+        array.revision++;
+        if (array.slice) {
+            array.slice->check();
+            array.slice->parent.setIndex(array.slice->begin + index*array.slice->stride,value);
+        } else {
+            getIndex(index) = value;
+        }
+    }
+
+    inline Value Value::getElement(size_t index) const {
+        checkType(TARRAY);
+        const TArray &array = *data.array;
+        if (array.slice) {
+            array.slice->check();
+            return array.slice->parent.getElement(array.slice->begin + index*array.slice->stride);
+        }
+        if (array.packed) {
+            const TPacked &packed = *array.packed;
+            if (packed.shape.size() == 1) return packed.at(index);
+            Value row(TARRAY);
+            const std::vector<size_t> shape(packed.shape.begin()+1,packed.shape.end());
+            const size_t size = packed.count() / packed.shape[0];
+            row.data.array->packed = packed.range(index*size,size,shape);
+            return row;
+        }
+        return array[index];
+    }
+
+    inline const char* Value::getChars(size_t index, size_t &length) const {
+        checkType(TARRAY);
+        const TArray &array = *data.array;
+        if (array.slice) {
+            array.slice->check();
+            return array.slice->parent.getChars(array.slice->begin + index*array.slice->stride,length);
+        }
+        if (array.packed && array.packed->type == TSTRING && array.packed->shape.size() == 1) {
+            if (index >= array.packed->count()) throw std::runtime_error("Index out of bounds of JSON array");
+            length = array.packed->length(index);
+            return array.packed->chars(index);
+        }
+        if (array.packed) wrongType(array.packed->shape.size() == 1 ? array.packed->type : TARRAY,TSTRING);
+        const Value &element = array.at(index);
+        element.checkType(TSTRING);
+        length = element.data.string->size();
+        return element.data.string->data();
+    }
+
 #ifndef __CINT__
 
     // Everything can be cast to a string in one way or another
@@ -296,8 +816,280 @@ namespace json {
         }
     }
 
+    template <typename T> inline std::vector<T> Value::toVector() const {
+        std::vector<T> result;
+        result.reserve(getArraySize()); //will check that we are an array
+        appendTo(result);
+        return result;
+    }
+
+    template <> inline std::vector<TInteger>& TPacked::numbers<TInteger>() { return integers; }
+    template <> inline std::vector<TUInteger>& TPacked::numbers<TUInteger>() { return uintegers; }
+    template <> inline std::vector<TReal>& TPacked::numbers<TReal>() { return reals; }
+
+    template <typename It> inline void Value::assign(It begin, It end) {
+        refcount = new TRefCount(0);
+        type = TARRAY;
+        data.array = new TArray;
+        assign(begin,end,std::integral_constant<bool,Packing<typename std::iterator_traits<It>::value_type>::packed>());
+    }
+
+    template <typename It> inline void Value::assign(It begin, It end, std::true_type) {
+        typedef Packing<typename std::iterator_traits<It>::value_type> Packed;
+        TPacked *packed = new TPacked(Packed::type);
+        std::vector<typename Packed::Storage> &numbers = packed->numbers<typename Packed::Storage>();
+        numbers.assign(begin,end);
+        if (numbers.empty()) {
+            delete packed; //packed arrays are never empty
+            return;
+        }
+        packed->shape.push_back(numbers.size());
+        data.array->packed = packed;
+    }
+
+    template <typename It> inline void Value::assign(It begin, It end, std::false_type) {
+        typedef typename std::iterator_traits<It>::value_type T;
+        if (std::is_base_of<std::forward_iterator_tag,typename std::iterator_traits<It>::iterator_category>::value) {
+            data.array->reserve(std::distance(begin,end));
+        }
+        for ( ; begin != end; ++begin) data.array->push_back(Value(static_cast<const T&>(*begin)));
+    }
+
+    inline void Value::adopt(std::vector<TInteger> &elements) {
+        assign(elements.end(),elements.end());
+        if (elements.empty()) return;
+        TPacked *packed = new TPacked(TINTEGER);
+        packed->shape.push_back(elements.size());
+        packed->integers.swap(elements);
+        data.array->packed = packed;
+    }
+
+    inline void Value::adopt(std::vector<TUInteger> &elements) {
+        assign(elements.end(),elements.end());
+        if (elements.empty()) return;
+        TPacked *packed = new TPacked(TUINTEGER);
+        packed->shape.push_back(elements.size());
+        packed->uintegers.swap(elements);
+        data.array->packed = packed;
+    }
+
+    inline void Value::adopt(std::vector<TReal> &elements) {
+        assign(elements.end(),elements.end());
+        if (elements.empty()) return;
+        TPacked *packed = new TPacked(TREAL);
+        packed->shape.push_back(elements.size());
+        packed->reals.swap(elements);
+        data.array->packed = packed;
+    }
+
+    inline void Value::adopt(std::vector<Value> &elements) {
+        assign(elements.end(),elements.end());
+        data.array->swap(elements);
+    }
+
+    template <typename T> inline void Value::appendTo(std::vector<T> &result) const {
+        const TArray &array = *data.array;
+        if (array.packed) {
+            appendPacked(result,*array.packed);
+        } else {
+            const size_t size = getArraySize();
+            for (size_t i = 0; i < size; i++) {
+                const Value element = getElement(i);
+                if (element.type == TARRAY) {
+                    element.appendTo(result);
+                } else {
+                    result.push_back(element.cast<T>());
+                }
+            }
+        }
+    }
+
+    template <typename T> inline void Value::appendPacked(std::vector<T> &result, const TPacked &packed) {
+        const size_t size = packed.count();
+        for (size_t i = 0; i < size; i++) {
+            result.push_back(packed.at(i).cast<T>());
+        }
+    }
+
+    inline void Value::appendPacked(std::vector<std::string> &result, const TPacked &packed) {
+        const size_t size = packed.count();
+        if (packed.type != TSTRING) {
+            for (size_t i = 0; i < size; i++) result.push_back(packed.at(i).cast<std::string>());
+            return;
+        }
+        for (size_t i = 0; i < size; i++) result.push_back(std::string(packed.chars(i),packed.length(i)));
+    }
+
+    inline void Value::appendPacked(std::vector<bool> &result, const TPacked &packed) {
+        const size_t size = packed.count();
+        if (packed.type != TBOOL) {
+            for (size_t i = 0; i < size; i++) result.push_back(packed.at(i).cast<bool>());
+            return;
+        }
+        for (size_t i = 0; i < size; i++) result.push_back(TPacked::bit(packed.bits,i));
+    }
+
+#endif
+
+    //A borrowed, read only handle on a Value, or on an element or row of a packed array, that is copied and
+    //traversed without touching reference counts. The Value it was made from must outlive the handle and must
+    //not be modified while the handle is in use. The getters are those of a const Value: missing members read as
+    //null instead of being added, and packed arrays are read in place instead of being expanded.
+    class ConstValueRef {
+        public:
+            inline ConstValueRef(const Value &value_) : value(&value_), position(0) { }
+
+            inline Type getType() const {
+                if (!position) return value->type;
+                const TPacked &packed = storage();
+                return dim() < packed.shape.size() ? TARRAY : packed.isNull(offset()) ? TNULL : packed.type;
+            }
+
+            // Getters throw a runtime_error if the type of the Value is not the requested type
+            inline TInteger getInteger() const { checkType(TINTEGER); return position ? storage().integers[offset()] : value->data.integer; }
+            inline TUInteger getUInteger() const { checkType(TUINTEGER); return position ? storage().uintegers[offset()] : value->data.uinteger; }
+            inline TReal getReal() const { checkType(TREAL); return position ? storage().reals[offset()] : value->data.real; }
+            inline TBool getBool() const { checkType(TBOOL); return position ? TPacked::bit(storage().bits,offset()) : value->data.boolean; }
+            inline TString getString() const { size_t length; const char *chars = getChars(length); return TString(chars,length); }
+
+            // Borrowed NUL terminated characters of a string
+            inline const char* getChars(size_t &length) const {
+                checkType(TSTRING);
+                if (position) {
+                    length = storage().length(offset());
+                    return storage().chars(offset());
+                }
+                length = value->data.string->size();
+                return value->data.string->data();
+            }
+
+            // Borrowed characters of the string at an index in a JSON array
+            inline const char* getChars(size_t index, size_t &length) const { return getIndex(index).getChars(length); }
+
+            // Returns a member of a JSON object, or null if there is none
+            ConstValueRef getMember(const TString &key) const;
+
+            inline bool isMember(const TString &key) const { checkType(TOBJECT); return value->data.object->member(key) != NULL; }
+            inline std::vector<std::string> getMembers() const { checkType(TOBJECT); return value->getMembers(); }
+
+            inline size_t getArraySize() const { checkType(TARRAY); return position ? storage().shape[dim()] : value->getArraySize(); }
+
+            // Returns the element at an index in a JSON array. Views are followed to their parent.
+            inline ConstValueRef getIndex(size_t index) const {
+                checkType(TARRAY);
+                const TArray &array = *value->data.array;
+                if (position || array.slice || array.packed) return getStored(index);
+                return ConstValueRef(array[index]);
+            }
+
+            // Returns a copy of the element at an index in a JSON array
+            inline Value getElement(size_t index) const { return getIndex(index).copy(); }
+
+            // Returns the extent of each dimension of a JSON array (see Value::shape)
+            inline std::vector<size_t> shape() const {
+                checkType(TARRAY);
+                return position ? std::vector<size_t>(storage().shape.begin()+dim(),storage().shape.end()) : value->shape();
+            }
+
+            inline ConstValueRef operator[](const std::string &key) const { return getMember(key); }
+            inline ConstValueRef operator[](const size_t index) const { return getIndex(index); }
+
+            // Returns a Value sharing the data referred to (rows of packed arrays are copied into new arrays)
+            Value copy() const;
+            inline operator Value() const { return copy(); }
+
+            // The null returned for missing members
+            static const Value null;
+
+#ifndef __CINT__
+            template <typename T> inline T cast() const { return position ? copy().cast<T>() : value->cast<T>(); }
+            template <typename T> inline std::vector<T> toVector() const { return position ? copy().toVector<T>() : value->toVector<T>(); }
 #endif
 
+        protected:
+            // The Value referred to, or the array holding the packed storage of the row or number referred to
+            const Value *value;
+
+            // Zero for the Value itself, or the dimension (at least one) of a row or number of the packed storage in
+            // the low 16 bits and its flat offset above them. Handles are two words, so they are passed in registers.
+            size_t position;
+
+            inline ConstValueRef(const Value &array, size_t dim_, size_t offset_) : value(&array), position(offset_ << 16 | dim_) { }
+
+            inline size_t dim() const { return position & 0xFFFF; }
+            inline size_t offset() const { return position >> 16; }
+            inline const TPacked& storage() const { return *value->data.array->packed; }
+
+            inline void checkType(Type type) const { const Type actual = getType(); if (actual != type) Value::wrongType(actual,type); }
+
+            // The element at an index of a view or of packed storage
+            ConstValueRef getStored(size_t index) const;
+    };
+
+    //A borrowed handle on a Value that may be modified through it, copied without touching reference counts. The
+    //Value must outlive the handle. Members and elements are returned as the getters of Value do, adding missing
+    //members and expanding packed arrays, so that they can be set.
+    class ValueRef : public ConstValueRef {
+        public:
+            inline ValueRef(Value &value_) : ConstValueRef(value_) { }
+
+            // The Value referred to
+            inline Value& get() const { return *const_cast<Value*>(value); }
+
+            inline ValueRef getMember(const TString &key) const { return ValueRef(get().getMember(key)); }
+            inline ValueRef getIndex(size_t index) const { return ValueRef(get().getIndex(index)); }
+            inline ValueRef operator[](const std::string &key) const { return getMember(key); }
+            inline ValueRef operator[](const size_t index) const { return getIndex(index); }
+
+            // Setters are those of Value
+            inline void setInteger(TInteger integer) const { get().setInteger(integer); }
+            inline void setUInteger(TUInteger uinteger) const { get().setUINteger(uinteger); }
+            inline void setReal(TReal real) const { get().setReal(real); }
+            inline void setBool(TBool boolean) const { get().setReal(boolean); }
+            inline void setString(const TString &string) const { get().setString(string); }
+            inline void setMember(const TString &key, const Value &value_) const { get().setMember(key,value_); }
+            inline void setMember(const char *key, size_t length, const Value &value_) const { get().setMember(key,length,value_); }
+            inline void setArraySize(size_t size) const { get().setArraySize(size); }
+            inline void setIndex(size_t index, const Value &value_) const { get().setIndex(index,value_); }
+            inline void reset(Type type) const { get().reset(type); }
+    };
+
+    inline const Value& Value::getMember(TString key) const {
+        checkType(TOBJECT);
+        const Value *member = data.object->member(key);
+        return member ? *member : ConstValueRef::null;
+    }
+
+    inline ConstValueRef Value::getIndex(size_t index) const {
+        return ConstValueRef(*this).getIndex(index);
+    }
+
+    inline ConstValueRef Value::operator[](const size_t index) const {
+        return getIndex(index);
+    }
+
+    //A compiled path of member names and array indices into a Value, written like "fields.x[3]" or "[0].name"
+    class Path {
+        public:
+            // Parses a path, throwing a runtime_error if it is malformed
+            Path(const std::string &path);
+
+            // Returns the Value at the end of the path, or null if any step does not exist
+            Value get(const Value &root) const;
+
+            // Borrows the value at the end of the path instead of copying it
+            ConstValueRef find(ConstValueRef root) const;
+
+            // One member name or array index
+            struct Step {
+                bool isIndex;
+                TString key;
+                size_t index;
+            };
+
+            std::vector<Step> steps;
+    };
+
     //represents errors in parsing JSON values
     class parser_error : public std::exception {
         public:
@@ -309,6 +1101,99 @@ namespace json {
             std::string desc, pretty;
     };
 
+    //thrown when a Reader exceeds one of its ReaderLimits
+    class limit_error : public parser_error {
+        public:
+            limit_error(const int line_, const int pos_, std::string desc);
+    };
+
+    //Bounds on the resources a Reader may spend on one top level value, so untrusted input fails before the
+    //memory or time is spent. Zero means no bound.
+    struct ReaderLimits {
+        size_t maxBytes;        //estimated heap bytes of the Values built
+        size_t maxElements;     //values read, counting each copy made by a repetition
+        size_t maxRepetitions;  //count of one non-json array value repetition [value : count]
+        size_t maxDepth;        //nesting of arrays and objects
+        size_t maxString;       //bytes in one string or key
+        double maxSeconds;      //wall clock time
+
+        ReaderLimits() : maxBytes(0), maxElements(0), maxRepetitions(0), maxDepth(0), maxString(0), maxSeconds(0) { }
+
+        //Bounds suitable for documents from untrusted sources in a shared process
+        static ReaderLimits untrusted();
+    };
+
+    //Hash of a member name used by frozen objects. Keys are hashed a word at a time with the length mixed in
+    //last, so a scanner can hash a key while it looks for the key's end (see KeyHash and scanKey).
+    uint64_t hashKey(const char *key, size_t length);
+
+    //Incremental hashKey: add the key's whole words in order, then its last partial word, then finish
+    class KeyHash {
+        public:
+            inline KeyHash() : hash(0x9E3779B97F4A7C15ull) { }
+
+            inline void add(uint64_t word) {
+                hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+                hash ^= hash >> 32;
+            }
+
+            //Adds the last 1 to 7 bytes of a key
+            inline void addPartial(const char *bytes, size_t count) {
+                uint64_t word = 0;
+                memcpy(&word,bytes,count);
+                add(word);
+            }
+
+            inline uint64_t finish(size_t length) const {
+                uint64_t result = hash ^ length;
+                result ^= result >> 29;
+                result *= 0xC4CEB9FE1A85EC53ull;
+                result ^= result >> 32;
+                return result;
+            }
+
+        protected:
+            uint64_t hash;
+    };
+
+    //Finds the closing quote of a quoted key starting at text, skipping escaped characters, and returns it (or
+    //the first NUL or end if the key is unterminated). Whole words without a quote, backslash or NUL are checked
+    //and hashed eight bytes at a time; if hash is given it has the key's words added, ready to finish.
+    inline const char* scanKey(const char *text, const char *end, KeyHash *hash) {
+        const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+        const char *word = text;
+        bool escaped = false;
+        for (;;) {
+            if (end - word >= 8) {
+                uint64_t bits;
+                memcpy(&bits,word,8);
+                const uint64_t quote = bits ^ (ones * '"'), slash = bits ^ (ones * '\\');
+                const uint64_t special = ((bits - ones) & ~bits) | ((quote - ones) & ~quote) | ((slash - ones) & ~slash);
+                if (!(special & highs)) {
+                    if (hash) hash->add(bits);
+                    word += 8;
+                    escaped = false;
+                    continue;
+                }
+            }
+            // a word with a special character, or the last bytes before end, one character at a time
+            const char *stop = end - word < 8 ? end : word + 8;
+            for (const char *c = word; c < stop; c++) {
+                if (!*c || (*c == '"' && !escaped)) {
+                    if (hash && c > word) hash->addPartial(word,c-word);
+                    return c;
+                }
+                escaped = !escaped && *c == '\\';
+            }
+            if (stop == end) {
+                if (hash && end > word) hash->addPartial(word,end-word);
+                return end;
+            }
+            if (hash) hash->addPartial(word,8);
+            word += 8;
+        }
+    }
+
     //parses JSON values from a stream
     class Reader {
         public:
@@ -323,22 +1208,88 @@ namespace json {
             //Returns the next value in the stream
             bool getValue(Value &result);
 
+            //Applies limits to each following top level value, which throw limit_error when exceeded
+            void setLimits(const ReaderLimits &limits);
+
+            //Predicts the keys of each object from the last objects read at the same depth, across top level values,
+            //so that streams of records written alike (NDJSON, RATDB) share their keys (see TObject) and each key is
+            //matched against the predicted one rather than scanned. Objects that do not match are read as before and
+            //become the prediction. Off by default.
+            void setPrediction(bool enabled);
+
         protected:
-            //Positional data in the stream data (gets garbled during parsing)
-            char *data,*cur,*lastbr;
+            //Positional data in the stream data (gets garbled during parsing), which ends after its NUL at end
+            char *data,*cur,*lastbr,*end;
             int line;
 
+            //Limits with zero replaced by the largest size, so each check is a single comparison
+            size_t maxBytes, maxElements, maxRepetitions, maxDepth, maxString;
+            std::chrono::steady_clock::duration maxTime;
+            bool timed;
+
+            //Resources used by the top level value being read
+            size_t bytes, elements, depth;
+            std::chrono::steady_clock::time_point deadline;
+
+            //Counts bytes and elements of the current value against the limits
+            inline void charge(size_t nbytes, size_t nelements) {
+                bytes += nbytes;
+                elements += nelements;
+                if (bytes > maxBytes) exceeded("Value exceeds the byte limit");
+                if (elements > maxElements) exceeded("Value exceeds the element limit");
+                if (timed && (elements & 0x3FF) == 0 && std::chrono::steady_clock::now() > deadline) exceeded("Value exceeds the time limit");
+            }
+
+            //Throws a limit_error at the current position
+            void exceeded(const char *desc);
+
             //Converts an escaped JSON string into its literal representation
             std::string unescapeString(std::string string);
 
-            //Helpers to read JSON types
+            //Finds the end of the string at cur and NUL terminates it in place, returning its start, its length, and
+            //whether it has escapes to be unescaped
+            char* scanString(size_t &length, bool &escaped);
+
+            //The shape of the last object read in each open array by depth, holding a reference
+            std::vector<TShape*> shapes;
+
+            //Keys and values of the open objects that will share a shape, innermost last
+            std::vector<std::pair<const char*,size_t> > keys;
+            std::vector<Value> values;
+
+            //When predicting, the shapes of the last few objects read at each depth, most recent first, each
+            //holding a reference
+            static const size_t PREDICTIONS = 4;
+            bool predicting;
+            std::vector<std::vector<TShape*> > predictions;
+
+            //Helpers to read JSON types. Elements of arrays that are objects share the shape of the previous
+            //object of the array if they have the same keys.
             Value readNumber();
             Value readString();
-            Value readObject();
+            Value readObject(bool shared = false);
             Value readArray();
 
+            //Makes an object of the keys and values from first on, sharing shape if the keys match it or
+            //replacing shape with a new one
+            void shapeObject(TObject &object, size_t first, TShape *&shape);
+
+            //Makes an object of the keys and values from first on, which are known to match shape
+            void fillObject(TObject &object, size_t first, TShape *shape);
+
+            //Returns whether the key at text (quoted or bare) is the one read at position in the predicted shape,
+            //setting its length. The first key chooses guess among the predictions of the depth, and a mismatch
+            //clears guess so the rest of the keys are scanned.
+            bool predictKey(TShape *&guess, size_t position, const char *text, bool quoted, size_t &length);
+
+            //Makes shape the most recent prediction of the depth, taking over one reference if it is new
+            void predict(TShape *shape);
+
             void skipComment();
 
+            //Reads the next value of any type
+            bool readValue(Value &result);
+
     };
 
     //writes JSON values to a stream
@@ -365,6 +1316,9 @@ namespace json {
             //Helper to write a value to the stream
             void writeValue(const Value &value, const std::string &depth = "");
 
+            //Helper to write packed numbers from offset as nested arrays starting at dimension dim
+            void writePacked(const TPacked &packed, size_t dim, size_t &offset);
+
     };
 
 }
@@ -0,0 +1,223 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parallel.hh"
+
+#include <algorithm>
+
+namespace json {
+
+    namespace parallel {
+
+        //True on threads running tasks of a batch
+        static thread_local bool working = false;
+
+        ThreadPool::ThreadPool(unsigned int nthreads) : task(NULL), generation(0), active(0), stopping(false) {
+            if (nthreads == 0) nthreads = std::thread::hardware_concurrency();
+            if (nthreads == 0) nthreads = 1;
+            ranges.reset(new Range[nthreads]);
+            for (unsigned int t = 1; t < nthreads; t++) threads.push_back(std::thread(&ThreadPool::work,this,t));
+        }
+
+        ThreadPool::~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+        }
+
+        ThreadPool& ThreadPool::global() {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        void ThreadPool::run(size_t count, const std::function<void(size_t)> &task_) {
+            std::unique_lock<std::mutex> exclusive(busy,std::defer_lock);
+            if (working || threads.empty() || count < 2 || !exclusive.try_lock()) {
+                for (size_t i = 0; i < count; i++) task_(i);
+                return;
+            }
+            const size_t n = size();
+            for (size_t p = 0; p < n; p++) {
+                std::lock_guard<std::mutex> guard(ranges[p].lock);
+                ranges[p].begin = p*count/n;
+                ranges[p].end = (p+1)*count/n;
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                task = &task_;
+                error = std::exception_ptr();
+                active = threads.size();
+                generation++;
+            }
+            wake.notify_all();
+            drain(0);
+            std::unique_lock<std::mutex> guard(lock);
+            while (active) done.wait(guard);
+            task = NULL;
+            if (error) std::rethrow_exception(error);
+        }
+
+        void ThreadPool::work(unsigned int self) {
+            size_t seen = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    while (!stopping && generation == seen) wake.wait(guard);
+                    if (stopping) return;
+                    seen = generation;
+                }
+                drain(self);
+                std::lock_guard<std::mutex> guard(lock);
+                if (--active == 0) done.notify_one();
+            }
+        }
+
+        void ThreadPool::drain(unsigned int self) {
+            working = true;
+            size_t index;
+            while (next(self,index)) {
+                try {
+                    (*task)(index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (!error) error = std::current_exception();
+                }
+            }
+            working = false;
+        }
+
+        bool ThreadPool::next(unsigned int self, size_t &index) {
+            Range &own = ranges[self];
+            {
+                std::lock_guard<std::mutex> guard(own.lock);
+                if (own.begin < own.end) {
+                    index = own.begin++;
+                    return true;
+                }
+            }
+            const size_t n = size();
+            for (size_t v = 1; v < n; v++) {
+                Range &victim = ranges[(self+v)%n];
+                size_t begin, end;
+                {
+                    std::lock_guard<std::mutex> guard(victim.lock);
+                    if (victim.begin >= victim.end) continue;
+                    end = victim.end;
+                    begin = victim.end = victim.begin + (victim.end - victim.begin)/2;
+                }
+                std::lock_guard<std::mutex> guard(own.lock);
+                index = begin;
+                own.begin = begin+1;
+                own.end = end;
+                return true;
+            }
+            return false;
+        }
+
+        size_t Elements::footprint(const Value &value) {
+            switch (value.type) {
+                case TSTRING:
+                    return sizeof(Value) + value.data.string->size();
+                case TARRAY:
+                    return sizeof(Value) + value.getArraySize()*sizeof(Value);
+                case TOBJECT:
+                    return sizeof(Value) + value.data.object->memberCount()*64; //roughly a map node and a short key
+                default:
+                    return sizeof(Value);
+            }
+        }
+
+        Elements::Elements(const Value &container_) : container(container_), values(NULL) {
+            size_t bytes = sizeof(Value);
+            if (container.type == TOBJECT) {
+                const TObject &object = *container.data.object;
+                pointers.reserve(object.memberCount());
+                keys.reserve(object.memberCount());
+                object.each([this](const TString &key, const Value &value) {
+                    keys.push_back(&key);
+                    pointers.push_back(&value);
+                });
+                count = object.memberCount();
+            } else {
+                container.checkType(TARRAY);
+                const TArray &array = *container.data.array;
+                count = container.getArraySize();
+                const TArray *source = array.slice ? array.slice->parent.data.array : &array;
+                if (source->packed) {
+                    const TPacked &packed = *source->packed;
+                    bytes = packed.shape[0] ? packed.count()/packed.shape[0]*sizeof(TReal) : sizeof(TReal);
+                } else if (array.slice) {
+                    pointers.resize(count);
+                    for (size_t i = 0; i < count; i++) pointers[i] = &array.slice->at(i);
+                } else {
+                    values = count ? &array[0] : NULL;
+                }
+            }
+            if (count && (values || !pointers.empty())) {
+                const size_t samples = std::min(count,(size_t)16);
+                bytes = 0;
+                Value scratch;
+                for (size_t s = 0; s < samples; s++) bytes += footprint(at(s*count/samples,scratch));
+                bytes = bytes/samples;
+            }
+            grain = std::max(CHUNK_BYTES/std::max(bytes,(size_t)1),(size_t)1);
+        }
+
+        Value Elements::build(std::vector<Value> &results) const {
+            if (container.type == TOBJECT) {
+                Value object(TOBJECT);
+                TObject &members = *object.data.object;
+                if (TShape *shape = container.data.object->shape) { //the same keys
+                    TShape::acquire(shape);
+                    members.shape = shape;
+                    members.slots.swap(results);
+                    return object;
+                }
+                for (size_t i = 0; i < count; i++) members.insert(members.end(),std::make_pair(*keys[i],results[i]));
+                return object;
+            }
+            Value array(TARRAY);
+            array.data.array->swap(results);
+            return array;
+        }
+
+        Value Elements::select(const std::vector<char> &keep) const {
+            if (container.type == TOBJECT) {
+                Value object(TOBJECT);
+                TObject &members = *object.data.object;
+                for (size_t i = 0; i < count; i++) {
+                    if (keep[i]) members.insert(members.end(),std::make_pair(*keys[i],*pointers[i]));
+                }
+                return object;
+            }
+            Value array(TARRAY);
+            TArray &kept = *array.data.array;
+            kept.reserve(std::count(keep.begin(),keep.end(),1));
+            Value scratch;
+            for (size_t i = 0; i < count; i++) {
+                if (keep[i]) kept.push_back(at(i,scratch));
+            }
+            if (!values && pointers.empty()) kept.pack(); //keep packed numbers packed
+            return array;
+        }
+
+    }
+
+}
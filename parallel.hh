@@ -0,0 +1,173 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_PARALLEL
+#define _JSON_PARALLEL
+
+#include "json.hh"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <memory>
+
+namespace json {
+
+    namespace parallel {
+
+        //A pool of worker threads running batches of indexed tasks. Each participant starts on its own contiguous
+        //range of the batch and steals half of another's remaining range when it runs out, so uneven tasks
+        //still keep every thread busy.
+        class ThreadPool {
+            public:
+                // Starts nthreads-1 workers (the thread calling run is the last participant), or one worker per
+                // hardware thread if nthreads is zero
+                explicit ThreadPool(unsigned int nthreads = 0);
+
+                ~ThreadPool();
+
+                // Number of threads running tasks, including the caller
+                inline unsigned int size() const { return threads.size()+1; }
+
+                // Calls task(i) for every i in [0,count) and returns when all have finished, rethrowing the first
+                // exception thrown by a task. Batches run one at a time, and run is sequential when called from a
+                // task or while another thread's batch is running.
+                void run(size_t count, const std::function<void(size_t)> &task);
+
+                // The pool used by default, with a thread per hardware thread
+                static ThreadPool& global();
+
+            protected:
+                //Tasks [begin,end) not yet taken by a participant
+                struct Range {
+                    std::mutex lock;
+                    size_t begin, end;
+                };
+
+                std::vector<std::thread> threads;
+                std::unique_ptr<Range[]> ranges;
+
+                std::mutex lock, busy;
+                std::condition_variable wake, done;
+                const std::function<void(size_t)> *task;
+                size_t generation, active;
+                bool stopping;
+                std::exception_ptr error;
+
+                //Loop of worker threads
+                void work(unsigned int self);
+
+                //Runs tasks from the participant's range, then from others until none remain
+                void drain(unsigned int self);
+
+                //Takes the next task of a participant, stealing if its range is empty
+                bool next(unsigned int self, size_t &index);
+
+                ThreadPool(const ThreadPool &other);
+                ThreadPool& operator=(const ThreadPool &other);
+        };
+
+        //Read-only random access to the elements of an array or the member values of an object, divided into
+        //chunks of about CHUNK_BYTES of element data. Chunks depend only on the container so results do not depend
+        //on the number of threads.
+        class Elements {
+            public:
+                // Element data per chunk
+                static const size_t CHUNK_BYTES = 1 << 16;
+
+                // Throws a runtime_error if the Value is not an array or object
+                explicit Elements(const Value &container);
+
+                inline size_t size() const { return count; }
+
+                inline size_t chunks() const { return (count + grain - 1) / grain; }
+                inline size_t begin(size_t chunk) const { return chunk*grain; }
+                inline size_t end(size_t chunk) const { return std::min(count,(chunk+1)*grain); }
+
+                // Returns element i, using scratch for packed numbers that are not stored as Values
+                inline const Value& at(size_t i, Value &scratch) const {
+                    if (values) return values[i];
+                    if (!pointers.empty()) return *pointers[i];
+                    return scratch = container.getElement(i);
+                }
+
+                // Returns an array (or object with the same keys) of the results for every element
+                Value build(std::vector<Value> &results) const;
+
+                // Returns an array (or object) of the elements that are kept, in order
+                Value select(const std::vector<char> &keep) const;
+
+            protected:
+                Value container;
+                const Value *values;
+                std::vector<const Value*> pointers;
+                std::vector<const TString*> keys;
+                size_t count, grain;
+
+                //Estimated bytes of element data, to size chunks
+                static size_t footprint(const Value &value);
+        };
+
+        // Returns an array of function(element) for each element of an array, or an object of function(value)
+        // for each member of an object. The function is called concurrently and should not copy structured
+        // Values that other elements share, because reference counts are not atomic.
+        template <typename F> Value transform(const Value &container, F function, ThreadPool &pool = ThreadPool::global()) {
+            const Elements elements(container);
+            std::vector<Value> results(elements.size());
+            pool.run(elements.chunks(),[&elements,&results,&function](size_t chunk) {
+                Value scratch;
+                for (size_t i = elements.begin(chunk); i < elements.end(chunk); i++) results[i] = function(elements.at(i,scratch));
+            });
+            return elements.build(results);
+        }
+
+        // Returns the elements (or members) of a container for which keep(element) is true, in order
+        template <typename P> Value filter(const Value &container, P keep, ThreadPool &pool = ThreadPool::global()) {
+            const Elements elements(container);
+            std::vector<char> kept(elements.size());
+            pool.run(elements.chunks(),[&elements,&kept,&keep](size_t chunk) {
+                Value scratch;
+                for (size_t i = elements.begin(chunk); i < elements.end(chunk); i++) kept[i] = keep(elements.at(i,scratch));
+            });
+            return elements.select(kept);
+        }
+
+        // Folds each chunk of elements (or member values) into identity with fold(T,element), then combines the
+        // chunk results in order with combine(T,T). The result is the same for any number of threads.
+        template <typename T, typename F, typename C> T reduce(const Value &container, const T &identity, F fold, C combine, ThreadPool &pool = ThreadPool::global()) {
+            const Elements elements(container);
+            std::deque<T> partial(elements.chunks(),identity); //not a vector, which packs bools
+            pool.run(elements.chunks(),[&elements,&partial,&fold](size_t chunk) {
+                Value scratch;
+                T result = partial[chunk];
+                for (size_t i = elements.begin(chunk); i < elements.end(chunk); i++) result = fold(result,elements.at(i,scratch));
+                partial[chunk] = result;
+            });
+            T result = identity;
+            for (size_t c = 0; c < partial.size(); c++) result = combine(result,partial[c]);
+            return result;
+        }
+
+    }
+
+}
+
+#endif
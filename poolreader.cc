@@ -0,0 +1,498 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "poolreader.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+namespace json {
+
+    //Orders the entries of a frozen table by key as TObject would
+    class EntryOrder {
+        public:
+            inline EntryOrder(const char *base_, const FrozenEntry *entries_) : base(base_), entries(entries_) { }
+
+            inline bool operator()(uint32_t a, uint32_t b) const {
+                const FrozenEntry &x = entries[a], &y = entries[b];
+                const int cmp = memcmp(base+x.key,base+y.key,std::min(x.length,y.length));
+                return cmp ? cmp < 0 : x.length < y.length;
+            }
+
+        protected:
+            const char *base;
+            const FrozenEntry *entries;
+    };
+
+    PoolReader::PoolReader(const char *text, size_t length, void *pool_, size_t capacity_, size_t maxdepth_) : maxdepth(maxdepth_), peak(0), generation(0) {
+        memset(interned,0,sizeof(interned));
+        const size_t skew = (8 - (size_t)pool_ % 8) % 8;
+        pool = (char*)pool_ + skew;
+        capacity = capacity_ > skew ? (capacity_ - skew) & ~(size_t)7 : 0;
+        reset(text,length);
+    }
+
+    void PoolReader::reset(const char *text, size_t length) {
+        cur = lastbr = text;
+        end = text + length;
+        line = 1;
+    }
+
+    const char* PoolReader::describe(PoolStatus status) {
+        switch (status) {
+            case POOL_OK:
+                return "OK";
+            case POOL_EOF:
+                return "End of text";
+            case POOL_EXHAUSTED:
+                return "Memory pool exhausted";
+            case POOL_TOO_DEEP:
+                return "Maximum nesting depth exceeded";
+            default:
+                return "Syntax error";
+        }
+    }
+
+    bool PoolReader::allocate(size_t size, uint64_t &offset) {
+        size = (size + 7) & ~(size_t)7;
+        if (size > top - bottom) return false;
+        offset = bottom;
+        memset(pool+bottom,0,size);
+        bottom += size;
+        peak = std::max(peak,bottom + capacity - top);
+        return true;
+    }
+
+    bool PoolReader::push(size_t size, size_t &offset) {
+        if (size > top - bottom) return false;
+        top -= size;
+        offset = top;
+        peak = std::max(peak,bottom + capacity - top);
+        return true;
+    }
+
+    PoolStatus PoolReader::getValue(FrozenValue &result) {
+        bottom = 0;
+        top = capacity;
+        peak = 0;
+        // keys interned for the last value were in space about to be reused
+        if (++generation == 0) {
+            memset(interned,0,sizeof(interned));
+            generation = 1;
+        }
+        uint64_t offset;
+        if (!allocate(sizeof(FrozenHeader),offset)) return POOL_EXHAUSTED;
+        FrozenSlot root;
+        const PoolStatus status = readValue(root,0);
+        if (status != POOL_OK) return status;
+        FrozenHeader *header = (FrozenHeader*)pool;
+        memcpy(header->magic,FROZEN_MAGIC,sizeof(header->magic));
+        header->size = bottom;
+        header->root = root;
+        result = FrozenValue(pool,offsetof(FrozenHeader,root));
+        return POOL_OK;
+    }
+
+    bool PoolReader::skipSpace() {
+        for (;;) {
+            switch (peek()) {
+                case '\n':
+                    line++;
+                case '\r':
+                    lastbr = cur+1;
+                case ' ':
+                case '\t':
+                    cur++;
+                    break;
+                case '/': //non-json comment
+                    if (peek(1) == '/') {
+                        while (cur < end && *cur != '\n') cur++;
+                    } else if (peek(1) == '*') {
+                        for (cur += 2; peek() && !(peek() == '*' && peek(1) == '/'); cur++) {
+                            if (*cur == '\n') {
+                                line++;
+                                lastbr = cur+1;
+                            }
+                        }
+                        if (!peek()) return false;
+                        cur += 2;
+                    } else {
+                        return false;
+                    }
+                    break;
+                default:
+                    return true;
+            }
+        }
+    }
+
+    PoolStatus PoolReader::readValue(FrozenSlot &slot, size_t depth) {
+        if (!skipSpace()) return POOL_SYNTAX;
+        slot.type = TNULL;
+        slot.packed = TNULL;
+        slot.count = 0;
+        slot.payload = 0;
+        switch (peek()) {
+            case '-':
+            case '+':
+            case '.':
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+                return readNumber(slot);
+            case '{':
+                if (depth >= maxdepth) return POOL_TOO_DEEP;
+                return readObject(slot,depth+1);
+            case '[':
+                if (depth >= maxdepth) return POOL_TOO_DEEP;
+                return readArray(slot,depth+1);
+            case '"': {
+                slot.type = TSTRING;
+                return readString(slot.payload,slot.count,true);
+            }
+            case 'n':
+                if (peek(1) == 'u' && peek(2) == 'l' && peek(3) == 'l') {
+                    cur += 4;
+                    return POOL_OK;
+                }
+                return POOL_SYNTAX;
+            case 't':
+                if (peek(1) == 'r' && peek(2) == 'u' && peek(3) == 'e') {
+                    cur += 4;
+                    slot.type = TBOOL;
+                    slot.payload = 1;
+                    return POOL_OK;
+                }
+                return POOL_SYNTAX;
+            case 'f':
+                if (peek(1) == 'a' && peek(2) == 'l' && peek(3) == 's' && peek(4) == 'e') {
+                    cur += 5;
+                    slot.type = TBOOL;
+                    return POOL_OK;
+                }
+                return POOL_SYNTAX;
+            case '\0':
+                return POOL_EOF;
+            default:
+                return POOL_SYNTAX;
+        }
+    }
+
+    //Numbers are copied to the stack to be terminated, which also keeps strtod away from its heap fallback for
+    //very long mantissas
+    PoolStatus PoolReader::readNumber(FrozenSlot &slot) {
+        char number[64];
+        size_t length = 0;
+        for (char c = peek(); isalnum(c) || c == '+' || c == '-' || c == '.'; c = peek()) {
+            if (length == sizeof(number)-1) return POOL_SYNTAX;
+            number[length++] = c;
+            cur++;
+        }
+        number[length] = '\0';
+        char *last = number + length, *stop;
+        errno = 0;
+        if (length > 2 && number[0] == '0' && number[1] == 'x') { //non-json hex
+            slot.type = TUINTEGER;
+            slot.payload = strtoul(number+2,&stop,16);
+            return stop == last && errno != ERANGE ? POOL_OK : POOL_SYNTAX;
+        }
+        if (last[-1] == 'u') { //non-json explicit unsigned
+            *--last = '\0';
+            slot.type = TUINTEGER;
+            slot.payload = strtoul(number,&stop,10);
+            return stop == last && last != number && errno != ERANGE ? POOL_OK : POOL_SYNTAX;
+        }
+        bool real = false;
+        if (last[-1] == 'd' || last[-1] == 'f') { //non-json explicit real
+            real = true;
+            *--last = '\0';
+        }
+        for (char *c = number; c != last; c++) {
+            switch (*c) {
+                case 'd': //strange exponential
+                    *c = 'e';
+                case '.':
+                case 'e':
+                case 'E':
+                    real = true;
+            }
+        }
+        if (real) {
+            const TReal value = strtod(number,&stop);
+            if (stop != last || last == number) return POOL_SYNTAX;
+            slot.type = TREAL;
+            memcpy(&slot.payload,&value,sizeof(value));
+            return POOL_OK;
+        }
+        const TInteger value = strtol(number,&stop,10);
+        if (stop != last || last == number) return POOL_SYNTAX;
+        if (value == LONG_MIN && errno == ERANGE) return POOL_SYNTAX;
+        if (value == LONG_MAX && errno == ERANGE) {
+            errno = 0;
+            slot.type = TUINTEGER;
+            slot.payload = strtoul(number,NULL,10);
+            return errno == ERANGE ? POOL_SYNTAX : POOL_OK;
+        }
+        slot.type = TINTEGER;
+        slot.payload = value;
+        return POOL_OK;
+    }
+
+    PoolStatus PoolReader::readString(uint64_t &offset, uint32_t &length, bool unescape) {
+        const char *start = ++cur;
+        for (;;) {
+            const char c = peek();
+            if (c == '\0') return POOL_SYNTAX;
+            cur++;
+            if (c == '\\') {
+                cur++; //definitely an escape, so skip next character
+            } else if (c == '"') {
+                break;
+            }
+        }
+        const char *stop = cur-1;
+        if (!allocate(stop-start+1,offset)) return POOL_EXHAUSTED;
+        char *out = pool+offset;
+        if (!unescape) {
+            memcpy(out,start,stop-start);
+            length = stop-start;
+            return POOL_OK;
+        }
+        for (const char *in = start; in != stop; in++) {
+            if (*in != '\\') {
+                *out++ = *in;
+                continue;
+            }
+            switch (*++in) {
+                case '"':
+                case '\\':
+                case '/':
+                    *out++ = *in;
+                    break;
+                case 'b':
+                    *out++ = '\b';
+                    break;
+                case 'f':
+                    *out++ = '\f';
+                    break;
+                case 'n':
+                    *out++ = '\n';
+                    break;
+                case 'r':
+                    *out++ = '\r';
+                    break;
+                case 't':
+                    *out++ = '\t';
+                    break;
+                default: //arbitrary unicode escapes are not supported, as in Reader
+                    return POOL_SYNTAX;
+            }
+        }
+        length = out-(pool+offset);
+        return POOL_OK;
+    }
+
+    PoolStatus PoolReader::readObject(FrozenSlot &slot, size_t depth) {
+        const size_t mark = top;
+        const char *key = NULL;
+        size_t keylength = 0;
+        bool keyfound = false, hashed = false;
+        KeyHash hash;
+        cur++;
+        for (;;) {
+            switch (peek()) {
+                case '/': //non-json comment
+                    if (!skipSpace()) return POOL_SYNTAX;
+                    break;
+                case '\n':
+                    line++;
+                case '\r':
+                    lastbr = cur+1;
+                case ' ':
+                case '\t':
+                    if (key && !keyfound) {
+                        keylength = cur-key;
+                        keyfound = true;
+                    }
+                    cur++;
+                    break;
+                case '}': {
+                    cur++;
+                    if (key) return POOL_SYNTAX;
+                    //members were pushed in reverse below mark; later duplicates replace earlier ones as in TObject
+                    const size_t count = (mark-top)/sizeof(FrozenEntry);
+                    uint64_t capacity = 1;
+                    while (capacity < 2*count) capacity <<= 1;
+                    uint64_t table;
+                    if (!allocate(sizeof(FrozenTable) + capacity*sizeof(FrozenEntry) + count*sizeof(uint32_t),table)) return POOL_EXHAUSTED;
+                    ((FrozenTable*)(pool+table))->capacity = capacity;
+                    ((FrozenTable*)(pool+table))->entries = table + sizeof(FrozenTable);
+                    FrozenEntry *entries = (FrozenEntry*)(pool+table+sizeof(FrozenTable));
+                    uint32_t *order = (uint32_t*)(entries+capacity);
+                    size_t members = 0;
+                    for (size_t i = 0; i < count; i++) {
+                        const FrozenEntry &member = *(const FrozenEntry*)(pool+mark-(i+1)*sizeof(FrozenEntry));
+                        uint64_t pos = member.hash & (capacity-1);
+                        while (entries[pos].key && !(entries[pos].hash == member.hash && entries[pos].length == member.length
+                                && !memcmp(pool+entries[pos].key,pool+member.key,member.length))) {
+                            pos = (pos+1) & (capacity-1);
+                        }
+                        if (!entries[pos].key) order[members++] = pos;
+                        entries[pos] = member;
+                    }
+                    std::sort(order,order+members,EntryOrder(pool,entries));
+                    top = mark;
+                    slot.type = TOBJECT;
+                    slot.count = members;
+                    slot.payload = table;
+                    return POOL_OK;
+                }
+                case ',':
+                    cur++;
+                    if (key) return POOL_SYNTAX;
+                    break;
+                case ':': {
+                    if (!key) return POOL_SYNTAX;
+                    if (!keyfound) keylength = cur-key;
+                    cur++;
+                    FrozenEntry member;
+                    member.length = keylength;
+                    member.hash = hashed ? hash.finish(keylength) : hashKey(key,keylength); //bare keys are hashed here
+                    InternedKey &known = interned[member.hash & (INTERNED-1)];
+                    if (known.generation == generation && known.hash == member.hash && known.length == keylength
+                            && !memcmp(pool+known.key,key,keylength)) {
+                        member.key = known.key;
+                    } else {
+                        if (!allocate(keylength+1,member.key)) return POOL_EXHAUSTED;
+                        memcpy(pool+member.key,key,keylength);
+                        known.hash = member.hash;
+                        known.key = member.key;
+                        known.length = keylength;
+                        known.generation = generation;
+                    }
+                    const PoolStatus status = readValue(member.value,depth);
+                    if (status != POOL_OK) return status == POOL_EOF ? POOL_SYNTAX : status;
+                    size_t offset;
+                    if (!push(sizeof(FrozenEntry),offset)) return POOL_EXHAUSTED;
+                    memcpy(pool+offset,&member,sizeof(member));
+                    key = NULL;
+                    keyfound = hashed = false;
+                    break;
+                }
+                case '"': {
+                    if (key) return POOL_SYNTAX;
+                    key = ++cur;
+                    hash = KeyHash();
+                    cur = scanKey(key,end,&hash);
+                    if (peek() != '"') return POOL_SYNTAX;
+                    keylength = cur++ - key;
+                    keyfound = hashed = true;
+                    break;
+                }
+                case '\0':
+                    return POOL_SYNTAX;
+                default:
+                    if (keyfound) return POOL_SYNTAX;
+                    if (!key) key = cur;
+                    cur++;
+            }
+        }
+    }
+
+    PoolStatus PoolReader::readArray(FrozenSlot &slot, size_t depth) {
+        const size_t mark = top;
+        FrozenSlot next;
+        size_t offset;
+        cur++;
+        for (;;) {
+            switch (peek()) {
+                case '/': //non-json comment
+                    if (!skipSpace()) return POOL_SYNTAX;
+                    break;
+                case '\n':
+                    line++;
+                case '\r':
+                    lastbr = cur+1;
+                case ' ':
+                case '\t':
+                case ',':
+                    cur++;
+                    break;
+                case ':': { //non-json value repetition
+                    cur++;
+                    FrozenSlot reps;
+                    if (mark == top || readValue(reps,depth) != POOL_OK || reps.type != TINTEGER || (TInteger)reps.payload < 0) {
+                        return POOL_SYNTAX;
+                    }
+                    // The value to be repeated has already been pushed once
+                    if (reps.payload == 0) {
+                        top += sizeof(FrozenSlot);
+                    }
+                    for (uint64_t i = 1; i < reps.payload; i++) {
+                        if (!push(sizeof(FrozenSlot),offset)) return POOL_EXHAUSTED;
+                        memcpy(pool+offset,&next,sizeof(next));
+                    }
+                    break;
+                }
+                case ']': {
+                    cur++;
+                    //elements were pushed in reverse below mark; arrays of one type of number are stored raw
+                    const size_t count = (mark-top)/sizeof(FrozenSlot);
+                    const FrozenSlot *elements = (const FrozenSlot*)(pool+top);
+                    const uint16_t type = count ? elements[0].type : TNULL;
+                    bool packed = type == TINTEGER || type == TUINTEGER || type == TREAL;
+                    for (size_t i = 1; packed && i < count; i++) packed = elements[i].type == type;
+                    uint64_t data;
+                    if (!allocate(count*(packed ? sizeof(uint64_t) : sizeof(FrozenSlot)),data)) return POOL_EXHAUSTED;
+                    for (size_t i = 0; i < count; i++) {
+                        const FrozenSlot &element = elements[count-1-i];
+                        if (packed) {
+                            ((uint64_t*)(pool+data))[i] = element.payload;
+                        } else {
+                            ((FrozenSlot*)(pool+data))[i] = element;
+                        }
+                    }
+                    top = mark;
+                    slot.type = TARRAY;
+                    slot.packed = packed ? type : TNULL;
+                    slot.count = count;
+                    slot.payload = data;
+                    return POOL_OK;
+                }
+                case '\0':
+                    return POOL_SYNTAX;
+                default: {
+                    const PoolStatus status = readValue(next,depth);
+                    if (status != POOL_OK) return status == POOL_EOF ? POOL_SYNTAX : status;
+                    if (!push(sizeof(FrozenSlot),offset)) return POOL_EXHAUSTED;
+                    memcpy(pool+offset,&next,sizeof(next));
+                }
+            }
+        }
+    }
+
+}
@@ -0,0 +1,100 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_POOLREADER
+#define _JSON_POOLREADER
+
+#include "frozen.hh"
+
+namespace json {
+
+    //Status codes of a PoolReader, which cannot throw because throwing allocates
+    enum PoolStatus {
+        POOL_OK,        //a value was read
+        POOL_EOF,       //there are no more values
+        POOL_EXHAUSTED, //the value does not fit in the pool
+        POOL_TOO_DEEP,  //the value is nested deeper than the maximum depth
+        POOL_SYNTAX     //the text is malformed
+    };
+
+    //Reads JSON/RATDB text into a fixed memory pool provided by the caller, for threads that cannot tolerate
+    //allocation jitter. Neither the reader nor the values it produces allocate memory or make system calls:
+    //values are laid out in the pool in the frozen format (see frozen.hh) and read in place through FrozenValue
+    //views, and a value that does not fit is reported as POOL_EXHAUSTED. The syntax matches Reader, except that
+    //numbers are limited to 63 characters.
+    class PoolReader {
+        public:
+            //Reads text of the given length, which is not copied and must outlive the reader. The pool must be
+            //8 byte aligned and is reused by every call to getValue.
+            PoolReader(const char *text, size_t length, void *pool, size_t capacity, size_t maxdepth = 64);
+
+            //Starts reading new text with the same pool
+            void reset(const char *text, size_t length);
+
+            //Reads the next value into the pool, which invalidates views of the previous value
+            PoolStatus getValue(FrozenValue &result);
+
+            //Position of the last error
+            inline size_t getLine() const { return line; }
+            inline size_t getColumn() const { return cur-lastbr; }
+
+            //Most pool bytes used while reading the last value
+            inline size_t getUsed() const { return peak; }
+
+            //Returns a description of a status
+            static const char* describe(PoolStatus status);
+
+        protected:
+            //Positional data in the text
+            const char *cur, *end, *lastbr;
+            size_t line;
+
+            //Records grow up from the start of the pool and elements of open containers grow down from its end
+            char *pool;
+            size_t capacity, maxdepth, bottom, top, peak;
+
+            //Keys already copied into the pool for the current value, by hash, so repeated keys share one copy
+            struct InternedKey {
+                uint64_t hash, key;
+                uint32_t length, generation;
+            };
+            static const size_t INTERNED = 64;
+            InternedKey interned[INTERNED];
+            uint32_t generation;
+
+            inline char peek(size_t ahead = 0) const { return cur+ahead < end ? cur[ahead] : '\0'; }
+
+            //Reserves zeroed space for records, returning false if the pool is exhausted
+            bool allocate(size_t size, uint64_t &offset);
+
+            //Reserves space for an element of an open container
+            bool push(size_t size, size_t &offset);
+
+            //Helpers to read JSON types into a slot
+            PoolStatus readValue(FrozenSlot &slot, size_t depth);
+            PoolStatus readNumber(FrozenSlot &slot);
+            PoolStatus readString(uint64_t &offset, uint32_t &length, bool unescape);
+            PoolStatus readObject(FrozenSlot &slot, size_t depth);
+            PoolStatus readArray(FrozenSlot &slot, size_t depth);
+
+            //Skips whitespace and comments, returning false for a malformed comment
+            bool skipSpace();
+    };
+
+}
+
+#endif
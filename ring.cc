@@ -0,0 +1,270 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ring.hh"
+
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace json {
+
+    static const char RING_MAGIC[8] = {'F','J','R','I','N','G','0','1'};
+
+    //Records start on 8 byte boundaries so frozen buffers are aligned in place
+    static inline size_t aligned(size_t size) {
+        return (size + 7) & ~(size_t)7;
+    }
+
+    //The futex word is shared between processes, so the calls are not FUTEX_PRIVATE
+    static inline void futexWake(std::atomic<uint32_t> *word) {
+        syscall(SYS_futex,word,FUTEX_WAKE,INT_MAX,NULL,NULL,0);
+    }
+
+    static inline void futexWait(std::atomic<uint32_t> *word, uint32_t value, unsigned int timeout) {
+        struct timespec ts = { (time_t)(timeout/1000), (long)(timeout%1000)*1000000 };
+        syscall(SYS_futex,word,FUTEX_WAIT,value,&ts,NULL,0);
+    }
+
+    static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "Ring positions must be plain words in shared memory");
+
+    RingWriter::RingWriter(const std::string &filename, size_t capacity) : sequence(0) {
+        capacity = aligned(capacity);
+        if (capacity < 2*sizeof(RingRecord)) throw std::runtime_error("Ring capacity is too small");
+        length = sizeof(RingHeader) + capacity;
+        // built aside and renamed over the old ring, whose readers keep mapping the old file meanwhile
+        const std::string temporary = filename + ".new";
+        const int fd = open(temporary.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644);
+        if (fd < 0) throw std::runtime_error("Could not create ring " + filename);
+        if (ftruncate(fd,length)) {
+            close(fd);
+            unlink(temporary.c_str());
+            throw std::runtime_error("Could not size ring " + filename);
+        }
+        void *mem = mmap(NULL,length,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+        close(fd);
+        if (mem == MAP_FAILED) {
+            unlink(temporary.c_str());
+            throw std::runtime_error("Could not map ring " + filename);
+        }
+        header = (RingHeader*)mem;
+        records = (char*)mem + sizeof(RingHeader);
+        header->capacity = capacity;
+        header->head.store(0,std::memory_order_relaxed);
+        header->tail.store(0,std::memory_order_relaxed);
+        header->sequence.store(0,std::memory_order_relaxed);
+        header->published.store(0,std::memory_order_relaxed);
+        header->waiters.store(0,std::memory_order_relaxed);
+        // readers attach once the magic is visible
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(header->magic,RING_MAGIC,sizeof(RING_MAGIC));
+        if (rename(temporary.c_str(),filename.c_str())) {
+            munmap(mem,length);
+            unlink(temporary.c_str());
+            throw std::runtime_error("Could not create ring " + filename);
+        }
+    }
+
+    RingWriter::~RingWriter() {
+        munmap(header,length);
+    }
+
+    void RingWriter::publish(const Value &value) {
+        const Frozen frozen(value);
+        publish(frozen.bytes(),frozen.size());
+    }
+
+    void RingWriter::publish(const char *bytes, size_t size) {
+        const uint64_t capacity = header->capacity;
+        const size_t need = sizeof(RingRecord) + aligned(size);
+        if (need > capacity/2) throw std::runtime_error("Record is too large for the ring");
+
+        // head and sequence change together, like a seqlock
+        const uint32_t published = header->published.load(std::memory_order_relaxed);
+        header->published.store(published + 1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint64_t start = header->head.load(std::memory_order_relaxed);
+        const size_t offset = start % capacity;
+        // a record that would cross the end of the ring starts over at its beginning, after padding
+        const size_t skip = offset + need > capacity ? capacity - offset : 0;
+        const uint64_t end = start + skip + need;
+
+        // records in the space about to be written are retired before any byte of it changes
+        while (!starts.empty() && starts.front() + capacity < end) starts.pop_front();
+        const uint64_t tail = starts.empty() ? start : starts.front();
+        if (tail != header->tail.load(std::memory_order_relaxed)) {
+            header->tail.store(tail,std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        if (skip) {
+            if (skip >= sizeof(RingRecord)) {
+                const RingRecord pad = { RingRecord::PADDING, 0, sequence };
+                memcpy(records + offset,&pad,sizeof(pad));
+            }
+            starts.push_back(start);
+            start += skip;
+        }
+        const RingRecord record = { (uint32_t)size, 0, sequence++ };
+        char *at = records + start % capacity;
+        memcpy(at,&record,sizeof(record));
+        memcpy(at + sizeof(record),bytes,size);
+        starts.push_back(start);
+
+        header->sequence.store(sequence,std::memory_order_relaxed);
+        header->head.store(end,std::memory_order_release);
+        header->published.store(published + 2,std::memory_order_release);
+        if (header->waiters.load(std::memory_order_seq_cst)) futexWake(&header->published);
+    }
+
+    RingReader::RingReader(const std::string &filename_, bool oldest) : filename(filename_), started(false), expected(0), lost(0) {
+        const int fd = open(filename.c_str(),O_RDWR);
+        if (fd < 0) throw std::runtime_error("Could not open ring " + filename);
+        struct stat info;
+        if (fstat(fd,&info) || (size_t)info.st_size < sizeof(RingHeader)) {
+            close(fd);
+            throw std::runtime_error("Not a ring: " + filename);
+        }
+        length = info.st_size;
+        device = info.st_dev;
+        inode = info.st_ino;
+        // mapped writable only so readers can count themselves in waiters
+        void *mem = mmap(NULL,length,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+        close(fd);
+        if (mem == MAP_FAILED) throw std::runtime_error("Could not map ring " + filename);
+        header = (RingHeader*)mem;
+        records = (const char*)mem + sizeof(RingHeader);
+        if (memcmp(header->magic,RING_MAGIC,sizeof(RING_MAGIC)) || sizeof(RingHeader) + header->capacity != length) {
+            munmap(mem,length);
+            throw std::runtime_error("Not a ring: " + filename);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (oldest) {
+            // the first record read tells where counting starts
+            position = header->tail.load(std::memory_order_acquire);
+        } else {
+            uint32_t published;
+            do {
+                published = header->published.load(std::memory_order_acquire);
+                position = header->head.load(std::memory_order_relaxed);
+                expected = header->sequence.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while ((published & 1) || published != header->published.load(std::memory_order_relaxed));
+            started = true;
+        }
+        last = position;
+    }
+
+    RingReader::~RingReader() {
+        munmap(header,length);
+    }
+
+    RingStatus RingReader::find(const char *&bytes, size_t &size) {
+        const uint64_t capacity = header->capacity;
+        for (;;) {
+            if (position == header->head.load(std::memory_order_acquire)) return RING_EMPTY;
+            const uint64_t tail = header->tail.load(std::memory_order_acquire);
+            if (position < tail) {
+                // the records before tail were overwritten; the next record read tells how many
+                position = tail;
+                return RING_OVERRUN;
+            }
+            const size_t offset = position % capacity;
+            if (capacity - offset < sizeof(RingRecord)) {
+                position += capacity - offset;
+                continue;
+            }
+            RingRecord record;
+            memcpy(&record,records + offset,sizeof(record));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (position < header->tail.load(std::memory_order_relaxed)) continue; //overwritten while copied
+            if (record.size == RingRecord::PADDING) {
+                position += capacity - offset;
+                continue;
+            }
+            if (record.size > capacity - offset - sizeof(RingRecord)) throw std::runtime_error("Corrupt record in ring");
+            // records skipped by an overrun show as a gap in the sequence
+            if (started) lost += record.sequence - expected;
+            started = true;
+            expected = record.sequence + 1;
+            last = position;
+            position += sizeof(RingRecord) + aligned(record.size);
+            bytes = records + offset + sizeof(RingRecord);
+            size = record.size;
+            return RING_OK;
+        }
+    }
+
+    RingStatus RingReader::overwritten() {
+        // the record found was overwritten while it was read, and is lost with those before tail
+        lost++;
+        const uint64_t tail = header->tail.load(std::memory_order_acquire);
+        if (position < tail) position = tail;
+        return RING_OVERRUN;
+    }
+
+    RingStatus RingReader::next(FrozenValue &view) {
+        const char *bytes;
+        size_t size;
+        const RingStatus status = find(bytes,size);
+        if (status != RING_OK) return status;
+        try {
+            view = Frozen::view(bytes,size);
+        } catch (std::runtime_error &e) {
+            // a header being overwritten fails its check
+            if (valid()) throw;
+            return overwritten();
+        }
+        return RING_OK;
+    }
+
+    RingStatus RingReader::next(std::string &copy) {
+        const char *bytes;
+        size_t size;
+        const RingStatus status = find(bytes,size);
+        if (status != RING_OK) return status;
+        copy.assign(bytes,size);
+        if (!valid()) return overwritten();
+        return RING_OK;
+    }
+
+    bool RingReader::wait(unsigned int timeout) {
+        const uint32_t published = header->published.load(std::memory_order_acquire);
+        if (position != header->head.load(std::memory_order_acquire)) return true;
+        header->waiters.fetch_add(1,std::memory_order_seq_cst);
+        if (position == header->head.load(std::memory_order_seq_cst)) futexWait(&header->published,published,timeout);
+        header->waiters.fetch_sub(1,std::memory_order_relaxed);
+        return position != header->head.load(std::memory_order_acquire);
+    }
+
+    bool RingReader::replaced() const {
+        struct stat info;
+        return stat(filename.c_str(),&info) || info.st_dev != device || info.st_ino != inode;
+    }
+
+    bool RingReader::valid() const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return last >= header->tail.load(std::memory_order_relaxed);
+    }
+
+}
@@ -0,0 +1,151 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_RING
+#define _JSON_RING
+
+#include "frozen.hh"
+
+#include <atomic>
+#include <deque>
+#include <sys/types.h>
+
+namespace json {
+
+    //Status codes of RingReader::next
+    enum RingStatus {
+        RING_OK,        //a record was read
+        RING_EMPTY,     //no record has been published since the last one read
+        RING_OVERRUN    //records were overwritten before they were read (counted by getLost), try again
+    };
+
+    //A ring of records in a shared memory file, written by one process and read by any number of others. Records
+    //are frozen buffers that readers view in place, so a Value crosses processes without formatting, parsing,
+    //or copying on the reading side. The writer never waits for readers: a reader that falls a whole ring behind
+    //loses the records that were overwritten.
+    //
+    //Positions are byte counts since the ring was created, and a record never wraps around the end of the ring.
+    //Before the writer reuses space it advances tail past the records there, so a reader can check that a record
+    //it viewed was not overwritten meanwhile (see RingReader::valid).
+    struct RingHeader {
+        char magic[8];
+        uint64_t capacity;                  //bytes of records after the header
+        std::atomic<uint64_t> head;         //end of the last complete record
+        std::atomic<uint64_t> tail;         //start of the oldest record that is not being overwritten
+        std::atomic<uint64_t> sequence;     //number of the next record
+        std::atomic<uint32_t> published;    //futex word, odd while a record is published and even between records
+        std::atomic<uint32_t> waiters;      //readers sleeping on published
+    };
+
+    struct RingRecord {
+        uint32_t size;      //bytes of the frozen buffer following the record, or PADDING
+        uint32_t reserved;
+        uint64_t sequence;  //number of the record, counting from zero
+
+        static const uint32_t PADDING = 0xFFFFFFFF; //the rest of the ring is unused, continue at its start
+    };
+
+    //Publishes records to a ring (one writer per ring)
+    class RingWriter {
+        public:
+            // Creates a ring file with capacity bytes of records, e.g. in /dev/shm. An existing ring is replaced by
+            // renaming the new file over it, so its readers are never disturbed but see no more records (see
+            // RingReader::replaced).
+            RingWriter(const std::string &filename, size_t capacity);
+
+            // Unmaps the ring, leaving the file for readers
+            ~RingWriter();
+
+            // Freezes and publishes a Value
+            void publish(const Value &value);
+
+            // Publishes a frozen buffer, throwing a runtime_error if it is larger than half the ring
+            void publish(const char *bytes, size_t size);
+
+            inline uint64_t getSequence() const { return sequence; }
+
+        protected:
+            RingHeader *header;
+            char *records;
+            size_t length;
+            uint64_t sequence;
+
+            //Starts of the records in the ring, oldest first
+            std::deque<uint64_t> starts;
+
+            RingWriter(const RingWriter &other);
+            RingWriter& operator=(const RingWriter &other);
+    };
+
+    //Reads every record published to a ring after it attaches
+    class RingReader {
+        public:
+            // Maps an existing ring. The reader starts at the next record, or at the oldest one still in the ring.
+            RingReader(const std::string &filename, bool oldest = false);
+
+            ~RingReader();
+
+            // Views the next record in place. The writer may overwrite the record while it is read, and the offsets
+            // of an overwritten record are not checked, so a view may then read garbage or outside the ring: only
+            // readers that keep well ahead of the writer should view in place, must check valid() after every read,
+            // and must not read from the view again once valid() has returned false.
+            RingStatus next(FrozenValue &view);
+
+            // Copies the next record, e.g. for Frozen(copy.data(),copy.size()). The copy is checked after it is
+            // taken, so unlike a view it is complete and can be read at any pace, even by a reader that falls behind.
+            RingStatus next(std::string &copy);
+
+            // Sleeps until a record is published or timeout milliseconds pass, returning false on timeout
+            bool wait(unsigned int timeout);
+
+            // Returns true if the last record viewed has not been overwritten. Check after reading from a view,
+            // and discard what was read if false.
+            bool valid() const;
+
+            // Returns true if the ring file was replaced (e.g. by a restarted writer) or removed since the reader
+            // attached. The reader then receives no more records and should be created again.
+            bool replaced() const;
+
+            // Number of records lost to overruns, and of the last record viewed
+            inline uint64_t getLost() const { return lost; }
+            inline uint64_t getSequence() const { return expected - 1; }
+
+        protected:
+            std::string filename;
+            dev_t device;
+            ino_t inode;
+
+            // Finds the next record, without reading past its RingRecord
+            RingStatus find(const char *&bytes, size_t &size);
+
+            // Counts the record found as lost when it was overwritten while it was read
+            RingStatus overwritten();
+
+            RingHeader *header;
+            const char *records;
+            size_t length;
+            uint64_t position, last;
+            bool started;
+            uint64_t expected, lost;
+
+            RingReader(const RingReader &other);
+            RingReader& operator=(const RingReader &other);
+    };
+
+}
+
+#endif
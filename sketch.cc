@@ -0,0 +1,522 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sketch.hh"
+#include "tokenizer.hh"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cerrno>
+#include <cstdlib>
+
+namespace json {
+
+    //Spreads the bits of a hash over the whole word (the splitmix64 finalizer)
+    static inline uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    DistinctSketch::DistinctSketch(unsigned int precision_) : precision(std::min(18u,std::max(4u,precision_))), registers(1 << precision) {
+    }
+
+    void DistinctSketch::add(uint64_t hash) {
+        const size_t index = hash >> (64 - precision);
+        const uint64_t rest = (hash << precision) | (1ull << (precision - 1)); //bounds the rank
+        const uint8_t rank = __builtin_clzll(rest) + 1;
+        if (registers[index] < rank) registers[index] = rank;
+    }
+
+    void DistinctSketch::merge(const DistinctSketch &other) {
+        if (other.precision != precision) throw std::runtime_error("Cannot merge distinct sketches of different precisions");
+        for (size_t i = 0; i < registers.size(); i++) registers[i] = std::max(registers[i],other.registers[i]);
+    }
+
+    double DistinctSketch::estimate() const {
+        const double m = registers.size();
+        double sum = 0;
+        size_t zeros = 0;
+        for (size_t i = 0; i < registers.size(); i++) {
+            sum += std::ldexp(1.0,-(int)registers[i]);
+            if (!registers[i]) zeros++;
+        }
+        const double estimate = 0.7213 / (1 + 1.079/m) * m * m / sum;
+        if (estimate <= 2.5*m && zeros) return m * std::log(m/zeros); //linear counting for small sets
+        return estimate;
+    }
+
+    QuantileSketch::QuantileSketch(size_t k_) : k(std::max<size_t>(k_,8)), bottom(k), count(0), random(0x9E3779B97F4A7C15ull),
+        minimum(std::numeric_limits<double>::infinity()), maximum(-std::numeric_limits<double>::infinity()), levels(1) {
+    }
+
+    size_t QuantileSketch::capacity(size_t level) const {
+        const double depth = levels.size() - 1 - level;
+        return std::max<size_t>(2,(size_t)std::ceil(k * std::pow(2.0/3.0,depth)));
+    }
+
+    void QuantileSketch::add(double number) {
+        if (std::isnan(number)) return;
+        levels[0].push_back(number);
+        count++;
+        minimum = std::min(minimum,number);
+        maximum = std::max(maximum,number);
+        if (levels[0].size() >= bottom) compress();
+    }
+
+    void QuantileSketch::add(double number, uint64_t times) {
+        if (std::isnan(number) || !times) return;
+        // an item at level h stands for 2^h numbers, so the binary digits of times say where copies go
+        for (size_t h = 0; times >> h; h++) {
+            if (!((times >> h) & 1)) continue;
+            if (h >= levels.size()) levels.resize(h+1);
+            levels[h].push_back(number);
+        }
+        count += times;
+        minimum = std::min(minimum,number);
+        maximum = std::max(maximum,number);
+        compress();
+    }
+
+    void QuantileSketch::compress() {
+        for (size_t h = 0; h < levels.size(); h++) {
+            if (levels[h].size() < capacity(h)) continue;
+            if (h+1 == levels.size()) levels.push_back(std::vector<double>());
+            std::vector<double> &level = levels[h], &above = levels[h+1];
+            std::sort(level.begin(),level.end());
+            // an odd item out stays, and a coin picks which half of the pairs moves up
+            const bool odd = level.size() % 2;
+            const double left = level.back();
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            const size_t size = level.size() - odd;
+            for (size_t i = random & 1; i < size; i += 2) above.push_back(level[i]);
+            level.clear();
+            if (odd) level.push_back(left);
+        }
+        bottom = capacity(0);
+    }
+
+    void QuantileSketch::merge(const QuantileSketch &other) {
+        while (levels.size() < other.levels.size()) levels.push_back(std::vector<double>());
+        for (size_t h = 0; h < other.levels.size(); h++) levels[h].insert(levels[h].end(),other.levels[h].begin(),other.levels[h].end());
+        count += other.count;
+        minimum = std::min(minimum,other.minimum);
+        maximum = std::max(maximum,other.maximum);
+        compress();
+    }
+
+    double QuantileSketch::quantile(double fraction) const {
+        if (!count) return std::numeric_limits<double>::quiet_NaN();
+        if (fraction <= 0) return minimum;
+        if (fraction >= 1) return maximum;
+        std::vector<std::pair<double,uint64_t> > weighted;
+        uint64_t total = 0;
+        for (size_t h = 0; h < levels.size(); h++) {
+            for (size_t i = 0; i < levels[h].size(); i++) weighted.push_back(std::make_pair(levels[h][i],1ull << h));
+            total += levels[h].size() << h;
+        }
+        std::sort(weighted.begin(),weighted.end());
+        const double target = fraction * total;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < weighted.size(); i++) {
+            seen += weighted[i].second;
+            if (seen >= target) return weighted[i].first;
+        }
+        return maximum;
+    }
+
+    FrequencySketch::FrequencySketch(size_t capacity_) : capacity(std::max<size_t>(capacity_,1)), total(0) {
+        size_t slots = 4;
+        while (slots < 2*capacity) slots *= 2;
+        table.resize(slots);
+    }
+
+    void FrequencySketch::add(const std::string &item, uint64_t count) {
+        add(item,hashKey(item.data(),item.size()),count);
+    }
+
+    void FrequencySketch::add(const std::string &item, uint64_t hash, uint64_t count) {
+        total += count;
+        size_t slot = find(item,hash);
+        if (table[slot]) {
+            Counter &counter = counters[table[slot]-1];
+            counter.count += count;
+            sink(counter.position);
+            return;
+        }
+        if (counters.size() < capacity) {
+            const Counter counter = { item, hash, count, heap.size() };
+            counters.push_back(counter);
+            table[slot] = counters.size();
+            heap.push_back(counters.size()-1);
+            rise(heap.size()-1);
+            return;
+        }
+        // the item takes the place of the smallest counter, inheriting its count as possible earlier occurrences
+        const size_t smallest = heap[0];
+        Counter &counter = counters[smallest];
+        remove(find(counter.item,counter.hash));
+        counter.item.assign(item);
+        counter.hash = hash;
+        counter.count += count;
+        table[find(item,hash)] = smallest+1;
+        sink(0);
+    }
+
+    size_t FrequencySketch::find(const std::string &item, uint64_t hash) const {
+        const size_t mask = table.size()-1;
+        size_t slot = hash & mask;
+        while (table[slot]) {
+            const Counter &counter = counters[table[slot]-1];
+            if (counter.hash == hash && counter.item == item) break;
+            slot = (slot+1) & mask;
+        }
+        return slot;
+    }
+
+    void FrequencySketch::remove(size_t slot) {
+        const size_t mask = table.size()-1;
+        for (size_t next = (slot+1) & mask; table[next]; next = (next+1) & mask) {
+            // an item moves back unless its home slot lies after the hole, cyclically
+            const size_t home = counters[table[next]-1].hash & mask;
+            if (((next - home) & mask) >= ((next - slot) & mask)) {
+                table[slot] = table[next];
+                slot = next;
+            }
+        }
+        table[slot] = 0;
+    }
+
+    void FrequencySketch::sink(size_t i) {
+        for (;;) {
+            const size_t left = 2*i+1, right = left+1;
+            size_t smallest = i;
+            if (left < heap.size() && counters[heap[left]].count < counters[heap[smallest]].count) smallest = left;
+            if (right < heap.size() && counters[heap[right]].count < counters[heap[smallest]].count) smallest = right;
+            if (smallest == i) return;
+            exchange(i,smallest);
+            i = smallest;
+        }
+    }
+
+    void FrequencySketch::rise(size_t i) {
+        while (i && counters[heap[i]].count < counters[heap[(i-1)/2]].count) {
+            exchange(i,(i-1)/2);
+            i = (i-1)/2;
+        }
+    }
+
+    void FrequencySketch::exchange(size_t i, size_t j) {
+        std::swap(heap[i],heap[j]);
+        counters[heap[i]].position = i;
+        counters[heap[j]].position = j;
+    }
+
+    void FrequencySketch::merge(const FrequencySketch &other) {
+        for (size_t i = 0; i < other.counters.size(); i++) add(other.counters[i].item,other.counters[i].hash,other.counters[i].count);
+    }
+
+    std::vector<std::pair<std::string,uint64_t> > FrequencySketch::top(size_t n) const {
+        std::vector<std::pair<std::string,uint64_t> > items;
+        for (size_t i = 0; i < counters.size(); i++) items.push_back(std::make_pair(counters[i].item,counters[i].count));
+        std::sort(items.begin(),items.end(),[](const std::pair<std::string,uint64_t> &a, const std::pair<std::string,uint64_t> &b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        if (items.size() > n) items.resize(n);
+        return items;
+    }
+
+    FieldSketch::FieldSketch(const std::string &path_, const SketchOptions &options) : path(path_), records(0), values(0),
+        distinct(options.precision), quantiles(options.k), frequent(options.capacity) {
+    }
+
+    void FieldSketch::merge(const FieldSketch &other) {
+        records += other.records;
+        values += other.values;
+        distinct.merge(other.distinct);
+        quantiles.merge(other.quantiles);
+        frequent.merge(other.frequent);
+    }
+
+    FieldStatistics::Step::~Step() {
+        for (std::unordered_map<std::string,Step*>::iterator it = members.begin(); it != members.end(); ++it) delete it->second;
+        for (std::unordered_map<size_t,Step*>::iterator it = elements.begin(); it != elements.end(); ++it) delete it->second;
+    }
+
+    FieldStatistics::FieldStatistics(const std::vector<std::string> &paths, const SketchOptions &options_) : options(options_), root(new Step), records(0) {
+        try {
+            for (size_t i = 0; i < paths.size(); i++) {
+                fields.push_back(FieldSketch(paths[i],options));
+                insert(paths[i],i);
+            }
+        } catch (...) {
+            delete root;
+            throw;
+        }
+        lastRecord.resize(fields.size());
+    }
+
+    FieldStatistics::FieldStatistics(const FieldStatistics &other) : options(other.options), fields(other.fields), root(new Step),
+        records(other.records), lastRecord(other.lastRecord) {
+        for (size_t i = 0; i < fields.size(); i++) insert(fields[i].path,i);
+    }
+
+    FieldStatistics::~FieldStatistics() {
+        delete root;
+    }
+
+    void FieldStatistics::insert(const std::string &path, size_t field) {
+        const Path parsed(path);
+        Step *step = root;
+        for (size_t i = 0; i < parsed.steps.size(); i++) {
+            Step *&next = parsed.steps[i].isIndex ? step->elements[parsed.steps[i].index] : step->members[parsed.steps[i].key];
+            if (!next) next = new Step;
+            step = next;
+        }
+        step->fields.push_back(field);
+    }
+
+    void FieldStatistics::merge(const FieldStatistics &other) {
+        if (other.fields.size() != fields.size()) throw std::runtime_error("Cannot merge statistics of different fields");
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (other.fields[i].path != fields[i].path) throw std::runtime_error("Cannot merge statistics of different fields");
+        }
+        for (size_t i = 0; i < fields.size(); i++) fields[i].merge(other.fields[i]);
+        records += other.records;
+    }
+
+    //Converts the text of a number token with the rules of Reader::readNumber, returning false if it is malformed
+    static bool tokenNumber(const char *text, size_t length, double &number) {
+        char buffer[64];
+        if (!length || length >= sizeof(buffer)) return false;
+        memcpy(buffer,text,length);
+        buffer[length] = '\0';
+        char *end;
+        errno = 0;
+        const char last = buffer[length-1];
+        if (length > 2 && buffer[0] == '0' && (buffer[1] == 'x' || buffer[1] == 'X')) {
+            number = strtoul(buffer+2,&end,16);
+        } else if (last == 'u') {
+            buffer[length-1] = '\0';
+            number = strtoul(buffer,&end,10);
+        } else if (strpbrk(buffer,".eEdf")) {
+            if (last == 'd' || last == 'f') buffer[length-1] = '\0';
+            char *d = strchr(buffer,'d');
+            if (d) *d = 'e'; //the strange exponential
+            number = strtod(buffer,&end);
+        } else {
+            number = strtol(buffer,&end,10);
+            if (errno == ERANGE) {
+                errno = 0;
+                number = strtoul(buffer,&end,10);
+            }
+        }
+        return !*end && errno != ERANGE;
+    }
+
+    //Items are JSON text, except numbers, which are the bytes of a double after a byte no JSON text starts with
+    static const char NUMBER_ITEM = '\x01';
+
+    void FieldStatistics::add(std::istream &in) {
+        Tokenizer tokens(in);
+        frames.clear();
+        pending = false;
+        for (;;) {
+            const Token &token = tokens.next();
+            if (pending && token.type != TOKEN_REPEAT) flush(1);
+            switch (token.type) {
+                case TOKEN_END:
+                    return;
+                case TOKEN_KEY: {
+                        Frame &frame = frames.back();
+                        frame.member = NULL;
+                        if (frame.step) {
+                            std::unordered_map<std::string,Step*>::const_iterator it = frame.step->members.find(std::string(token.text,token.length));
+                            if (it != frame.step->members.end()) frame.member = it->second;
+                        }
+                    }
+                    break;
+                case TOKEN_END_OBJECT:
+                case TOKEN_END_ARRAY:
+                    frames.pop_back();
+                    if (frames.empty()) records++;
+                    break;
+                case TOKEN_REPEAT: {
+                        // [value : count] holds count copies of the value before it, which may be none
+                        const uint64_t times = strtoul(std::string(token.text,token.length).c_str(),NULL,10);
+                        frames.back().index += times-1;
+                        if (pending) flush(times);
+                    }
+                    break;
+                default:
+                    value(token);
+            }
+        }
+    }
+
+    void FieldStatistics::value(const Token &token) {
+        const Step *target = NULL;
+        const std::vector<size_t> *inherited = NULL;
+        if (frames.empty()) {
+            target = root;
+        } else if (frames.back().object) {
+            target = frames.back().member;
+            frames.back().member = NULL;
+        } else {
+            Frame &frame = frames.back();
+            if (frame.step) {
+                std::unordered_map<size_t,Step*>::const_iterator it = frame.step->elements.find(frame.index);
+                if (it != frame.step->elements.end()) target = it->second;
+            }
+            frame.index++;
+            if (!frame.collecting.empty()) inherited = &frame.collecting;
+        }
+        switch (token.type) {
+            case TOKEN_BEGIN_OBJECT: {
+                    Frame frame;
+                    frame.object = true;
+                    frame.step = target && !target->members.empty() ? target : NULL;
+                    frame.member = NULL;
+                    frame.index = 0;
+                    frames.push_back(frame);
+                }
+                break;
+            case TOKEN_BEGIN_ARRAY: {
+                    Frame frame;
+                    frame.object = false;
+                    frame.step = target && !target->elements.empty() ? target : NULL;
+                    frame.member = NULL;
+                    frame.index = 0;
+                    if (inherited) frame.collecting = *inherited;
+                    if (target) frame.collecting.insert(frame.collecting.end(),target->fields.begin(),target->fields.end());
+                    frames.push_back(frame);
+                }
+                break;
+            default:
+                lastFields.clear();
+                if (target) lastFields = target->fields;
+                if (inherited) lastFields.insert(lastFields.end(),inherited->begin(),inherited->end());
+                if (!lastFields.empty()) {
+                    lastIsNumber = false;
+                    switch (token.type) {
+                        case TOKEN_STRING:
+                            lastText.assign(1,'"');
+                            lastText.append(token.text,token.length);
+                            lastText += '"';
+                            break;
+                        case TOKEN_NUMBER:
+                            lastIsNumber = tokenNumber(token.text,token.length,lastNumber);
+                            if (lastIsNumber) {
+                                if (lastNumber == 0) lastNumber = 0; //-0 is 0
+                                lastText.assign(1,NUMBER_ITEM);
+                                lastText.append((const char*)&lastNumber,sizeof(lastNumber));
+                            } else {
+                                lastText.assign(token.text,token.length);
+                            }
+                            break;
+                        case TOKEN_TRUE:
+                            lastText = "true";
+                            break;
+                        case TOKEN_FALSE:
+                            lastText = "false";
+                            break;
+                        default:
+                            lastText = "null";
+                    }
+                    // elements of arrays wait for a repetition count that may follow them
+                    if (!frames.empty() && !frames.back().object) {
+                        pending = true;
+                    } else {
+                        flush(1);
+                    }
+                }
+                if (frames.empty()) records++;
+        }
+    }
+
+    void FieldStatistics::flush(uint64_t times) {
+        pending = false;
+        if (!times) return;
+        for (size_t i = 0; i < lastFields.size(); i++) addTo(lastFields[i],lastText,lastIsNumber,lastNumber,times);
+    }
+
+    void FieldStatistics::addTo(size_t field, const std::string &text, bool isNumber, double number, uint64_t times) {
+        FieldSketch &sketch = fields[field];
+        if (lastRecord[field] != records+1) {
+            lastRecord[field] = records+1;
+            sketch.records++;
+        }
+        sketch.values += times;
+        const uint64_t hash = hashKey(text.data(),text.size());
+        sketch.distinct.add(mix(hash));
+        if (isNumber) {
+            sketch.quantiles.add(number,times);
+        }
+        sketch.frequent.add(text,hash,times);
+    }
+
+    Value FieldStatistics::summary() const {
+        static const double fractions[] = { 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99 };
+        static const char *names[] = { "p01", "p05", "p25", "p50", "p75", "p95", "p99" };
+        Value result(TOBJECT);
+        for (size_t i = 0; i < fields.size(); i++) {
+            const FieldSketch &field = fields[i];
+            Value stats(TOBJECT);
+            stats.setMember("records",Value((TUInteger)field.records));
+            stats.setMember("values",Value((TUInteger)field.values));
+            stats.setMember("distinct",Value((TUInteger)std::llround(field.distinct.estimate())));
+            if (field.quantiles.getCount()) {
+                stats.setMember("min",Value(field.quantiles.getMin()));
+                stats.setMember("max",Value(field.quantiles.getMax()));
+                Value quantiles(TOBJECT);
+                for (size_t q = 0; q < sizeof(fractions)/sizeof(fractions[0]); q++) quantiles.setMember(names[q],Value(field.quantiles.quantile(fractions[q])));
+                stats.setMember("quantiles",quantiles);
+            }
+            const std::vector<std::pair<std::string,uint64_t> > top = field.frequent.top(options.top);
+            Value items(TARRAY);
+            items.setArraySize(top.size());
+            for (size_t t = 0; t < top.size(); t++) {
+                const std::string &text = top[t].first;
+                Value item(TOBJECT), value;
+                if (text.size() == 1+sizeof(double) && text[0] == NUMBER_ITEM) {
+                    double number;
+                    memcpy(&number,text.data()+1,sizeof(number));
+                    value = Value(number);
+                } else {
+                    try {
+                        Reader reader(text);
+                        reader.getValue(value);
+                    } catch (parser_error &e) {
+                        value = Value(text); //a malformed number as written
+                    }
+                }
+                item.setMember("value",value);
+                item.setMember("count",Value((TUInteger)top[t].second));
+                items.setIndex(t,item);
+            }
+            stats.setMember("top",items);
+            result.setMember(field.path,stats);
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,228 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_SKETCH
+#define _JSON_SKETCH
+
+#include "json.hh"
+
+#include <istream>
+#include <unordered_map>
+
+namespace json {
+
+    struct Token;
+
+    //Estimates the number of distinct values added (HyperLogLog with 2^precision one byte registers, about
+    //1.04/sqrt(2^precision) relative error)
+    class DistinctSketch {
+        public:
+            explicit DistinctSketch(unsigned int precision = 12);
+
+            // Adds a well mixed 64 bit hash of a value
+            void add(uint64_t hash);
+
+            // Combines the values added to another sketch of the same precision (throws a runtime_error otherwise)
+            void merge(const DistinctSketch &other);
+
+            double estimate() const;
+
+        protected:
+            unsigned int precision;
+            std::vector<uint8_t> registers;
+    };
+
+    //Estimates quantiles of the numbers added with a KLL sketch: levels of sorted compactors where an item at
+    //level h stands for 2^h numbers. Memory is about 3k numbers, and the rank error is about 1.7/k.
+    class QuantileSketch {
+        public:
+            explicit QuantileSketch(size_t k = 200);
+
+            void add(double number);
+
+            // Adds a number as if it were added times times, in time logarithmic in times
+            void add(double number, uint64_t times);
+
+            // Combines the numbers added to another sketch
+            void merge(const QuantileSketch &other);
+
+            // The number at a fraction of the way through the sorted numbers, or NaN if none were added
+            double quantile(double fraction) const;
+
+            inline uint64_t getCount() const { return count; }
+            inline double getMin() const { return minimum; }
+            inline double getMax() const { return maximum; }
+
+        protected:
+            size_t k, bottom;           //bottom is the capacity of level 0
+            uint64_t count, random;
+            double minimum, maximum;
+            std::vector<std::vector<double> > levels;
+
+            //Items a level holds before it is compacted, smaller further from the top level
+            size_t capacity(size_t level) const;
+
+            //Compacts the first level over capacity, promoting every other sorted item
+            void compress();
+    };
+
+    //Finds the most frequent items with SpaceSaving counters. Counts are upper bounds, over by at most the total
+    //divided by the capacity, and every item more frequent than that is kept.
+    class FrequencySketch {
+        public:
+            explicit FrequencySketch(size_t capacity = 64);
+
+            void add(const std::string &item, uint64_t count = 1);
+
+            // Adds an item with its hashKey, when the caller has it already
+            void add(const std::string &item, uint64_t hash, uint64_t count);
+
+            // Adds the counters of another sketch
+            void merge(const FrequencySketch &other);
+
+            // The n items with the highest counts, highest first
+            std::vector<std::pair<std::string,uint64_t> > top(size_t n) const;
+
+            inline uint64_t getTotal() const { return total; }
+
+        protected:
+            struct Counter {
+                std::string item;
+                uint64_t hash, count;
+                size_t position;                //in heap
+            };
+
+            size_t capacity;
+            uint64_t total;
+            std::vector<Counter> counters;      //reused in place when an item is replaced
+            std::vector<size_t> heap;           //of counters, smallest count first
+            std::vector<size_t> table;          //of counters + 1 by hash, linear probing, 0 is empty
+
+            //The slot of the table holding an item, or the empty slot where it belongs
+            size_t find(const std::string &item, uint64_t hash) const;
+
+            //Empties a slot, moving later items of its probe sequence back
+            void remove(size_t slot);
+
+            //Restore the heap after the count at i grew or was added
+            void sink(size_t i);
+            void rise(size_t i);
+            void exchange(size_t i, size_t j);
+    };
+
+    struct SketchOptions {
+        unsigned int precision;     //of DistinctSketch
+        size_t k;                   //of QuantileSketch
+        size_t capacity;            //of FrequencySketch
+        size_t top;                 //items reported by summary
+
+        SketchOptions() : precision(12), k(200), capacity(64), top(10) { }
+    };
+
+    //Sketches of the values found at one path
+    struct FieldSketch {
+        std::string path;
+        uint64_t records;           //records with at least one value at the path
+        uint64_t values;            //values seen, counting each element of arrays at the path
+        DistinctSketch distinct;    //of all values (1 and 1.0 are the same, strings are compared as written)
+        QuantileSketch quantiles;   //of the numbers
+        FrequencySketch frequent;   //of all values, as JSON text
+
+        FieldSketch(const std::string &path_, const SketchOptions &options);
+
+        void merge(const FieldSketch &other);
+    };
+
+    //Streaming statistics of fields of records (top level values, e.g. NDJSON or RATDB files), driven by a
+    //Tokenizer so records are never built as Values. Each field is a Path from the record; an array at a field
+    //contributes each of its elements (including elements of nested arrays), and objects there are skipped.
+    //Statistics of parts of a stream read on several threads are combined with merge.
+    class FieldStatistics {
+        public:
+            // Throws a runtime_error if a path is malformed
+            FieldStatistics(const std::vector<std::string> &paths, const SketchOptions &options = SketchOptions());
+
+            FieldStatistics(const FieldStatistics &other);
+            ~FieldStatistics();
+
+            // Updates the sketches with every record of a stream, throwing a parser_error for malformed input
+            void add(std::istream &in);
+
+            // Adds the records of statistics of the same paths
+            void merge(const FieldStatistics &other);
+
+            inline uint64_t getRecords() const { return records; }
+            inline size_t getFieldCount() const { return fields.size(); }
+            inline const FieldSketch& getField(size_t i) const { return fields[i]; }
+
+            // An object of the fields by path: { records, values, distinct, min, max, quantiles: { p01, p05, p25,
+            // p50, p75, p95, p99 }, top: [ { value, count } ... ] }
+            Value summary() const;
+
+        protected:
+            //A trie of the configured paths, followed as members and elements are entered
+            struct Step {
+                std::vector<size_t> fields;                 //fields ending here
+                std::unordered_map<std::string,Step*> members;
+                std::unordered_map<size_t,Step*> elements;
+
+                ~Step();
+            };
+
+            //An open container
+            struct Frame {
+                bool object;
+                const Step *step;                   //trie node of the container, if any path continues in it
+                const Step *member;                 //trie node of the member after the last key of an object
+                size_t index;                       //next element of an array
+                std::vector<size_t> collecting;     //fields whose arrays contain this array
+            };
+
+            SketchOptions options;
+            std::vector<FieldSketch> fields;
+            Step *root;
+            uint64_t records;
+
+            //Per record state of add
+            std::vector<Frame> frames;
+            std::vector<uint64_t> lastRecord;       //record number + 1 of the last record each field was seen in
+
+            //The last scalar and the fields it goes to. Elements of arrays are pending until the next token, which
+            //may repeat them.
+            std::string lastText;
+            double lastNumber;
+            bool lastIsNumber, pending;
+            std::vector<size_t> lastFields;
+
+            void insert(const std::string &path, size_t field);
+
+            //Handles a token that starts or is a value
+            void value(const Token &token);
+
+            //Adds a scalar to fields
+            void scalar(const Token &token, const std::vector<size_t> &targets);
+            void addTo(size_t field, const std::string &text, bool isNumber, double number, uint64_t times);
+
+            //Adds the last scalar to its fields times times
+            void flush(uint64_t times);
+
+            FieldStatistics& operator=(const FieldStatistics &other);
+    };
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+
+#include "json.hh"
+#include "frozen.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks that arrays of bools stored as bits, and arrays of numbers with nulls, behave like arrays of Values,
+// then times counting a large mask packed against counting it as Values
+//     bitsets [bools]
+
+typedef chrono::steady_clock Clock;
+
+json::Value parse(const string &text) {
+	json::Reader reader(text);
+	json::Value value;
+	reader.getValue(value);
+	return value;
+}
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+template <typename F> bool throws(F f) {
+	try {
+		f();
+	} catch (runtime_error &e) {
+		return true;
+	}
+	return false;
+}
+
+double since(Clock::time_point start) {
+	return chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+}
+
+int main(int argc, char **argv) {
+
+	const size_t nbools = argc > 1 ? atoi(argv[1]) : 10000000;
+	bool ok = true;
+
+	json::Value flags = parse("[true, false, true, true]");
+	ok = check("bools are read as they were", flags.getArraySize() == 4 && flags.toVector<bool>() == vector<bool>({ true, false, true, true })
+		&& !flags.getElement(1).getBool() && flags.getElement(3).getBool() && written(flags) == "[true, false, true, true]\n") && ok;
+	ok = check("counts", flags.countTrue() == 3 && flags.any() && !flags.all() && parse("[false, false]").countTrue() == 0
+		&& !parse("[false, false]").any() && parse("[true : 130]").all() && !parse("[true : 129, false]").all()
+		&& parse("[true : 129, false]").countTrue() == 129) && ok;
+	ok = check("counts of slices and unpacked bools", flags.slice(0,4,2).countTrue() == 2 && parse("[[true], [false, true]]")[1].countTrue() == 1
+		&& throws([&]() { parse("[true, 1]").countTrue(); }) && throws([&]() { parse("[1, 2]").any(); })) && ok;
+	json::Value grid = parse("[[true, false], [false, false], [true, true]]");
+	ok = check("nested bools are packed together", grid.shape() == vector<size_t>({ 3, 2 }) && grid.getElement(vector<size_t>({ 2, 1 })).getBool()
+		&& grid.getElement(1).toVector<bool>() == vector<bool>({ false, false }) && grid.getElement(2).all()
+		&& written(grid) == "[[true, false], [false, false], [true, true]]\n") && ok;
+	flags[1].setReal(true);
+	ok = check("getIndex and setters expand the bits", flags.all() && flags.getArraySize() == 4) && ok;
+
+	json::Value gaps = parse("[1, null, 3]");
+	ok = check("nulls in numbers are masked", gaps.shape() == vector<size_t>(1,3) && gaps.getElement(0).getInteger() == 1
+		&& gaps.getElement(1).getType() == json::TNULL && gaps.getElement(2).getInteger() == 3 && written(gaps) == "[1, null, 3]\n") && ok;
+	ok = check("nulls are not numbers", throws([&]() { gaps.sum(); }) && throws([&]() { gaps.toVector<double>(); })
+		&& gaps.slice(0,3,2).sum() == 4 && parse("[[1.5, null], [2.5, 3.5]]").shape() == vector<size_t>({ 2, 2 })
+		&& written(parse("[[1.5, null], [2.5, 3.5]]")) == "[[1.5, null], [2.5, 3.5]]\n") && ok;
+	ok = check("all nulls, mixed types and null strings stay Values", parse("[null, null]").getElement(1).getType() == json::TNULL
+		&& parse("[1, null, 2u]").getElement(2).getUInteger() == 2 && parse("[\"a\", null]").getElement(1).getType() == json::TNULL) && ok;
+	gaps[1] = json::Value((json::TInteger)2);
+	ok = check("setting a null", gaps.sum() == 6) && ok;
+
+	json::Frozen frozen(parse("{ flags: [true, false], gaps: [null, 2.5] }"));
+	ok = check("frozen bools and nulls", !frozen.root().getMember("flags").getIndex(1).getBool() && frozen.root().getMember("gaps").getIndex(0).getType() == json::TNULL
+		&& frozen.root().getMember("gaps").getIndex(1).getReal() == 2.5 && written(frozen.root().thaw()) == written(parse("{ flags: [true, false], gaps: [null, 2.5] }"))) && ok;
+
+	// a large enable mask
+	string text = "[";
+	for (size_t i = 0; i < nbools; i++) text += i % 7 == 0 ? "false," : "true,";
+	text[text.size()-1] = ']';
+	json::Value mask = parse(text);
+	Clock::time_point start = Clock::now();
+	size_t packedCount = 0;
+	for (int r = 0; r < 10; r++) packedCount += mask.countTrue();
+	const double packedTime = since(start)/10;
+	json::Value values = parse(text);
+	values.getIndex(0);
+	start = Clock::now();
+	size_t valueCount = 0;
+	for (int r = 0; r < 10; r++) valueCount += values.countTrue();
+	const double valueTime = since(start)/10;
+	ok = check("large masks agree", packedCount == valueCount && packedCount == 10*(nbools - (nbools+6)/7)) && ok;
+	cout << nbools << " bools: " << nbools/8/1024 << " kB of bits instead of " << nbools*sizeof(json::Value)/1024 << " kB of Values, counted in "
+	     << packedTime*1e3 << " ms packed, " << valueTime*1e3 << " ms as Values\n";
+
+	return finish(ok,"bitset checks failed");
+
+}
@@ -1,4 +1,35 @@
 #!/bin/bash
-g++ -O4 -pedantic -Wall -std=c++11 -I ../ -o echo  ../*.cc echo.cc
-g++ -O4 -pedantic -Wall -std=c++11 -I ../ -o tovector  ../*.cc tovector.cc
-g++ -O4 -pedantic -Wall -std=c++11 -I ../ -o stats  ../*.cc stats.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o echo  ../*.cc echo.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o tovector  ../*.cc tovector.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o stats  ../*.cc stats.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o reduce  ../*.cc reduce.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o slice  ../*.cc slice.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o shape  ../*.cc shape.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o index  ../*.cc index.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o frozen  ../*.cc frozen.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o dbbench  ../*.cc dbbench.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o rtbench  ../*.cc rtbench.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o relayout  ../*.cc relayout.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o parallel  ../*.cc parallel.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o threadbench  ../*.cc threadbench.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -DJSON_ATOMIC_REFCOUNT -I ../ -o threadbench_atomic  ../*.cc threadbench.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o limits  ../*.cc limits.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o journal  ../*.cc journal.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o transcode  ../*.cc transcode.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o ratdbembed  ../*.cc ../tools/ratdbembed.cc
+./ratdbembed embedded_tables pmts.ratdb numbers.ratdb strings.ratdb objects.ratdb
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o embed  ../*.cc embedded_tables.cc embed.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o ring  ../*.cc ring.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o keys  ../*.cc keys.cc
+gcc -O3 -pedantic -Wall -std=c99 -I ../ -c capi.c -o capi.o
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o capi  ../*.cc capi.o
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o extsort  ../*.cc extsort.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o concurrent  ../*.cc concurrent.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o bulk  ../*.cc bulk.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o sketch  ../*.cc sketch.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o stringarrays  ../*.cc stringarrays.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o bitsets  ../*.cc bitsets.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o shapes  ../*.cc shapes.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o refs  ../*.cc refs.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -DJSON_ATOMIC_REFCOUNT -I ../ -o refs_atomic  ../*.cc refs.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o predict  ../*.cc predict.cc
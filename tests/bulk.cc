@@ -0,0 +1,94 @@
+#include <iostream>
+#include <sstream>
+#include <list>
+#include <iterator>
+#include <chrono>
+#include <cstdlib>
+
+#include "json.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks the bulk constructors of arrays and objects, then times building a large array element by element,
+// from a buffer, and by moving a vector in
+//     bulk [elements]
+
+typedef chrono::steady_clock Clock;
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+double since(Clock::time_point start) {
+	return chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+}
+
+int main(int argc, char **argv) {
+
+	const size_t elements = argc > 1 ? atoi(argv[1]) : 10000000;
+	bool ok = true;
+
+	const float floats[] = { 1.5f, 2.5f, 3.5f };
+	json::Value fromBuffer(floats,3);
+	ok = check("buffers of numbers are packed", fromBuffer.shape() == vector<size_t>(1,3) && fromBuffer.getElement(1).getReal() == 2.5
+		&& fromBuffer.toVector<double>() == vector<double>({ 1.5, 2.5, 3.5 })) && ok;
+	const short shorts[] = { -1, 2 };
+	const unsigned char bytes[] = { 200, 100 };
+	ok = check("integer types keep their signedness", json::Value(shorts,2).getElement(0).getInteger() == -1
+		&& json::Value(bytes,2).getElement(0).getUInteger() == 200) && ok;
+
+	vector<json::TReal> reals(1000,0.5);
+	json::Value moved(std::move(reals));
+	ok = check("moved vectors become the packed storage", reals.empty() && moved.getArraySize() == 1000
+		&& moved.getElement(999).getReal() == 0.5) && ok;
+	vector<json::Value> values = { json::Value(1), json::Value(json::TString("two")) };
+	json::Value movedValues(std::move(values));
+	ok = check("moved vectors of Values", values.empty() && movedValues[1].getString() == "two") && ok;
+
+	vector<int> ints = { 3, 1, 2 };
+	ok = check("vectors are copied as before", written(json::Value(ints)) == "[3, 1, 2]\n" && json::Value(ints)[0].getType() == json::TINTEGER) && ok;
+	vector<bool> flags = { true, false };
+	vector<string> names = { "a", "b" };
+	ok = check("vectors of bools and strings hold Values", written(json::Value(flags)) == "[true, false]\n"
+		&& written(json::Value(names)) == "[\"a\", \"b\"]\n") && ok;
+	ok = check("empty arrays", json::Value(vector<double>()).getArraySize() == 0 && json::Value(floats,0).getArraySize() == 0
+		&& json::Value(vector<json::TInteger>()).getArraySize() == 0) && ok;
+
+	list<long> linked = { 4, 5, 6 };
+	istringstream numbers("7 8 9");
+	json::Value fromList(linked.begin(),linked.end());
+	json::Value fromStream((istream_iterator<int>(numbers)),istream_iterator<int>());
+	ok = check("iterator ranges", fromList.getElement(2).getInteger() == 6 && fromStream.shape() == vector<size_t>(1,3)
+		&& fromStream.getElement(0).getInteger() == 7) && ok;
+
+	map<string,double> gains = { { "b", 2.0 }, { "a", 1.0 } };
+	unordered_map<string,vector<int> > channels = { { "x", { 1, 2 } }, { "y", { 3 } } };
+	json::Value object(gains);
+	json::Value nested(channels);
+	ok = check("maps become objects", object.getMembers() == vector<string>({ "a", "b" }) && object["b"].getReal() == 2.0
+		&& nested["x"].shape() == vector<size_t>(1,2) && nested["y"].getElement(0).getInteger() == 3) && ok;
+
+	vector<double> source(elements);
+	for (size_t i = 0; i < elements; i++) source[i] = i*0.5;
+	Clock::time_point start = Clock::now();
+	json::Value byElement(json::TARRAY);
+	byElement.setArraySize(elements);
+	for (size_t i = 0; i < elements; i++) byElement.setIndex(i,json::Value(source[i]));
+	const double elementTime = since(start);
+	start = Clock::now();
+	json::Value byBuffer(source.data(),source.size());
+	const double bufferTime = since(start);
+	start = Clock::now();
+	json::Value byMove(std::move(source));
+	const double moveTime = since(start);
+	ok = check("large arrays agree", byElement.sum() == byBuffer.sum() && byBuffer.sum() == byMove.sum()) && ok;
+	cout << elements << " reals: by element " << elementTime*1e3 << " ms, from a buffer " << bufferTime*1e3 << " ms, moved "
+	     << moveTime*1e3 << " ms\n";
+
+	return finish(ok,"bulk construction checks failed");
+
+}
@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fastjson.h"
+
+/* Reads documents through the C interface, checking borrowed strings, numbers, iteration and errors, and
+ * compares summing a large array through one borrowed pointer with reading it element by element
+ *     capi [directory of pmts.ratdb] */
+
+static int ok = 1;
+
+/* Counts heap calls, to check lookups make none */
+static size_t allocations = 0;
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+void *malloc(size_t size) { allocations++; return __libc_malloc(size); }
+#endif
+
+static void check(const char *what, int passed) {
+	printf("%s %s\n", passed ? "ok  " : "FAIL", what);
+	ok = ok && passed;
+}
+
+static double seconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+int main(int argc, char **argv) {
+
+	const char *text = "{ name: \"tank\", size: [3, 4], shape: [[1.5, 2.5], [3.5, 4.5]], flag: true, big: 18446744073709551615u, mixed: [1, \"a\", {}], crates: [\"north\", \"south\"], enabled: [true, false, true], gains: [1.5, null] }\n[ 1, 2 ]";
+	char error[256];
+	const char *data;
+	size_t length, count;
+	int64_t integer;
+	uint64_t uinteger;
+	double real;
+	int boolean;
+	fj_type type;
+	const void *numbers;
+	const size_t *shape;
+
+	fj_document *document = fj_parse(text, strlen(text), error, sizeof(error));
+	check("parses text", document != NULL && fj_document_size(document) == 2 && fj_abi_version() == FJ_ABI_VERSION);
+	fj_value *root = fj_document_get(document, 0);
+	check("object has its members", fj_type_of(root) == FJ_OBJECT && fj_size(root) == 9);
+	check("borrows strings", fj_get_string(fj_member(root, "name", 4), &data, &length) && length == 4 && !memcmp(data, "tank", 4));
+	{
+		const char *key = "a_member_with_a_name_too_long_for_short_strings";
+		const char *named = "{ a_member_with_a_name_too_long_for_short_strings: 1, x: 2 }";
+		fj_document *longer = fj_parse(named, strlen(named), error, sizeof(error));
+		const fj_value *top = fj_document_get(longer, 0);
+		const size_t before = allocations;
+		const int found = fj_get_integer(fj_member(top, key, strlen(key)), &integer) && integer == 1
+			&& fj_member(top, "a_member_with_a_name_too_long_for_short_strings_or_longer", strlen(key)+10) == NULL;
+		check("long keys are looked up without allocating", found && allocations == before);
+		fj_document_free(longer);
+	}
+	check("missing member is NULL", fj_member(root, "nothing", 7) == NULL && fj_member(fj_member(root, "name", 4), "x", 1) == NULL);
+	check("wrong type is refused", !fj_get_integer(fj_member(root, "name", 4), &integer) && !fj_get_string(root, &data, &length));
+	check("scalars", fj_get_bool(fj_member(root, "flag", 4), &boolean) && boolean
+		&& fj_get_uinteger(fj_member(root, "big", 3), &uinteger) && uinteger == 18446744073709551615ull);
+
+	fj_value *size = fj_member(root, "size", 4);
+	check("borrows packed integers", fj_numbers(size, &type, &numbers, &count) && type == FJ_INTEGER && count == 2
+		&& ((const int64_t*)numbers)[0] == 3 && ((const int64_t*)numbers)[1] == 4);
+	check("packed elements have no handles", fj_index(size, 0) == NULL && fj_index_real(size, 1, &real) && real == 4);
+	fj_value *grid = fj_member(root, "shape", 5);
+	check("borrows packed matrices", fj_numbers(grid, &type, &numbers, &count) && type == FJ_REAL && count == 4
+		&& ((const double*)numbers)[3] == 4.5 && fj_shape(grid, &shape, &length) && length == 2 && shape[0] == 2 && shape[1] == 2);
+	fj_value *mixed = fj_member(root, "mixed", 5);
+	check("mixed arrays index values", !fj_numbers(mixed, &type, &numbers, &count) && fj_size(mixed) == 3
+		&& fj_get_integer(fj_index(mixed, 0), &integer) && integer == 1 && fj_type_of(fj_index(mixed, 2)) == FJ_OBJECT
+		&& fj_index(mixed, 3) == NULL && !fj_pack(mixed));
+	fj_value *crates = fj_member(root, "crates", 6);
+	check("borrows packed strings", fj_index(crates, 1) == NULL && fj_index_string(crates, 1, &data, &length) && length == 5
+		&& !strcmp(data, "south") && fj_index_string(mixed, 1, &data, &length) && !strcmp(data, "a")
+		&& !fj_index_string(mixed, 0, &data, &length) && !fj_numbers(crates, &type, &numbers, &count));
+	check("packed bools and nulls", fj_index_bool(fj_member(root, "enabled", 7), 2, &boolean) && boolean
+		&& fj_index_bool(fj_member(root, "enabled", 7), 1, &boolean) && !boolean && fj_index_real(fj_member(root, "gains", 5), 0, &real)
+		&& real == 1.5 && !fj_index_real(fj_member(root, "gains", 5), 1, &real) && !fj_numbers(fj_member(root, "gains", 5), &type, &numbers, &count));
+
+	fj_members members;
+	fj_value *value;
+	const char *key;
+	size_t keys = 0;
+	int ordered = 1;
+	char last[16] = "";
+	fj_members_begin(root, &members);
+	while (fj_members_next(&members, &key, &length, &value)) {
+		ordered = ordered && strcmp(last, key) < 0 && value != NULL;
+		snprintf(last, sizeof(last), "%s", key);
+		keys++;
+	}
+	fj_members_begin(size, &members);
+	check("iterates members in key order", keys == 9 && ordered && !fj_members_next(&members, &key, &length, &value));
+	fj_document_free(document);
+
+	document = fj_parse("{ a: [1, 2", 10, error, sizeof(error));
+	check("reports errors", document == NULL && strstr(error, "EOF") != NULL);
+
+	char filename[1024];
+	snprintf(filename, sizeof(filename), "%s/pmts.ratdb", argc > 1 ? argv[1] : ".");
+	document = fj_parse_file(filename, error, sizeof(error));
+	value = fj_document_get(document, 0);
+	check("reads files", fj_size(value) == 6 && fj_get_string(fj_member(fj_index(value, 2), "name", 4), &data, &length) && !strcmp(data, "gamma"));
+	fj_document_free(document);
+	check("missing file", fj_parse_file("/nonexistent.ratdb", error, sizeof(error)) == NULL);
+
+	/* a large array, read in place and element by element */
+	const size_t elements = 2000000;
+	char *big = malloc(elements*12 + 16), *at = big;
+	size_t i;
+	at += sprintf(at, "[");
+	for (i = 0; i < elements; i++) at += sprintf(at, i ? ",%lu.5" : "%lu.5", (unsigned long)(i % 1000));
+	sprintf(at, "]");
+	document = fj_parse(big, strlen(big), error, sizeof(error));
+	free(big);
+	value = fj_document_get(document, 0);
+	double start = seconds(), borrowed = 0, indexed = 0;
+	fj_numbers(value, &type, &numbers, &count);
+	for (i = 0; i < count; i++) borrowed += ((const double*)numbers)[i];
+	const double inplace = seconds() - start;
+	start = seconds();
+	for (i = 0; i < fj_size(value); i++) {
+		fj_index_real(value, i, &real);
+		indexed += real;
+	}
+	const double byindex = seconds() - start;
+	check("large array sums agree", count == elements && borrowed == indexed);
+	printf("sum of %lu numbers: borrowed %g ms, by index %g ms\n", (unsigned long)elements, inplace*1e3, byindex*1e3);
+	fj_document_free(document);
+
+	if (!ok) {
+		printf("C interface checks failed\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef _TESTS_CHECK
+#define _TESTS_CHECK
+
+#include <iostream>
+#include <string>
+
+// Prints one result of a test program, returning whether it passed
+inline bool check(const std::string &what, bool ok) {
+	std::cout << (ok ? "ok   " : "FAIL ") << what << '\n';
+	return ok;
+}
+
+// The exit status of a test program, saying what failed if a check did
+inline int finish(bool ok, const std::string &failed) {
+	if (!ok) std::cout << failed << '\n';
+	return ok ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+
+#include "concurrent.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks reads, writes and versions of a ConcurrentDocument, then runs readers against writers that increment
+// counters with conditional sets and replace a subtree whose members must always agree, and compares read
+// throughput with a Value behind one mutex
+//     concurrent [readers] [milliseconds]
+
+typedef chrono::steady_clock Clock;
+
+json::Value parse(const string &text) {
+	json::Reader reader(text);
+	json::Value value;
+	reader.getValue(value);
+	return value;
+}
+
+json::Value config(size_t generation) {
+	json::Value value(json::TOBJECT);
+	value["a"] = json::Value((json::TInteger)generation);
+	value["b"] = json::Value((json::TInteger)generation);
+	value["nested"] = json::Value(json::TOBJECT);
+	value["nested"]["c"] = json::Value((json::TInteger)generation);
+	return value;
+}
+
+int main(int argc, char **argv) {
+
+	const size_t nreaders = argc > 1 ? atoi(argv[1]) : 4;
+	const size_t milliseconds = argc > 2 ? atoi(argv[2]) : 300;
+	bool ok = true;
+
+	json::ConcurrentDocument document(parse("{ detector: { name: \"tank\", pmts: [1, 2, 3], hv: { crate: 4 } }, runs: 10 }"));
+	ok = check("reads members, objects and array elements", document.get(json::Path("detector.name")).getString() == "tank"
+		&& document.get(json::Path("detector.hv")).getMember("crate").getInteger() == 4
+		&& document.get(json::Path("detector.pmts[2]")).getInteger() == 3 && document.get(json::Path("runs")).getInteger() == 10) && ok;
+	uint64_t version = 1;
+	ok = check("missing paths are null with version zero", document.get(json::Path("detector.missing"),&version).getType() == json::TNULL
+		&& version == 0 && document.get(json::Path("runs.x")).getType() == json::TNULL) && ok;
+
+	uint64_t hv, root, runs;
+	document.get(json::Path("detector.hv"),&hv);
+	document.get(json::Path(""),&root);
+	document.get(json::Path("runs"),&runs);
+	document.set(json::Path("detector.hv.crate"),json::Value((json::TInteger)5));
+	ok = check("a write changes the versions of the subtrees above it only", !document.unchanged(json::Path("detector.hv"),hv)
+		&& !document.unchanged(json::Path(""),root) && document.unchanged(json::Path("runs"),runs)
+		&& document.get(json::Path("detector.hv.crate")).getInteger() == 5) && ok;
+
+	document.set(json::Path("calibration.gains.tank"),parse("[1.5, 2.5]"));
+	ok = check("set creates missing objects", document.get(json::Path("calibration")).getMember("gains").getMember("tank")[1].getReal() == 2.5) && ok;
+	document.get(json::Path("runs"),&runs);
+	ok = check("conditional set with the current version", document.set(json::Path("runs"),json::Value((json::TInteger)11),runs)) && ok;
+	ok = check("conditional set with an old version fails", !document.set(json::Path("runs"),json::Value((json::TInteger)12),runs)
+		&& document.get(json::Path("runs")).getInteger() == 11) && ok;
+	ok = check("conditional create", document.set(json::Path("created"),json::Value((json::TInteger)1),0)
+		&& !document.set(json::Path("created"),json::Value((json::TInteger)2),0)) && ok;
+	ok = check("erase", document.erase(json::Path("detector.hv")) && !document.erase(json::Path("detector.hv"))
+		&& document.get(json::Path("detector")).getMembers().size() == 2) && ok;
+	bool threw = false;
+	try {
+		document.set(json::Path("runs.x"),json::Value((json::TInteger)1));
+	} catch (runtime_error &e) {
+		threw = true;
+	}
+	ok = check("writes through a non-object throw", threw) && ok;
+	document.set(json::Path("detector"),parse("{ replaced: true }"));
+	ok = check("replacing a subtree discards its members", document.get(json::Path("detector.name")).getType() == json::TNULL
+		&& document.get(json::Path("detector.replaced")).getBool()) && ok;
+
+	// readers check that every read of config is one generation, while writers replace it and count
+	const size_t nwriters = 2, increments = 2000;
+	json::ConcurrentDocument live;
+	live.set(json::Path("config"),config(0));
+	for (size_t w = 0; w < nwriters; w++) live.set(json::Path("counters.c" + to_string(w)),json::Value((json::TInteger)0));
+	live.set(json::Path("shared"),json::Value((json::TInteger)0));
+	atomic<bool> stop(false);
+	atomic<size_t> torn(0), reads(0), backwards(0);
+	vector<thread> threads;
+	for (size_t r = 0; r < nreaders; r++) {
+		threads.push_back(thread([&]() {
+			json::TInteger last = 0;
+			size_t count = 0;
+			while (!stop.load()) {
+				json::Value value = live.get(json::Path("config"));
+				const json::TInteger a = value["a"].getInteger();
+				if (a != value["b"].getInteger() || a != value["nested"]["c"].getInteger()) torn++;
+				if (a < last) backwards++;
+				last = a;
+				count++;
+			}
+			reads += count;
+		}));
+	}
+	atomic<size_t> conflicts(0);
+	for (size_t w = 0; w < nwriters; w++) {
+		threads.push_back(thread([&,w]() {
+			const json::Path own("counters.c" + to_string(w)), shared("shared");
+			for (size_t i = 0; i < increments; i++) {
+				uint64_t version;
+				const json::TInteger count = live.get(own).getInteger();
+				live.set(own,json::Value(count+1));
+				for (;;) {
+					const json::TInteger total = live.get(shared,&version).getInteger();
+					if (live.set(shared,json::Value(total+1),version)) break;
+					conflicts++;
+				}
+				if (w == 0) live.set(json::Path("config"),config(i+1));
+			}
+		}));
+	}
+	for (size_t w = 0; w < nwriters; w++) threads[nreaders+w].join();
+	stop = true;
+	for (size_t r = 0; r < nreaders; r++) threads[r].join();
+	json::Value counters = live.get(json::Path("counters"));
+	bool counted = live.get(json::Path("shared")).getInteger() == (json::TInteger)(nwriters*increments);
+	for (size_t w = 0; w < nwriters; w++) counted = counted && counters["c" + to_string(w)].getInteger() == (json::TInteger)increments;
+	ok = check("conditional sets never lose an increment", counted) && ok;
+	ok = check("reads are never torn or go backwards", torn == 0 && backwards == 0) && ok;
+	cout << reads << " reads during " << nwriters*increments << " writes, " << conflicts << " conditional sets retried\n";
+
+	// read throughput against one Value behind a mutex while a writer keeps replacing it
+	json::Value locked = config(0);
+	mutex lock;
+	for (int concurrent = 0; concurrent < 2; concurrent++) {
+		stop = false;
+		reads = 0;
+		threads.clear();
+		for (size_t r = 0; r < nreaders; r++) {
+			threads.push_back(thread([&]() {
+				size_t count = 0;
+				json::TInteger sum = 0;
+				const json::Path path("config.nested.c");
+				while (!stop.load()) {
+					if (concurrent) {
+						sum += live.get(path).getInteger();
+					} else {
+						lock_guard<mutex> hold(lock);
+						sum += locked["nested"]["c"].getInteger();
+					}
+					count++;
+				}
+				reads += count + (sum < 0);
+			}));
+		}
+		threads.push_back(thread([&]() {
+			for (size_t i = 0; !stop.load(); i++) {
+				if (concurrent) {
+					live.set(json::Path("config"),config(i));
+				} else {
+					json::Value next = config(i);
+					lock_guard<mutex> hold(lock);
+					locked = next;
+				}
+				this_thread::sleep_for(chrono::microseconds(100));
+			}
+		}));
+		this_thread::sleep_for(chrono::milliseconds(milliseconds));
+		stop = true;
+		for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+		cout << (concurrent ? "ConcurrentDocument: " : "Value and mutex:    ") << reads*1e3/milliseconds/1e6 << " M reads/s on "
+		     << nreaders << " readers with a writer\n";
+	}
+
+	return finish(ok,"concurrent document checks failed");
+
+}
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dbserver.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Compares looking up tables through a DBServer with parsing the database in every process
+//     dbbench [ntables] [nlookups]
+
+typedef chrono::steady_clock Clock;
+
+double micros(Clock::duration d) {
+	return chrono::duration_cast<chrono::duration<double,micro> >(d).count();
+}
+
+void report(const string &what, vector<double> &latency) {
+	sort(latency.begin(),latency.end());
+	double total = 0;
+	for (size_t i = 0; i < latency.size(); i++) total += latency[i];
+	cout << what << ": mean " << total/latency.size() << "us p50 " << latency[latency.size()/2] << "us p99 " 
+	     << latency[latency.size()*99/100] << "us throughput " << latency.size()/total*1e6 << "/s\n";
+}
+
+// Connects without the DBClient protocol, reading and dropping the database size and descriptor
+int connectRaw(const string &socket) {
+	sockaddr_un addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path,socket.c_str());
+	const int fd = ::socket(AF_UNIX,SOCK_STREAM,0);
+	uint64_t size;
+	if (connect(fd,(const sockaddr*)&addr,sizeof(addr)) || read(fd,&size,sizeof(size)) != sizeof(size)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Connects and returns the database descriptor the server sends, or -1
+int receiveDatabase(const string &socket) {
+	sockaddr_un addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path,socket.c_str());
+	const int fd = ::socket(AF_UNIX,SOCK_STREAM,0);
+	uint64_t size;
+	iovec iov = { &size, sizeof(size) };
+	char control[CMSG_SPACE(sizeof(int))];
+	msghdr msg;
+	memset(&msg,0,sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	int memfd = -1;
+	cmsghdr *cmsg;
+	if (!connect(fd,(const sockaddr*)&addr,sizeof(addr)) && recvmsg(fd,&msg,0) == sizeof(size) && (cmsg = CMSG_FIRSTHDR(&msg))) {
+		memcpy(&memfd,CMSG_DATA(cmsg),sizeof(int));
+	}
+	close(fd);
+	return memfd;
+}
+
+int main(int argc, char **argv) {
+
+	const int ntables = argc > 1 ? atoi(argv[1]) : 500;
+	const int nlookups = argc > 2 ? atoi(argv[2]) : 20000;
+	stringstream name;
+	name << "/tmp/dbbench-" << getpid();
+	const string filename = name.str() + ".ratdb", socket = name.str() + ".sock";
+	{
+		ofstream out(filename.c_str());
+		for (int t = 0; t < ntables; t++) {
+			out << "{\nname: \"TABLE" << t << "\",\nindex: \"\",\nrun_range: [0, 100000],\nlabel: \"table number " << t << "\",\n";
+			out << "pmt: { x: " << t*1.5 << ", y: " << -t << ", z: " << t*0.25 << " },\ngain: [";
+			for (int i = 0; i < 64; i++) out << (i ? ", " : "") << t + i*0.01;
+			out << "]\n}\n";
+		}
+	}
+	
+	// what every process does today: parse the whole file, then look up
+	Clock::time_point start = Clock::now();
+	json::Value tables(json::TOBJECT);
+	{
+		ifstream file(filename.c_str());
+		json::Reader reader(file);
+		json::Value table;
+		while (reader.getValue(table)) tables[table["name"].getString()] = table;
+	}
+	cout << "in-process parse of " << ntables << " tables: " << micros(Clock::now()-start) << "us\n";
+	
+	const json::Path path("gain[3]");
+	vector<double> latency(nlookups);
+	vector<int> which(nlookups);
+	for (int i = 0; i < nlookups; i++) which[i] = rand() % ntables;
+	double expected = 0;
+	for (int i = 0; i < nlookups; i++) {
+		stringstream table;
+		table << "TABLE" << which[i];
+		start = Clock::now();
+		expected += path.get(tables[table.str()]).getReal();
+		latency[i] = micros(Clock::now()-start);
+	}
+	report("in-process lookup",latency);
+	
+	json::DBServer server(socket);
+	server.load(filename);
+	server.freeze();
+	thread serving([&server]() { server.run(); });
+	
+	start = Clock::now();
+	json::DBClient client(socket);
+	cout << "client connect and map: " << micros(Clock::now()-start) << "us\n";
+	double found = 0;
+	for (int i = 0; i < nlookups; i++) {
+		stringstream table;
+		table << "TABLE" << which[i];
+		start = Clock::now();
+		found += client.lookup(table.str(),"","gain[3]").getReal();
+		latency[i] = micros(Clock::now()-start);
+	}
+	report("server lookup",latency);
+	
+	// several clients at once
+	const int nclients = 4;
+	vector<thread> clients;
+	start = Clock::now();
+	for (int c = 0; c < nclients; c++) {
+		clients.push_back(thread([&socket,&which,nlookups,nclients]() {
+			json::DBClient client(socket);
+			for (int i = 0; i < nlookups/nclients; i++) {
+				stringstream table;
+				table << "TABLE" << which[i];
+				client.lookup(table.str(),"","pmt.x");
+			}
+		}));
+	}
+	for (int c = 0; c < nclients; c++) clients[c].join();
+	cout << nclients << " concurrent clients: " << nlookups/(micros(Clock::now()-start)/1e6) << " lookups/s\n";
+	
+	bool ok = found == expected && client.lookup("TABLE0","","label").getString() == "table number 0" &&
+	          client.lookup("NOPE").getType() == json::TNULL && client.lookup("TABLE1","","pmt.w").getType() == json::TNULL;
+	try {
+		client.lookup("TABLE0","","gain[");
+		ok = false;
+	} catch (runtime_error &e) { }
+
+	// clients that leave before their responses or announce huge requests are dropped, and others still served
+	int rude = connectRaw(socket);
+	string requests;
+	for (int i = 0; i < 1000; i++) {
+		const char request[] = "\x08\0\0\0TABLE0\0\0";
+		requests.append(request,sizeof(request)-1);
+	}
+	ok = check("client leaving before its responses", rude >= 0 && write(rude,requests.data(),requests.size()) == (ssize_t)requests.size()) && ok;
+	close(rude);
+	rude = connectRaw(socket);
+	const char huge[] = "\xFF\xFF\xFF\xFFTABLE0";
+	char reply;
+	ok = check("request longer than the limit", rude >= 0 && write(rude,huge,sizeof(huge)-1) == sizeof(huge)-1 && read(rude,&reply,1) == 0) && ok;
+	close(rude);
+	ok = check("server still serving", client.lookup("TABLE2","","pmt.y").getInteger() == -2) && ok;
+	rude = connectRaw(socket);
+	fcntl(rude,F_SETFL,O_NONBLOCK);
+	size_t sent = 0;
+	for (int i = 0; i < 1000; i++) { //until the server stops reading
+		const ssize_t put = write(rude,requests.data(),requests.size());
+		if (put <= 0) break;
+		sent += put;
+	}
+	alarm(30); //a stalled server fails the test rather than hanging it
+	ok = check("server serving past a client that does not read", sent > 0 && client.lookup("TABLE3","","pmt.y").getInteger() == -3) && ok;
+	alarm(0);
+	close(rude);
+
+	// the shared database cannot be changed by a client
+	const int memfd = receiveDatabase(socket);
+	const char scribble = 'x';
+	ok = check("database cannot be written", memfd >= 0 && pwrite(memfd,&scribble,1,0) < 0) && ok;
+	ok = check("database cannot be resized", memfd >= 0 && ftruncate(memfd,0) < 0 && ftruncate(memfd,1<<30) < 0) && ok;
+	if (memfd >= 0) close(memfd);
+	ok = check("database unchanged", client.lookup("TABLE0","","label").getString() == "table number 0") && ok;
+	bool threw = false;
+	try {
+		json::DBServer unfrozen(socket + "2");
+		json::DBStatus status;
+		unfrozen.lookup("TABLE0","","",status);
+	} catch (runtime_error &e) {
+		threw = true;
+	}
+	ok = check("lookup before freeze", threw) && ok;
+	unlink((socket + "2").c_str());
+	
+	server.stop();
+	serving.join();
+	unlink(filename.c_str());
+	return finish(ok,"server lookups did not match in-process lookups");
+
+}
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+#include "embedded_tables.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks tables compiled in by ratdbembed against parsing the same files, and compares the cost of getting at
+// them. build.sh generates embedded_tables.hh/.cc from pmts.ratdb, numbers.ratdb, strings.ratdb and objects.ratdb.
+//     embed [directory of the .ratdb files]
+
+typedef chrono::steady_clock Clock;
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+json::Value parse(const string &filename) {
+	ifstream file(filename.c_str());
+	json::Reader reader(file);
+	json::Value values(json::TARRAY), value;
+	size_t count = 0;
+	while (reader.getValue(value)) {
+		values.setArraySize(count+1);
+		values.setIndex(count++,value);
+	}
+	return values;
+}
+
+int main(int argc, char **argv) {
+
+	const string directory = argc > 1 ? string(argv[1]) + "/" : "";
+	const char *names[] = { "pmts", "numbers", "strings", "objects" };
+	json::FrozenValue (*tables[])() = { ratdb::pmts, ratdb::numbers, ratdb::strings, ratdb::objects };
+	bool ok = true;
+
+	for (int t = 0; t < 4; t++) {
+		const bool same = written(tables[t]().thaw()) == written(parse(directory + names[t] + ".ratdb"));
+		cout << (same ? "ok   " : "FAIL ") << names[t] << " matches its file\n";
+		ok = ok && same;
+	}
+
+	// the first lookup of a setting, as a program would at startup
+	const int iterations = 1000;
+	Clock::time_point start = Clock::now();
+	double sum = 0;
+	for (int i = 0; i < iterations; i++) sum += parse(directory + "pmts.ratdb")[0][2]["channel"].cast<double>();
+	const double parsing = chrono::duration_cast<chrono::duration<double,micro> >(Clock::now()-start).count()/iterations;
+	start = Clock::now();
+	for (int i = 0; i < iterations; i++) sum -= ratdb::pmts().getIndex(0).getIndex(2).getMember("channel").cast<double>();
+	const double embedded = chrono::duration_cast<chrono::duration<double,micro> >(Clock::now()-start).count()/iterations;
+	cout << "first lookup: parsing " << parsing << " us, embedded " << embedded << " us\n";
+	ok = ok && sum == 0;
+
+	return finish(ok,"embedded table checks failed");
+
+}
@@ -0,0 +1,167 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include "extsort.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Sorts generated records with mixed, missing and repeated keys through many small runs and several merge
+// passes, checking the order against an in memory stable sort, then times a larger sort
+//     extsort [records]
+
+typedef chrono::steady_clock Clock;
+
+// the rank of a key in the order ExternalSort uses (kind, then value)
+struct Key {
+	int kind;
+	double number;
+	string text;
+	bool operator<(const Key &other) const {
+		if (kind != other.kind) return kind < other.kind;
+		return kind == 3 ? text < other.text : number < other.number;
+	}
+};
+
+int main(int argc, char **argv) {
+
+	const size_t big = argc > 1 ? atoi(argv[1]) : 200000;
+	bool ok = true;
+
+	const size_t count = 5000;
+	stringstream input;
+	vector<pair<Key,size_t> > expected;
+	for (size_t i = 0; i < count; i++) {
+		Key key = { 0, 0, "" };
+		input << "{ seq: " << i;
+		switch (i % 7) {
+			case 0: // missing
+				break;
+			case 1:
+				key.kind = 3;
+				key.text = string(1,(char)('a' + i % 5));
+				input << ", run: { id: \"" << key.text << "\" }";
+				break;
+			case 2:
+				key.kind = 1;
+				key.number = i % 2;
+				input << ", run: { id: " << (i % 2 ? "true" : "false") << " }";
+				break;
+			case 3:
+				key.kind = 2;
+				key.number = (i % 11) + 0.5;
+				input << ", run: { id: " << key.number << " }";
+				break;
+			case 4: // arrays sort as null
+				input << ", run: { id: [1, 2] }";
+				break;
+			default:
+				key.kind = 2;
+				key.number = (double)(i % 13);
+				input << ", run: { id: " << (i % 13) << (i % 2 ? "u" : "") << " }";
+		}
+		input << ", payload: \"" << string(i % 40,'x') << "\\n\" }\n";
+		// RATDB files may hold several records on a line and comments
+		if (i % 100 == 0) input << "// comment " << i << '\n';
+		expected.push_back(make_pair(key,i));
+	}
+	const string text = input.str();
+
+	for (int descending = 0; descending < 2; descending++) {
+		vector<pair<Key,size_t> > order(expected);
+		stable_sort(order.begin(),order.end(),[descending](const pair<Key,size_t> &a, const pair<Key,size_t> &b) {
+			return descending ? b.first < a.first : a.first < b.first;
+		});
+		json::SortOptions options("run.id");
+		options.descending = descending;
+		options.memory = 64*1024;
+		options.threads = 3;
+		options.fanIn = 4;
+		json::ExternalSort sort(options);
+		istringstream in(text);
+		sort.add(in);
+		const size_t runs = sort.getRuns();
+		stringstream out;
+		const size_t written = sort.write(out);
+		json::Reader reader(out);
+		json::Value value;
+		size_t i = 0;
+		bool same = written == count;
+		while (same && reader.getValue(value)) {
+			same = i < count && (size_t)value["seq"].getInteger() == order[i].second && value["payload"].getString() == string(order[i].second % 40,'x') + "\n";
+			i++;
+		}
+		ok = check(string(descending ? "descending" : "ascending") + " order matches a stable sort", same && i == count) && ok;
+		ok = check("spilled several runs", runs > options.fanIn && sort.getRecords() == count) && ok;
+	}
+
+	json::SortOptions grouping("run.id");
+	grouping.group = true;
+	grouping.memory = 64*1024;
+	json::ExternalSort groups(grouping);
+	istringstream in(text);
+	groups.add(in);
+	stringstream out;
+	const size_t written = groups.write(out);
+	json::Reader reader(out);
+	json::Value value;
+	size_t total = 0, seen = 0;
+	bool consistent = true;
+	while (reader.getValue(value)) {
+		const json::Value &records = value["records"];
+		total += value["count"].getInteger();
+		consistent = consistent && (size_t)value["count"].getInteger() == records.getArraySize();
+		for (size_t i = 1; i < records.getArraySize(); i++) consistent = consistent && records[i-1]["seq"].getInteger() < records[i]["seq"].getInteger();
+		seen++;
+	}
+	ok = check("groups hold every record once", consistent && total == count && seen == written && written == 1 + 2 + 5 + 11 + 13) && ok;
+
+	json::SortOptions missing("");
+	json::ExternalSort broken(missing);
+	istringstream bad("{ a: 1 }\n{ b: [1, 2 }");
+	bool threw = false;
+	try {
+		broken.add(bad);
+		broken.write(out);
+	} catch (json::parser_error &e) {
+		threw = true;
+	}
+	ok = check("malformed records throw parser_error", threw) && ok;
+	json::ExternalSort unparsed(missing);
+	istringstream unparsable("{ a: 1 }\n{ a: 1e }\n{ a: 3 }");
+	threw = false;
+	try {
+		unparsed.add(unparsable); //split into records, then refused by the parser of a worker
+	} catch (json::parser_error &e) {
+		threw = true;
+	}
+	ok = check("records the parser refuses throw from add", threw) && ok;
+
+	stringstream large;
+	for (size_t i = 0; i < big; i++) large << "{\"event\":" << (i*7919) % big << ",\"energy\":" << (i % 1000)*0.01 << ",\"hits\":[1,2,3,4]}\n";
+	const string bigtext = large.str();
+	json::SortOptions timed("event");
+	timed.memory = bigtext.size() / 4;
+	json::ExternalSort sort(timed);
+	Clock::time_point start = Clock::now();
+	istringstream bigin(bigtext);
+	sort.add(bigin);
+	stringstream sorted;
+	sort.write(sorted);
+	const double seconds = chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+	json::Reader resorted(sorted);
+	long last = -1;
+	bool increasing = true;
+	while (resorted.getValue(value)) {
+		increasing = increasing && value["event"].getInteger() == last+1;
+		last = value["event"].getInteger();
+	}
+	ok = check("large sort is ordered", increasing && last+1 == (long)big) && ok;
+	cout << bigtext.size()/1e6 << " MB of " << big << " records sorted in " << seconds << " s (" << bigtext.size()/seconds/1e6 << " MB/s)\n";
+
+	return finish(ok,"external sort checks failed");
+
+}
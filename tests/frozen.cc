@@ -0,0 +1,37 @@
+#include <iostream>
+#include <fstream>
+
+#include "frozen.hh"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    
+    ifstream file;
+    file.open(argv[1]);
+    json::Reader reader(file);
+    
+    json::Writer writer(cout);
+    try {
+		json::Value value;
+		while (reader.getValue(value)) {
+			json::Frozen frozen(value);
+			json::FrozenValue view = frozen.root();
+			// every member must be found through the hash table of its object
+			if (view.getType() == json::TOBJECT) {
+				vector<string> keys = view.getMembers();
+				for (size_t i = 0; i < keys.size(); i++) {
+					if (!view.isMember(keys[i]) || view.getMember(keys[i]).getType() != value[keys[i]].getType()) {
+						cout << "frozen lookup of " << keys[i] << " failed\n";
+						return 1;
+					}
+				}
+				if (view.isMember("not a member")) return 1;
+			}
+			writer.putValue(view.thaw());
+		}
+	} catch (json::parser_error &e) {
+		cout << "ERROR: " << e.what() << '\n';
+	}
+
+}
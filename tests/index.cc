@@ -0,0 +1,88 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <cmath>
+
+#include "json.hh"
+
+using namespace std;
+
+void print(const string &what, const vector<size_t> &found) {
+	cout << what << ':';
+	for (size_t i = 0; i < found.size(); i++) cout << ' ' << found[i];
+	cout << '\n';
+}
+
+// the finds of several threads that build the indexes of a table at once
+vector<vector<size_t> > findTogether(const json::Value &table) {
+	const size_t nthreads = 4;
+	vector<vector<size_t> > found(3*nthreads);
+	vector<thread> threads;
+	for (size_t t = 0; t < nthreads; t++) {
+		threads.push_back(thread([&table,&found,t]() {
+			found[3*t] = table.findElements("pmt_id",json::Value(3));
+			found[3*t+1] = table.findElements("name",json::Value(string("gamma")),json::SORTED);
+			found[3*t+2] = table.findRange("crate",json::Value(2),json::Value(3));
+		}));
+	}
+	for (size_t t = 0; t < nthreads; t++) threads[t].join();
+	return found;
+}
+
+int main(int argc, char **argv) {
+    
+    ifstream file;
+    file.open(argv[1]);
+    json::Reader reader(file);
+    
+    // NaN keys sort after the other numbers and find each other
+    json::Value readings(json::TARRAY);
+    readings.setArraySize(100);
+    for (size_t i = 0; i < 100; i++) {
+		json::Value reading(json::TOBJECT);
+		reading["adc"] = json::Value(i % 3 ? (double)(i % 10) : NAN);
+		readings.setIndex(i,reading);
+	}
+    print("adc in [8,9] with NaN readings",readings.findRange("adc",json::Value(8),json::Value(9)));
+    print("adc == NaN (sorted)",readings.findElements("adc",json::Value(NAN),json::SORTED));
+    print("adc == NaN (hashed)",readings.findElements("adc",json::Value(-NAN)));
+
+    try {
+		json::Value table;
+		while (reader.getValue(table)) {
+			if (table.getType() == json::TARRAY) {
+				const vector<vector<size_t> > together = findTogether(table);
+				bool agree = true;
+				for (size_t i = 0; i < together.size(); i += 3) {
+					agree = agree && together[i] == table.findElements("pmt_id",json::Value(3))
+						&& together[i+1] == table.findElements("name",json::Value(string("gamma")),json::SORTED)
+						&& together[i+2] == table.findRange("crate",json::Value(2),json::Value(3));
+				}
+				cout << (agree ? "concurrent finds agree\n" : "concurrent finds disagree\n");
+			}
+			print("pmt_id == 3 (hashed)",table.findElements("pmt_id",json::Value(3)));
+			print("pmt_id == 3 (sorted)",table.findElements("pmt_id",json::Value(3),json::SORTED));
+			print("pmt_id == 5",table.findElements("pmt_id",json::Value(5)));
+			print("name == gamma",table.findElements("name",json::Value(string("gamma"))));
+			print("crate in [2,3]",table.findRange("crate",json::Value(2),json::Value(3)));
+			print("pmt_id in [0,8]",table.findRange("pmt_id",json::Value(0),json::Value(8)));
+			json::Value moved(json::TOBJECT);
+			moved["pmt_id"] = json::Value(3);
+			table.setIndex(0,moved);
+			print("pmt_id == 3 after setIndex",table.findElements("pmt_id",json::Value(3)));
+			json::Value view = table.slice(2,6);
+			print("pmt_id == 3 in [2,6)",view.findElements("pmt_id",json::Value(3)));
+			table.setIndex(3,moved);
+			print("pmt_id == 3 in [2,6) after parent setIndex",view.findElements("pmt_id",json::Value(3)));
+			table[1]["pmt_id"] = json::Value(42);
+			table.invalidateIndexes();
+			print("pmt_id == 42 after invalidateIndexes",table.findElements("pmt_id",json::Value(42)));
+			table.setArraySize(1);
+			print("pmt_id == 3 after setArraySize",table.findElements("pmt_id",json::Value(3),json::SORTED));
+		}
+	} catch (exception &e) {
+		cout << "ERROR: " << e.what() << '\n';
+		return 1;
+	}
+
+}
@@ -0,0 +1,224 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <csignal>
+
+#include "journal.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Edits a document through a Journal, checking that reopening it gives the same document after clean runs,
+// torn writes and interrupted compactions, and compares the cost of an edit with rewriting the whole file
+//     journal [directory] [rows]
+
+typedef chrono::steady_clock Clock;
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+void copyFile(const string &from, const string &to) {
+	ifstream in(from.c_str(),ios::binary);
+	ofstream out(to.c_str(),ios::binary);
+	out << in.rdbuf();
+}
+
+// Reopens the saved document and compares it with the expected text
+bool reopens(const string &what, const string &filename, const string &expected) {
+	json::Journal reopened(filename,0);
+	return check(what,written(reopened.document()) == expected);
+}
+
+// Edits one row the way a table editor would
+void edit(json::Journal &journal, size_t rows, size_t i) {
+	const size_t row = i*7919 % rows;
+	stringstream path;
+	path << "rows[" << row << "]";
+	journal.setMember(json::Path(path.str()),"gain",json::Value(1.0 + i*1e-3));
+	path << ".channels";
+	journal.setIndex(json::Path(path.str()),i % 8,json::Value((json::TInteger)i));
+}
+
+int main(int argc, char **argv) {
+
+	const string directory = argc > 1 ? argv[1] : "/tmp";
+	const size_t rows = argc > 2 ? atoi(argv[2]) : 20000;
+	const string filename = directory + "/journaltest.db", log = filename + ".journal", old = log + ".old";
+	unlink(filename.c_str());
+	unlink(log.c_str());
+	unlink(old.c_str());
+	rmdir((filename + ".tmp").c_str());
+	bool ok = true;
+
+	json::Value table(json::TARRAY);
+	table.setArraySize(rows);
+	for (size_t i = 0; i < rows; i++) {
+		json::Value row(json::TOBJECT);
+		row.setMember("id",json::Value((json::TInteger)i));
+		row.setMember("gain",json::Value(1.5));
+		row.setMember("channels",json::Value(vector<int>(8,(int)i)));
+		table.setIndex(i,row);
+	}
+
+	string expected;
+	size_t editBytes = 0;
+	{
+		json::Journal journal(filename,0);
+		journal.setMember(json::Path(""),"name",json::Value(string("table")));
+		journal.setMember(json::Path(""),"rows",table);
+		journal.compact();
+		journal.wait();
+
+		// edits cost the size of the edit, compared with rewriting the file
+		const size_t nedits = 1000;
+		const Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < nedits; i++) edit(journal,rows,i);
+		const double perEdit = chrono::duration_cast<chrono::duration<double,micro> >(Clock::now()-start).count()/nedits;
+		const Clock::time_point rewrite = Clock::now();
+		{
+			ofstream out((filename + ".json").c_str());
+			json::Writer writer(out);
+			writer.putValue(journal.document());
+		}
+		const double perSave = chrono::duration_cast<chrono::duration<double,micro> >(Clock::now()-rewrite).count();
+		unlink((filename + ".json").c_str());
+		editBytes = journal.journalSize()/nedits;
+		cout << "journaled edit: " << perEdit << " us (" << journal.journalSize()/nedits << " bytes), rewriting the file: " << perSave << " us\n";
+
+		journal.setMember(json::Path(""),"scratch",table[0]);
+		journal.setArraySize(json::Path("scratch.channels"),4);
+		journal.reset(json::Path("scratch.gain"),json::TNULL);
+		journal.setMember(json::Path(""),"comment",json::Value(string("edited")));
+		const size_t size = journal.journalSize();
+		bool threw = false;
+		try {
+			journal.setMember(json::Path("missing.member"),"x",json::Value());
+		} catch (runtime_error &e) {
+			threw = true;
+		}
+		ok &= check("edit of a missing path fails without a record",threw && journal.journalSize() == size);
+		ok &= check("value is copied into the document",written(journal.document()["rows"][2]) == written(table[2]));
+		journal.sync();
+		expected = written(journal.document());
+	}
+	ok &= reopens("replayed journal",filename,expected);
+
+	// a torn record at the end of the journal is dropped
+	{
+		ofstream torn(log.c_str(),ios::binary|ios::app);
+		const char partial[] = "\x30\0\0\0garbage";
+		torn.write(partial,sizeof(partial)-1);
+	}
+	ok &= reopens("torn write",filename,expected);
+
+	// crash after rotating the journal but before the snapshot was written
+	if (rename(log.c_str(),old.c_str()) == 0) ok &= reopens("interrupted compaction",filename,expected);
+	ok &= check("interrupted compaction finished",access(old.c_str(),F_OK) != 0);
+
+	// crash after the snapshot was written but before the old journal was removed
+	{
+		json::Journal journal(filename,0);
+		for (size_t i = 0; i < 100; i++) edit(journal,rows,i+5000);
+		copyFile(log,filename + ".saved");
+		journal.compact();
+		journal.wait();
+		expected = written(journal.document());
+	}
+	rename((filename + ".saved").c_str(),old.c_str());
+	ok &= reopens("snapshot with a leftover journal",filename,expected);
+
+	// compaction in the background while editing
+	{
+		json::Journal journal(filename,1 << 14);
+		for (size_t i = 0; i < 2000; i++) edit(journal,rows,i+9000);
+		ok &= check("journal compacted",journal.journalSize() + (1 << 14) <= 2000*editBytes);
+		journal.wait();
+		expected = written(journal.document());
+	}
+	ok &= reopens("background compaction",filename,expected);
+
+	// a snapshot that cannot be written (its temporary file is a directory) fails compactions without losing edits
+	const string temporary = filename + ".tmp";
+	mkdir(temporary.c_str(),0755);
+	{
+		json::Journal journal(filename,0);
+		journal.setMember(json::Path(""),"first",json::Value(1));
+		journal.compact();
+		bool threw = false;
+		try {
+			journal.wait();
+		} catch (runtime_error &e) {
+			threw = true;
+		}
+		journal.setMember(json::Path(""),"second",json::Value(2));
+		bool again = false;
+		try {
+			journal.compact();
+		} catch (runtime_error &e) {
+			again = true;
+		}
+		ok &= check("failed compactions are reported",threw && again && access(old.c_str(),F_OK) == 0);
+		journal.sync();
+		expected = written(journal.document());
+	}
+	rmdir(temporary.c_str());
+	ok &= reopens("failed compactions keep the old journal",filename,expected);
+	mkdir(temporary.c_str(),0755);
+	{
+		json::Journal journal(filename,1 << 10);
+		bool threw = false;
+		try {
+			for (size_t i = 0; i < 200; i++) edit(journal,rows,i+12000);
+		} catch (runtime_error &e) {
+			threw = true;
+		}
+		bool reported = false;
+		try {
+			journal.wait();
+		} catch (runtime_error &e) {
+			reported = true;
+		}
+		ok &= check("edits succeed while compaction fails",!threw && reported);
+		expected = written(journal.document());
+		rmdir(temporary.c_str());
+		journal.compact();
+		ok &= check("compaction after a failure",access(old.c_str(),F_OK) != 0 && journal.journalSize() == 0);
+	}
+	ok &= reopens("compaction after a failure keeps edits",filename,expected);
+
+	// an append that fails partway is cut off, so the edits acknowledged after it survive a reopen
+	{
+		json::Journal journal(filename,0);
+		rlimit limit, full;
+		getrlimit(RLIMIT_FSIZE,&full);
+		limit = full;
+		limit.rlim_cur = journal.journalSize() + 8;
+		signal(SIGXFSZ,SIG_IGN);
+		setrlimit(RLIMIT_FSIZE,&limit);
+		bool threw = false;
+		try {
+			journal.setMember(json::Path(""),"torn",json::Value(1));
+		} catch (runtime_error &e) {
+			threw = true;
+		}
+		setrlimit(RLIMIT_FSIZE,&full);
+		ok &= check("failed append is reported",threw && !journal.document().isMember("torn"));
+		journal.setMember(json::Path(""),"after",json::Value(2));
+		expected = written(journal.document());
+	}
+	ok &= reopens("edits after a failed append",filename,expected);
+
+	unlink(filename.c_str());
+	unlink(log.c_str());
+	return finish(ok,"journal checks failed");
+
+}
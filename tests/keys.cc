@@ -0,0 +1,100 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+
+#include "poolreader.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks that keys hashed while they are scanned match hashKey, that Reader and PoolReader read awkward keys,
+// and that PoolReader keeps one copy of repeated keys, then times reading objects with many keys
+//     keys [objects]
+
+typedef chrono::steady_clock Clock;
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+int main(int argc, char **argv) {
+
+	const size_t objects = argc > 1 ? atoi(argv[1]) : 100000;
+	bool ok = true;
+
+	// every length around the word size, with escapes landing on every byte of a word
+	bool same = true;
+	for (size_t length = 0; length < 40 && same; length++) {
+		for (size_t slash = 0; slash <= length && same; slash++) {
+			string key;
+			for (size_t i = 0; i < length; i++) key += (char)('a' + (i*7) % 26);
+			if (slash < length) key.replace(slash,1,"\\\"");
+			const string text = key + "\" tail";
+			json::KeyHash hash;
+			const char *quote = json::scanKey(text.data(),text.data()+text.size(),&hash);
+			same = (size_t)(quote - text.data()) == key.size() && hash.finish(key.size()) == json::hashKey(key.data(),key.size());
+		}
+	}
+	ok = check("hash while scanning matches hashKey",same) && ok;
+	const string unterminated = "abcdefghij\\\"klmnop";
+	ok = check("unterminated key ends at the end",json::scanKey(unterminated.data(),unterminated.data()+unterminated.size(),NULL) == unterminated.data()+unterminated.size()) && ok;
+
+	const string awkward = "{ \"\" : 1, \"\\\"q\" : 2, bare : 3, \"a long key that spans several words\" : 4, spaced   : 5 }";
+	json::Reader reader(awkward);
+	json::Value value;
+	reader.getValue(value);
+	ok = check("Reader reads empty, escaped, bare and long keys",value.getMembers().size() == 5 && value[""].getInteger() == 1
+		&& value["\\\"q"].getInteger() == 2 && value["bare"].getInteger() == 3 && value["a long key that spans several words"].getInteger() == 4
+		&& value["spaced"].getInteger() == 5) && ok;
+	json::Reader duplicates("{ b : 1, a : 2, b : 3 }");
+	duplicates.getValue(value);
+	ok = check("later duplicate keys replace earlier ones",value["b"].getInteger() == 3 && value.getMembers().size() == 2) && ok;
+
+	vector<uint64_t> pool(1<<16);
+	json::PoolReader pooled(awkward.data(),awkward.size(),&pool[0],pool.size()*8);
+	json::FrozenValue frozen;
+	ok = check("PoolReader reads the same keys",pooled.getValue(frozen) == json::POOL_OK && frozen.getMember("").getInteger() == 1
+		&& frozen.getMember("\\\"q").getInteger() == 2 && frozen.getMember("bare").getInteger() == 3
+		&& frozen.getMember("a long key that spans several words").getInteger() == 4 && frozen.getMember("spaced").getInteger() == 5) && ok;
+
+	// an array of records, as a table is usually written
+	stringstream table;
+	table << "[";
+	for (size_t i = 0; i < objects; i++) {
+		table << (i ? "," : "") << "{\"crate\":" << i%19 << ",\"card\":" << i%16 << ",\"channel\":" << i%32
+		      << ",\"pmt_type\":1,\"panel_number\":" << i%7 << ",\"high_voltage_setting\":" << 1800+i%100 << "}";
+	}
+	table << "]";
+	const string text = table.str();
+
+	vector<uint64_t> big(text.size());
+	json::PoolReader tables(text.data(),text.size(),&big[0],big.size()*8);
+	ok = check("PoolReader reads the table",tables.getValue(frozen) == json::POOL_OK && frozen.getArraySize() == objects
+		&& frozen.getIndex(objects-1).getMember("high_voltage_setting").getInteger() == (json::TInteger)(1800+(objects-1)%100)) && ok;
+	const size_t used = tables.getUsed();
+	stringstream single;
+	single << "[{\"crate\":0,\"card\":0,\"channel\":0,\"pmt_type\":1,\"panel_number\":0,\"high_voltage_setting\":1800}]";
+	const string one = single.str();
+	json::PoolReader first(one.data(),one.size(),&big[0],big.size()*8);
+	first.getValue(frozen);
+	ok = check("repeated keys are stored once",used < first.getUsed()*objects - 70*(objects-1)) && ok;
+
+	Clock::time_point start = Clock::now();
+	json::Reader parser(text);
+	parser.getValue(value);
+	const double parsed = chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+	start = Clock::now();
+	json::PoolReader again(text.data(),text.size(),&big[0],big.size()*8);
+	again.getValue(frozen);
+	const double pooledTime = chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+	ok = check("Reader reads the table",value.getArraySize() == objects && value[objects-1]["channel"].getInteger() == (json::TInteger)((objects-1)%32)) && ok;
+	cout << text.size()/1e6 << " MB of " << objects << " records: Reader " << text.size()/parsed/1e6 << " MB/s, PoolReader "
+	     << text.size()/pooledTime/1e6 << " MB/s using " << used << " pool bytes\n";
+
+	return finish(ok,"key checks failed");
+
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+#include "json.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks that hostile documents fail with a limit_error before their memory or time is spent, and that files
+// given on the command line still parse under the untrusted limits
+//     limits [files...]
+
+typedef chrono::steady_clock Clock;
+
+// Parses text under limits, returning the error message or "ok"
+string attempt(const string &text, const json::ReaderLimits &limits) {
+	json::Reader reader(text);
+	reader.setLimits(limits);
+	json::Value value;
+	try {
+		while (reader.getValue(value)) { }
+	} catch (json::limit_error &e) {
+		return string("limit ") + e.what();
+	} catch (json::parser_error &e) {
+		return string("error ") + e.what();
+	}
+	return "ok";
+}
+
+bool expect(const string &what, const string &text, const json::ReaderLimits &limits, const string &result) {
+	const Clock::time_point start = Clock::now();
+	const string got = attempt(text,limits);
+	const double ms = chrono::duration_cast<chrono::duration<double,milli> >(Clock::now()-start).count();
+	const bool ok = got.compare(0,result.size(),result) == 0;
+	cout << (ok ? "ok   " : "FAIL ") << what << ": " << got << " (" << ms << " ms)\n";
+	return ok;
+}
+
+int main(int argc, char **argv) {
+
+	const json::ReaderLimits untrusted = json::ReaderLimits::untrusted();
+	bool ok = true;
+
+	ok &= expect("repetition","[0 : 2000000000]",untrusted,"limit");
+	ok &= expect("repetition past int","[0 : 5000000000]",untrusted,"limit");
+	ok &= expect("small repetition","[1.5 : 1000, \"x\" : 10]",untrusted,"ok");
+
+	json::ReaderLimits few;
+	few.maxElements = 100;
+	ok &= expect("elements","[0 : 90, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11]",few,"limit");
+	ok &= expect("repeated elements","[0 : 90, 1 : 20]",few,"limit");
+	ok &= expect("elements per value","[0 : 90] [0 : 90]",few,"ok");
+
+	string deep(100000,'[');
+	ok &= expect("depth",deep,untrusted,"limit");
+	string nested;
+	for (int i = 0; i < 1000; i++) nested += "{a:";
+	ok &= expect("object depth",nested,untrusted,"limit");
+
+	json::ReaderLimits shortstrings;
+	shortstrings.maxString = 16;
+	ok &= expect("string","[\"" + string(100,'s') + "\"]",shortstrings,"limit");
+	ok &= expect("key","{" + string(100,'k') + ": 1}",shortstrings,"limit");
+	ok &= expect("short strings","{key: \"value\", \"quoted key\": \"0123456789abcdef\"}",shortstrings,"ok");
+
+	json::ReaderLimits small;
+	small.maxBytes = 1 << 16;
+	ok &= expect("bytes",string("[\"") + string(1 << 17,'b') + "\"]",small,"limit");
+	ok &= expect("repeated bytes","[0 : 10000]",small,"limit");
+
+	// many small objects until the deadline passes
+	stringstream many;
+	many << '[';
+	for (int i = 0; i < 200000; i++) many << "{ id: " << i << ", name: \"item\", values: [1, 2, 3] },\n";
+	many << ']';
+	json::ReaderLimits quick;
+	quick.maxSeconds = 1e-3;
+	ok &= expect("time",many.str(),quick,"limit");
+	ok &= expect("no limits",many.str(),json::ReaderLimits(),"ok");
+
+	// real files parse unchanged under the untrusted limits
+	for (int i = 1; i < argc; i++) {
+		ifstream file(argv[i]);
+		stringstream contents;
+		contents << file.rdbuf();
+		ok &= expect(argv[i],contents.str(),untrusted,"ok");
+	}
+
+	return finish(ok,"limit checks failed");
+
+}
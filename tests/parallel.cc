@@ -0,0 +1,119 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+
+#include "parallel.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks parallel transform/filter/reduce against one thread and reports the speedup
+//     parallel [nelements]
+
+typedef chrono::steady_clock Clock;
+
+double millis(Clock::duration d) {
+	return chrono::duration_cast<chrono::duration<double,milli> >(d).count();
+}
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+json::Value millivolts(const json::Value &volts) {
+	return json::Value(volts.getReal()*1e3);
+}
+
+bool alive(const json::Value &channel) {
+	return !channel["dead"].getBool();
+}
+
+double add(double sum, const json::Value &value) {
+	return sum + value.getReal();
+}
+
+double combine(double a, double b) {
+	return a + b;
+}
+
+int main(int argc, char **argv) {
+
+	const size_t size = argc > 1 ? atoi(argv[1]) : 1 << 22;
+	bool ok = true;
+	
+	// a packed array of reals, as the Reader produces
+	std::vector<double> numbers(size);
+	for (size_t i = 0; i < size; i++) numbers[i] = 0.25 + (i % 1000) * 1.1e-4 + 1.0 / (i+1);
+	stringstream text;
+	json::Writer(text).putValue(json::Value(numbers));
+	json::Value volts;
+	json::Reader(text.str()).getValue(volts);
+	
+	// channels as objects
+	const size_t nchannels = size/16;
+	json::Value channels(json::TARRAY);
+	channels.setArraySize(nchannels);
+	for (size_t i = 0; i < nchannels; i++) {
+		json::Value channel(json::TOBJECT);
+		channel["id"] = json::Value((int)i);
+		channel["dead"] = json::Value(i % 7 == 3);
+		channels[i] = channel;
+	}
+	
+	json::parallel::ThreadPool serial(1);
+	json::parallel::ThreadPool pool(max(thread::hardware_concurrency(),4u));
+	cout << "threads: " << pool.size() << '\n';
+	
+	Clock::time_point start = Clock::now();
+	const json::Value expected = json::parallel::transform(volts,millivolts,serial);
+	const double tserial = millis(Clock::now()-start);
+	start = Clock::now();
+	const json::Value converted = json::parallel::transform(volts,millivolts,pool);
+	const double tparallel = millis(Clock::now()-start);
+	cout << "transform " << size << ": " << tserial << "ms serial " << tparallel << "ms parallel\n";
+	ok = ok && converted.getArraySize() == size && converted[12].getReal() == volts[12].getReal()*1e3 && written(converted) == written(expected);
+	
+	start = Clock::now();
+	const json::Value live = json::parallel::filter(channels,alive,serial);
+	const double fserial = millis(Clock::now()-start);
+	start = Clock::now();
+	const json::Value plive = json::parallel::filter(channels,alive,pool);
+	const double fparallel = millis(Clock::now()-start);
+	cout << "filter " << nchannels << ": " << fserial << "ms serial " << fparallel << "ms parallel\n";
+	ok = ok && written(live) == written(plive) && live.getArraySize() == nchannels - (nchannels+3)/7;
+	
+	// the sum must not depend on the number of threads
+	start = Clock::now();
+	const double sum = json::parallel::reduce(volts,0.0,add,combine,serial);
+	const double rserial = millis(Clock::now()-start);
+	for (unsigned int nthreads = 2; nthreads <= 8; nthreads *= 2) {
+		json::parallel::ThreadPool threads(nthreads);
+		ok = ok && json::parallel::reduce(volts,0.0,add,combine,threads) == sum;
+	}
+	start = Clock::now();
+	ok = ok && json::parallel::reduce(volts,0.0,add,combine,pool) == sum;
+	cout << "reduce " << size << ": " << rserial << "ms serial " << millis(Clock::now()-start) << "ms parallel\n";
+	
+	// members of objects, and a packed result that filter keeps packed
+	json::Value calibration(json::TOBJECT);
+	calibration["gain"] = json::Value(2.0);
+	calibration["offset"] = json::Value(-0.5);
+	calibration["unit"] = json::Value(string("V"));
+	const json::Value scaled = json::parallel::transform(json::parallel::filter(calibration,[](const json::Value &v) { return v.getType() == json::TREAL; }),millivolts);
+	ok = ok && scaled.getMembers().size() == 2 && scaled["offset"].getReal() == -500.0;
+	const json::Value small = json::parallel::filter(volts,[](const json::Value &v) { return v.getReal() < 1e-5; });
+	ok = ok && small.shape().size() == 1;
+	
+	try {
+		json::parallel::transform(channels,[](const json::Value &v) { return json::Value(v["id"].getReal()); });
+		ok = false;
+	} catch (runtime_error &e) { }
+	
+	return finish(ok,"parallel results differ from serial");
+
+}
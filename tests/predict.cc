@@ -0,0 +1,137 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#include "json.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks that reading streams of records with predicted keys gives the same values as reading them without,
+// including records that break the prediction, counts the heap allocations of reading many records, and times
+// the reading of NDJSON and RATDB (bare keys) records with and without prediction
+//     predict [records]
+
+typedef chrono::steady_clock Clock;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+	allocations++;
+	void *memory = malloc(size ? size : 1);
+	if (!memory) throw bad_alloc();
+	return memory;
+}
+
+void operator delete(void *memory) noexcept {
+	free(memory);
+}
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+double since(Clock::time_point start) {
+	return chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+}
+
+// reads all the values of text, returning them written one per line
+string readAll(const string &text, bool predicting, vector<json::Value> *values = NULL) {
+	json::Reader reader(text);
+	reader.setPrediction(predicting);
+	json::Value value;
+	string all;
+	while (reader.getValue(value)) {
+		all += written(value);
+		if (values) values->push_back(value);
+	}
+	return all;
+}
+
+string record(size_t i) {
+	return "{\"run\": " + to_string(i / 100) + ", \"event\": " + to_string(i) + ", \"pos\": {\"x\": " + to_string(i % 7)
+		+ ".5, \"y\": -1.25, \"z\": 3}, \"trigger\": {\"word\": " + to_string(i % 5) + ", \"gtid\": " + to_string(i)
+		+ "}, \"nhits\": " + to_string(i % 300) + ", \"fitter\": \"scint\", \"valid\": true}\n";
+}
+
+string table(size_t i) {
+	return "{\n  name: \"PMTCAL\",\n  index: \"crate" + to_string(i % 19) + "\",\n  run_range: [" + to_string(i) + ", " + to_string(i+1)
+		+ "],\n  pass: 0,\n  channel: " + to_string(i % 512) + ",\n  gain: " + to_string(i % 13) + ".25,\n  comment: \"\",\n}\n";
+}
+
+int main(int argc, char **argv) {
+
+	const size_t nrecords = argc > 1 ? atoi(argv[1]) : 200000;
+	bool ok = true;
+
+	const string stream = "{\"a\": 1, \"b\": {\"c\": 2}}\n{\"a\": 3, \"b\": {\"c\": 4}}\n"
+		"{\"b\": {\"c\": 5}, \"a\": 6}\n"                     // reordered
+		"{\"a\": 7}\n{\"a\": 8, \"b\": {\"c\": 9}, \"d\": 10}\n"  // missing and extra keys
+		"{\"ab\": 11, \"b\": {\"cd\": 12}}\n{\"a\": 13, \"b\": {\"c\": 14}}\n" // keys that extend the predicted ones
+		"{\"a\": 15, \"b\": {}}\n{}\n{\"a\": 16, \"a\": 17}\n{\"a\": 18, \"a\": 19}\n" // empty objects and duplicates
+		"{\"p\": {\"x\": 1}, \"q\": {\"w\": 2}}\n{\"p\": {\"x\": 3}, \"q\": {\"w\": 4}}\n" // different objects at one depth
+		"{a: 20, \"b\": {c: 21}}\n{\"a\": 22, b: {\"c\": 23}}\n{a:24,b:{c : 25}}\n" // bare keys
+		"[{\"a\": 26}, {\"a\": 27}, [{\"a\": 28}]]\n7\n\"a\"\n";
+	vector<json::Value> values;
+	ok = check("streams read alike with and without prediction", readAll(stream,true,&values) == readAll(stream,false)) && ok;
+	ok = check("members of predicted records", values.size() == 19 && values[1]["b"]["c"].getInteger() == 4 && values[2]["a"].getInteger() == 6
+		&& values[3].getMembers() == vector<string>({ "a" }) && values[4]["d"].getInteger() == 10 && values[5]["ab"].getInteger() == 11
+		&& !values[5].isMember("a") && values[6]["b"]["c"].getInteger() == 14 && values[7]["b"].getMembers().empty()
+		&& values[9]["a"].getInteger() == 17 && values[10]["a"].getInteger() == 19 && values[10].getMembers().size() == 1
+		&& values[12]["q"]["w"].getInteger() == 4 && values[13]["b"]["c"].getInteger() == 21 && values[15]["b"]["c"].getInteger() == 25
+		&& values[16][2][0]["a"].getInteger() == 28) && ok;
+	values[0]["b"]["c"] = json::Value(30);
+	values[0]["e"] = json::Value(31);
+	ok = check("predicted records are changed alone", values[0]["b"]["c"].getInteger() == 30 && values[1]["b"]["c"].getInteger() == 4
+		&& values[0]["e"].getInteger() == 31 && !values[1].isMember("e") && values[1].getMembers() == vector<string>({ "a", "b" })) && ok;
+	bool threw = false;
+	try {
+		readAll("{\"a\": 1}\n{\"a\" 2}\n",true);
+	} catch (json::parser_error &e) {
+		threw = true;
+	}
+	ok = check("errors in predicted keys", threw) && ok;
+
+	// many records, as NDJSON and as RATDB tables
+	string lines, tables;
+	for (size_t i = 0; i < nrecords; i++) {
+		lines += record(i);
+		tables += table(i);
+	}
+	const string kinds[] = { "NDJSON", "RATDB" };
+	const string *texts[] = { &lines, &tables };
+	for (size_t k = 0; k < 2; k++) {
+		double times[2] = { 1e9, 1e9 };
+		size_t counts[2] = { 0, 0 };
+		string outputs[2];
+		for (int pass = 0; pass < 3; pass++) { //the best of a few passes
+			for (int predicting = 0; predicting < 2; predicting++) {
+				json::Reader reader(*texts[k]);
+				reader.setPrediction(predicting);
+				vector<json::Value> records;
+				records.reserve(nrecords+1);
+				json::Value value;
+				const size_t before = allocations;
+				Clock::time_point start = Clock::now();
+				while (reader.getValue(value)) records.push_back(value);
+				times[predicting] = min(times[predicting],since(start));
+				counts[predicting] = allocations - before;
+				if (pass == 0) {
+					for (size_t i = 0; i < records.size(); i += 997) outputs[predicting] += written(records[i]);
+				}
+			}
+		}
+		ok = check(kinds[k] + " records are read alike with fewer allocations", outputs[0] == outputs[1] && !outputs[0].empty()
+			&& counts[1] < counts[0]*3/4) && ok;
+		cout << nrecords << " " << kinds[k] << " records: predicted in " << times[1]*1e3 << " ms with " << counts[1] << " allocations, unpredicted in "
+		     << times[0]*1e3 << " ms with " << counts[0] << " allocations\n";
+	}
+
+	return finish(ok,"prediction checks failed");
+
+}
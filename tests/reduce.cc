@@ -0,0 +1,44 @@
+#include <iostream>
+#include <fstream>
+
+#include "json.hh"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    
+    ifstream file;
+    file.open(argv[1]);
+    json::Reader reader(file);
+    
+    json::Writer writer(cout);
+    try {
+		json::Value value;
+		while (reader.getValue(value)) {
+			try {
+				writer.putValue(value);
+				cout << "sum " << value.sum() << " min " << value.min() << " max " << value.max() << " argmax " << value.argmax();
+				cout << " mean " << value.mean() << " variance " << value.variance() << '\n';
+				vector<size_t> hist = value.histogram(4,value.min(),value.max()+1);
+				cout << "histogram";
+				for (size_t i = 0; i < hist.size(); i++) cout << ' ' << hist[i];
+				cout << '\n';
+			} catch (runtime_error &e) {
+				cout << e.what() << '\n';
+			}
+		}
+	} catch (json::parser_error &e) {
+		cout << "ERROR: " << e.what() << '\n';
+	}
+	
+	// threaded reductions must agree with single threaded ones
+	vector<double> big(1 << 21);
+	for (size_t i = 0; i < big.size(); i++) big[i] = (i*7919) % 1000 - 500.0;
+	json::Value value(big);
+	if (value.sum() != value.sum(4) || value.max() != value.max(4) || value.argmax() != value.argmax(4) ||
+	    value.histogram(10,-500,500) != value.histogram(10,-500,500,4)) {
+		cout << "threaded reduction mismatch\n";
+		return 1;
+	}
+
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "json.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks that borrowed handles read Values (including packed arrays, views and shared keys) as Values do, and
+// times repeated traversals of a table of records (small enough to stay in cache, as a calibration table looked
+// up per event would) through copies of Values against traversals through handles
+//     refs [records] [traversals]
+
+typedef chrono::steady_clock Clock;
+
+json::Value parse(const string &text) {
+	json::Reader reader(text);
+	json::Value value;
+	reader.getValue(value);
+	return value;
+}
+
+double since(Clock::time_point start) {
+	return chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+}
+
+int main(int argc, char **argv) {
+
+	const size_t nrecords = argc > 1 ? atoi(argv[1]) : 10000;
+	const size_t ntraversals = argc > 2 ? atoi(argv[2]) : 100;
+	bool ok = true;
+
+	const json::Value doc = parse("{ \"name\": \"pmt\", \"gain\": 1.5, \"count\": 7, \"big\": 7u, \"on\": true, \"off\": null,"
+		" \"matrix\": [[1, 2, 3], [4, 5, 6]], \"names\": [\"a\", \"bb\"], \"flags\": [true, false, true], \"holes\": [1.5, null],"
+		" \"rows\": [{\"x\": 1}, {\"x\": 2}], \"mixed\": [1, \"two\", [3]] }");
+	const json::ConstValueRef ref(doc);
+	size_t length;
+	ok = check("scalars", ref.getType() == json::TOBJECT && ref["name"].getString() == "pmt" && ref["gain"].getReal() == 1.5
+		&& ref["count"].getInteger() == 7 && ref["big"].getUInteger() == 7 && ref["on"].getBool() && ref["off"].getType() == json::TNULL
+		&& !strcmp(ref["name"].getChars(length),"pmt") && length == 3 && ref["count"].cast<double>() == 7.0) && ok;
+	const json::ConstValueRef matrix = ref["matrix"];
+	ok = check("packed rows and numbers are read in place", matrix.getArraySize() == 2 && matrix.shape() == vector<size_t>({ 2, 3 })
+		&& matrix[1].getType() == json::TARRAY && matrix[1].getArraySize() == 3 && matrix[1][2].getInteger() == 6
+		&& matrix[1].toVector<int>() == vector<int>({ 4, 5, 6 }) && matrix.getElement(0).toVector<int>() == vector<int>({ 1, 2, 3 })
+		&& doc["matrix"].getElement(1).getArraySize() == 3) && ok;
+	ok = check("packed strings, bools and nulls", ref["names"][1].getString() == "bb" && !strcmp(ref["names"].getChars(0,length),"a")
+		&& ref["flags"][2].getBool() && !ref["flags"][1].getBool() && ref["holes"][1].getType() == json::TNULL && ref["holes"][0].getReal() == 1.5
+		&& ref["mixed"][1].getString() == "two" && ref["mixed"][2][0].getInteger() == 3) && ok;
+	const json::Value view = doc["matrix"].getElement(1).slice(0,3,2);
+	ok = check("views and shared keys", json::ConstValueRef(view)[1].getInteger() == 6 && ref["rows"][1]["x"].getInteger() == 2
+		&& ref["rows"][0].isMember("x") && ref["rows"][0].getMembers() == vector<string>({ "x" })) && ok;
+	bool threw = false;
+	try {
+		ref["name"].getInteger();
+	} catch (runtime_error &e) {
+		threw = true;
+	}
+	ok = check("missing members read as null without being added", ref["missing"].getType() == json::TNULL && !ref.isMember("missing")
+		&& doc.getMembers().size() == 12 && threw) && ok;
+	ok = check("paths", json::Path("matrix[1][2]").find(doc).getInteger() == 6 && json::Path("rows[1].x").get(doc).getInteger() == 2
+		&& json::Path("rows[5].x").find(doc).getType() == json::TNULL && json::Path("names[0]").get(doc).getString() == "a") && ok;
+
+	json::Value edited = parse("{ \"cal\": { \"gains\": [1.0, 2.0] } }");
+	json::ValueRef handle(edited);
+	handle["cal"]["gains"][1].setReal(3.0);
+	handle["cal"].setMember("offset",json::Value(0.5));
+	ok = check("handles that modify", edited["cal"]["gains"][1].getReal() == 3.0 && edited["cal"]["offset"].getReal() == 0.5
+		&& handle["cal"]["gains"].getArraySize() == 2) && ok;
+
+	// a table of records, traversed through copies and through handles
+	string text = "[";
+	for (size_t i = 0; i < nrecords; i++) {
+		text += (i ? ", {\"id\": " : "{\"id\": ") + to_string(i) + ", \"pos\": {\"x\": " + to_string(i % 100) + ", \"y\": 1}, \"name\": \"n\"}";
+	}
+	text += "]";
+	const json::Value table = parse(text);
+	const string pos("pos"), x("x");
+	const json::ConstValueRef rows(table);
+	long copies = 0, borrowed = 0;
+	double copyTime = 1e9, refTime = 1e9;
+	for (int pass = 0; pass < 3; pass++) { //the best of a few passes, alternating
+		copies = borrowed = 0;
+		Clock::time_point start = Clock::now();
+		for (size_t t = 0; t < ntraversals; t++) {
+			for (size_t i = 0; i < nrecords; i++) {
+				const json::Value record = table.getElement(i);
+				const json::Value position = record.getMember(pos);
+				copies += position.getMember(x).getInteger();
+			}
+		}
+		copyTime = min(copyTime,since(start));
+		start = Clock::now();
+		for (size_t t = 0; t < ntraversals; t++) {
+			for (size_t i = 0; i < nrecords; i++) {
+				const json::ConstValueRef record = rows.getIndex(i);
+				const json::ConstValueRef position = record.getMember(pos);
+				borrowed += position.getMember(x).getInteger();
+			}
+		}
+		refTime = min(refTime,since(start));
+	}
+	ok = check("traversals agree", copies == borrowed && (size_t)copies == ntraversals*(nrecords/100*4950)) && ok;
+	cout << ntraversals << " traversals of " << nrecords << " records: through Values " << copyTime*1e3 << " ms, through handles " << refTime*1e3 << " ms\n";
+
+	return finish(ok,"reference checks failed");
+
+}
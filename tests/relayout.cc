@@ -0,0 +1,130 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "frozen.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Profiles the lookups of a few hot members in a frozen table of channels and compares lookup times before and
+// after Frozen::relayout
+//     relayout [nchannels] [passes]
+
+typedef chrono::steady_clock Clock;
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+// Looks up the hot members of every channel, returning their sum
+double hotpath(const json::Frozen &frozen, size_t passes) {
+	const json::FrozenValue channels = frozen.root().getMember("channels");
+	const size_t size = channels.getArraySize();
+	double sum = 0;
+	for (size_t pass = 0; pass < passes; pass++) {
+		for (size_t i = 0; i < size; i++) {
+			const json::FrozenValue channel = channels.getIndex(i);
+			const json::FrozenValue position = channel.getMember("position");
+			sum += channel.getMember("gain").getIndex(1).getReal() + position.getMember("x").getReal() + position.getMember("z").getReal();
+		}
+	}
+	return sum;
+}
+
+int main(int argc, char **argv) {
+
+	const size_t nchannels = argc > 1 ? atoi(argv[1]) : 4000;
+	const size_t passes = argc > 2 ? atoi(argv[2]) : 50;
+	
+	json::Value channels(json::TARRAY);
+	channels.setArraySize(nchannels);
+	for (size_t i = 0; i < nchannels; i++) {
+		json::Value channel(json::TOBJECT);
+		for (int m = 0; m < 30; m++) {
+			stringstream key, description;
+			key << "calibration_" << m;
+			description << "calibration constant " << m << " of channel " << i << " measured in an earlier run";
+			channel[key.str()] = json::Value(description.str());
+		}
+		json::Value gain(json::TARRAY), position(json::TOBJECT);
+		gain.setArraySize(4);
+		for (int g = 0; g < 4; g++) gain[g] = json::Value(1.0 + g + i*1e-3);
+		position["x"] = json::Value(i*1.0);
+		position["y"] = json::Value(i*2.0);
+		position["z"] = json::Value(i*3.0);
+		channel["gain"] = gain;
+		channel["position"] = position;
+		channel["id"] = json::Value((int)i);
+		channels[i] = channel;
+	}
+	json::Value document(json::TOBJECT);
+	document["channels"] = channels;
+	document["comment"] = json::Value(string("generated by relayout"));
+	const json::Frozen frozen(document);
+	
+	json::FrozenProfile profile(frozen);
+	profile.start();
+	const double expected = hotpath(frozen,1);
+	profile.stop();
+	const json::FrozenValue first = frozen.root().getMember("channels").getIndex(0);
+	bool ok = profile.hits(first,"gain") == 1 && profile.hits(first.getMember("position"),"y") == 0 && profile.hits(first,"id") == 0;
+	
+	const json::Frozen hot = frozen.relayout(profile);
+	ok = ok && written(hot.root().thaw()) == written(document);
+	
+	// profiles of a buffer that was already laid out count its hot tables
+	json::FrozenProfile again(hot);
+	again.start();
+	hotpath(hot,1);
+	again.stop();
+	ok = ok && written(hot.relayout(again).root().thaw()) == written(document);
+	
+	// threads count on their own, and may outlive the profile they were started on
+	json::FrozenProfile shared(frozen);
+	vector<thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.push_back(thread([&shared,&frozen]() {
+			shared.start();
+			hotpath(frozen,2);
+			shared.stop();
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+	ok = ok && shared.hits(first,"gain") == 8 && shared.hits(first,"position") == 8;
+	json::FrozenProfile *dropped = new json::FrozenProfile(frozen);
+	atomic<bool> started(false), destroyed(false);
+	thread outliving([&]() {
+		dropped->start();
+		started = true;
+		while (!destroyed) this_thread::yield();
+		hotpath(frozen,1);
+		shared.start();
+		hotpath(frozen,1);
+		shared.stop();
+	});
+	while (!started) this_thread::yield();
+	delete dropped;
+	destroyed = true;
+	outliving.join();
+	ok = ok && shared.hits(first,"gain") == 9;
+
+	for (int round = 0; round < 2; round++) {
+		const json::Frozen &which = round ? hot : frozen;
+		ok = ok && hotpath(which,1) == expected;
+		const Clock::time_point start = Clock::now();
+		hotpath(which,passes);
+		const double ns = chrono::duration_cast<chrono::nanoseconds>(Clock::now()-start).count() / (5.0*passes*nchannels);
+		cout << (round ? "relayout" : "original") << " hot lookups: " << ns << "ns each\n";
+	}
+	
+	return finish(ok,"relayout changed the document");
+
+}
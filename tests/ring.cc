@@ -0,0 +1,213 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ring.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Sends monitoring records to consumer processes through a shared memory ring, checking every record each
+// consumer views or copies, that overruns are counted, and compares the rate with writing text to a pipe and reparsing it
+//     ring [directory] [records] [consumers]
+
+typedef chrono::steady_clock Clock;
+
+// A record like the DAQ's monitoring output
+json::Value record(size_t seq) {
+	json::Value value(json::TOBJECT);
+	value["seq"] = json::Value((json::TInteger)seq);
+	value["run"] = json::Value((json::TInteger)10042);
+	value["crate"] = json::Value((json::TInteger)(seq % 19));
+	value["rate"] = json::Value(seq*0.5);
+	value["status"] = json::Value(seq % 3 ? "ok" : "high");
+	json::Value channels(json::TARRAY);
+	channels.setArraySize(32);
+	for (size_t i = 0; i < 32; i++) channels.setIndex(i,json::Value((json::TInteger)(seq+i)));
+	value["channels"] = channels;
+	value["done"] = json::Value(false);
+	return value;
+}
+
+// Reads a record the way a consumer would, returning false if it is not the record numbered seq
+bool consistent(const json::FrozenValue &view, uint64_t seq) {
+	if (view.getMember("seq").getInteger() != (json::TInteger)seq) return false;
+	const json::FrozenValue channels = view.getMember("channels");
+	json::TInteger sum = 0;
+	for (size_t i = 0; i < channels.getArraySize(); i++) sum += channels.getIndex(i).getInteger();
+	return channels.getArraySize() == 32 && sum == (json::TInteger)(32*seq + 31*16) && view.getMember("rate").getReal() == seq*0.5;
+}
+
+// Reads until the done record, viewing records in place or copying them, exiting with a status that says whether
+// every record checked out
+int consume(const string &filename, int ready, size_t records, bool copying) {
+	json::RingReader reader(filename);
+	if (write(ready,"r",1) != 1) return 2;
+	size_t received = 0, corrupt = 0;
+	for (;;) {
+		json::FrozenValue view;
+		string copy;
+		const json::RingStatus status = copying ? reader.next(copy) : reader.next(view);
+		if (status == json::RING_EMPTY) {
+			reader.wait(100);
+			continue;
+		}
+		if (status == json::RING_OVERRUN) continue;
+		bool done = false, ok = false;
+		if (copying) {
+			json::Frozen frozen(copy.data(),copy.size());
+			done = frozen.root().getMember("done").getBool();
+			ok = done || consistent(frozen.root(),reader.getSequence());
+		} else {
+			try {
+				done = view.getMember("done").getBool();
+				ok = done || consistent(view,reader.getSequence());
+			} catch (runtime_error &e) {
+			}
+			if (!reader.valid()) continue; //overwritten while read, so what was read means nothing
+		}
+		if (done) break;
+		received++;
+		if (!ok) corrupt++;
+	}
+	cout << "     consumer " << getpid() << " received " << received << " lost " << reader.getLost() << endl;
+	return received + reader.getLost() == records && !corrupt ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+
+	const string directory = argc > 1 ? argv[1] : "/dev/shm";
+	const size_t records = argc > 2 ? atoi(argv[2]) : 200000;
+	const int consumers = argc > 3 ? atoi(argv[3]) : 3;
+	const string filename = directory + "/ringtest";
+	bool ok = true;
+
+	// a reader that falls behind loses what was overwritten, and says so
+	{
+		json::RingWriter writer(filename,4096);
+		json::RingReader reader(filename);
+		for (size_t i = 0; i < 1000; i++) writer.publish(record(i));
+		json::FrozenValue view;
+		ok = check("lapped reader overruns",reader.next(view) == json::RING_OVERRUN) && ok;
+		size_t received = 0, wrong = 0;
+		while (reader.next(view) == json::RING_OK) {
+			if (!consistent(view,reader.getSequence()) || !reader.valid()) wrong++;
+			received++;
+		}
+		ok = check("lapped reader reads the rest intact",received > 0 && !wrong && reader.getSequence() == 999) && ok;
+		ok = check("lapped reader counts what it lost",received + reader.getLost() == 1000) && ok;
+		json::RingReader oldest(filename,true);
+		ok = check("oldest reader starts at the oldest record",oldest.next(view) == json::RING_OK && oldest.getSequence() == 1000-received) && ok;
+		writer.publish(record(1000));
+		const bool overwritten = !oldest.valid();
+		ok = check("overwritten view is invalid",overwritten) && ok;
+
+		// copies are checked when taken and outlive the records they were copied from
+		json::RingReader copier(filename,true);
+		string copy;
+		ok = check("copier reads the oldest record",copier.next(copy) == json::RING_OK) && ok;
+		const uint64_t copied = copier.getSequence();
+		for (size_t i = 1001; i < 2000; i++) writer.publish(record(i));
+		json::Frozen frozen(copy.data(),copy.size());
+		ok = check("copy of an overwritten record is intact",!copier.valid() && consistent(frozen.root(),copied)) && ok;
+	}
+
+	// a restarted writer replaces the ring without disturbing the readers of the old one
+	{
+		json::RingWriter writer(filename,4096);
+		json::RingReader reader(filename);
+		writer.publish(record(0));
+		json::RingWriter restarted(filename,4096);
+		restarted.publish(record(7));
+		json::FrozenValue view;
+		ok = check("reader of a replaced ring reads on",reader.next(view) == json::RING_OK && consistent(view,0)
+			&& reader.next(view) == json::RING_EMPTY && reader.getLost() == 0) && ok;
+		ok = check("reader sees the ring was replaced",reader.replaced()) && ok;
+		json::RingReader reattached(filename,true);
+		ok = check("reader attaches to the new ring",!reattached.replaced() && reattached.next(view) == json::RING_OK
+			&& consistent(view,7)) && ok;
+	}
+
+	// records streamed to consumer processes
+	int ready[2];
+	if (pipe(ready)) return 1;
+	vector<pid_t> children;
+	Clock::time_point start;
+	{
+		json::RingWriter writer(filename,1<<24);
+		cout.flush(); //or the children print it again
+		for (int c = 0; c < consumers; c++) {
+			const pid_t pid = fork();
+			if (pid == 0) {
+				close(ready[0]);
+				_exit(consume(filename,ready[1],records,c % 2));
+			}
+			children.push_back(pid);
+		}
+		close(ready[1]);
+		char byte;
+		for (int c = 0; c < consumers; c++) {
+			if (read(ready[0],&byte,1) != 1) return 1;
+		}
+		close(ready[0]);
+		start = Clock::now();
+		for (size_t i = 0; i < records; i++) writer.publish(record(i));
+		json::Value done = record(records);
+		done["done"] = json::Value(true);
+		writer.publish(done);
+	}
+	for (size_t c = 0; c < children.size(); c++) {
+		int status;
+		waitpid(children[c],&status,0);
+		ok = check("consumer checked every record it viewed",WIFEXITED(status) && WEXITSTATUS(status) == 0) && ok;
+	}
+	const double ring = chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+	unlink(filename.c_str());
+
+	// the same records as text through a pipe to one consumer
+	int text[2];
+	if (pipe(text)) return 1;
+	const pid_t pid = fork();
+	if (pid == 0) {
+		close(text[1]);
+		size_t received = 0;
+		for (;;) {
+			uint32_t size;
+			if (read(text[0],&size,sizeof(size)) != sizeof(size)) break;
+			string bytes(size,'\0');
+			for (size_t got = 0; got < size; ) {
+				const ssize_t n = read(text[0],&bytes[got],size-got);
+				if (n <= 0) _exit(1);
+				got += n;
+			}
+			json::Reader reader(bytes);
+			json::Value value;
+			reader.getValue(value);
+			if (value["seq"].getInteger() == (json::TInteger)received) received++;
+		}
+		_exit(received == records ? 0 : 1);
+	}
+	close(text[0]);
+	start = Clock::now();
+	for (size_t i = 0; i < records; i++) {
+		stringstream out;
+		json::Writer writer(out);
+		writer.putValue(record(i));
+		const string bytes = out.str();
+		const uint32_t size = bytes.size();
+		if (write(text[1],&size,sizeof(size)) != sizeof(size) || write(text[1],bytes.data(),size) != (ssize_t)size) return 1;
+	}
+	close(text[1]);
+	int status;
+	waitpid(pid,&status,0);
+	const double piped = chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+	ok = check("pipe consumer parsed every record",WIFEXITED(status) && WEXITSTATUS(status) == 0) && ok;
+
+	cout << records << " records: ring to " << consumers << " consumers " << records/ring << " /s, text pipe to 1 consumer " << records/piped << " /s\n";
+
+	return finish(ok,"ring checks failed");
+
+}
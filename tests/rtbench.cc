@@ -0,0 +1,172 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/seccomp.h>
+#endif
+
+#include "poolreader.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Tail latency of parsing a small configuration message with PoolReader compared to Reader, checking that
+// the PoolReader path makes no heap or system calls
+//     rtbench [iterations] [files to compare with Reader...]
+
+// Counts every heap call made by the program
+static size_t allocations = 0;
+#ifdef __GLIBC__
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t n, size_t size);
+    void* __libc_realloc(void *ptr, size_t size);
+    void* malloc(size_t size) { allocations++; return __libc_malloc(size); }
+    void* calloc(size_t n, size_t size) { allocations++; return __libc_calloc(n,size); }
+    void* realloc(void *ptr, size_t size) { allocations++; return __libc_realloc(ptr,size); }
+}
+#endif
+
+static const char message[] =
+	"// control message\n"
+	"{\n"
+	"    name: \"DAQ_CONFIG\", run_type: 0x10, enabled: true, spare: null,\n"
+	"    thresholds: [12, 14, 12, 13, 15, 12, 11, 12],\n"
+	"    gains: [1.0:4, 1.25, 0.5e1, 2d0, 3f],\n"
+	"    trigger: { window: 400.0, prescale: 100u, \"mask\": \"0xFFFF\" },\n"
+	"    crates: [ { id: 1, slots: [1, 2, 3] }, { id: 2, slots: [4, 5] } ],\n"
+	"    comment: \"line 1\\nline 2\"\n"
+	"}\n";
+
+static char pool[1<<16];
+
+typedef chrono::steady_clock Clock;
+
+void report(const string &what, vector<double> &latency) {
+	sort(latency.begin(),latency.end());
+	cout << what << ": p50 " << latency[latency.size()/2] << "ns p99 " << latency[latency.size()*99/100] << "ns p99.9 "
+	     << latency[latency.size()*999/1000] << "ns max " << latency.back() << "ns\n";
+}
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+// Compares every value of a file read by PoolReader with Reader
+bool compare(const string &filename) {
+	ifstream file(filename.c_str());
+	stringstream contents;
+	contents << file.rdbuf();
+	const string text = contents.str();
+	json::Reader reader(text);
+	json::PoolReader poolreader(text.data(),text.size(),pool,sizeof(pool));
+	json::Value value;
+	json::FrozenValue view;
+	json::PoolStatus status;
+	while ((status = poolreader.getValue(view)) == json::POOL_OK) {
+		if (!reader.getValue(value) || written(value) != written(view.thaw())) return false;
+	}
+	return status == json::POOL_EOF && !reader.getValue(value);
+}
+
+int main(int argc, char **argv) {
+
+	const int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+	const size_t length = sizeof(message)-1;
+	bool ok = true;
+
+	for (int i = 2; i < argc; i++) {
+		const bool same = compare(argv[i]);
+		cout << argv[i] << (same ? " matches Reader\n" : " DIFFERS from Reader\n");
+		ok = ok && same;
+	}
+
+	vector<double> latency(iterations);
+	json::Value value;
+	for (int i = 0; i < iterations; i++) {
+		const Clock::time_point start = Clock::now();
+		json::Reader reader(string(message,length));
+		reader.getValue(value);
+		latency[i] = chrono::duration_cast<chrono::nanoseconds>(Clock::now()-start).count();
+	}
+	report("Reader",latency);
+
+	json::PoolReader reader(message,length,pool,sizeof(pool));
+	json::FrozenValue view;
+	size_t heap = allocations;
+	for (int i = 0; i < iterations; i++) {
+		const Clock::time_point start = Clock::now();
+		reader.reset(message,length);
+		if (reader.getValue(view) != json::POOL_OK || view.getMember("trigger").getMember("prescale").getUInteger() != 100) ok = false;
+		latency[i] = chrono::duration_cast<chrono::nanoseconds>(Clock::now()-start).count();
+	}
+	heap = allocations - heap;
+	report("PoolReader",latency);
+	cout << "PoolReader heap calls: " << heap << ", pool used: " << reader.getUsed() << " bytes\n";
+	ok = ok && heap == 0 && written(value) == written(view.thaw());
+
+	// a pool that is too small fails without allocating
+	char small[256];
+	json::PoolReader tight(message,length,small,sizeof(small));
+	heap = allocations;
+	ok = ok && tight.getValue(view) == json::POOL_EXHAUSTED && allocations == heap;
+	json::PoolReader shallow(message,length,pool,sizeof(pool),1);
+	ok = ok && shallow.getValue(view) == json::POOL_TOO_DEEP;
+	const char broken[] = "{ a: [1, 2 }";
+	json::PoolReader syntax(broken,sizeof(broken)-1,pool,sizeof(pool));
+	ok = ok && syntax.getValue(view) == json::POOL_SYNTAX;
+
+#ifdef __linux__
+	// Strict seccomp kills the process on any system call other than read, write, and exit. The child reports
+	// through a pipe whether it parsed (y), parsed wrongly (n), or could not enter seccomp (u).
+	int results[2];
+	if (pipe(results)) return 1;
+	cout.flush();
+	const pid_t child = fork();
+	if (child == 0) {
+		close(results[0]);
+		char result = 'u';
+		if (prctl(PR_SET_SECCOMP,SECCOMP_MODE_STRICT) == 0) {
+			bool parsed = true;
+			for (int i = 0; i < 1000; i++) {
+				reader.reset(message,length);
+				parsed = parsed && reader.getValue(view) == json::POOL_OK && view.getMember("crates").getIndex(1).getMember("id").getInteger() == 2;
+			}
+			result = parsed ? 'y' : 'n';
+		}
+		if (write(results[1],&result,1) < 0) { }
+		syscall(SYS_exit,0);
+	}
+	close(results[1]);
+	char result = 0;
+	if (read(results[0],&result,1) != 1) result = 0;
+	close(results[0]);
+	int wstatus;
+	waitpid(child,&wstatus,0);
+	cout << "\nPoolReader under strict seccomp: ";
+	if (!WIFEXITED(wstatus)) {
+		cout << "KILLED by a system call\n";
+		ok = false;
+	} else if (result == 'u') {
+		cout << "seccomp unavailable, not checked\n";
+	} else if (result == 'y') {
+		cout << "no system calls\n";
+	} else {
+		cout << (result == 'n' ? "parsed wrongly\n" : "no result\n");
+		ok = false;
+	}
+#endif
+
+	return finish(ok,"PoolReader checks failed");
+
+}
@@ -0,0 +1,49 @@
+#include <iostream>
+#include <fstream>
+
+#include "json.hh"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    
+    ifstream file;
+    file.open(argv[1]);
+    json::Reader reader(file);
+    
+    json::Writer writer(cout);
+    try {
+		json::Value value;
+		while (reader.getValue(value)) {
+			if (value.getType() != json::TARRAY) continue;
+			writer.putValue(value);
+			vector<size_t> shape = value.shape();
+			cout << "shape";
+			for (size_t i = 0; i < shape.size(); i++) cout << ' ' << shape[i];
+			cout << '\n';
+			// last element by multi-dimensional index
+			vector<size_t> last(shape.size());
+			for (size_t i = 0; i < shape.size(); i++) last[i] = shape[i]-1;
+			try {
+				cout << "last element ";
+				writer.putValue(value.getElement(last));
+				cout << "last row ";
+				writer.putValue(value.getElement(shape[0]-1));
+			} catch (runtime_error &e) {
+				cout << e.what() << '\n';
+			}
+			// reads through a const Value leave the packed numbers in place
+			const json::Value &readonly = value;
+			cout << "first element ";
+			writer.putValue(readonly[0]);
+			cout << "shape after reading " << readonly.shape().size() << " dimensions\n";
+			// reference access expands the packed numbers in place
+			value[0] = value.getElement(0);
+			cout << "after expanding ";
+			writer.putValue(value);
+		}
+	} catch (json::parser_error &e) {
+		cout << "ERROR: " << e.what() << '\n';
+	}
+
+}
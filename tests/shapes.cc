@@ -0,0 +1,147 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <atomic>
+
+#include "json.hh"
+#include "frozen.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks that objects of arrays read with the same keys share them and behave like any other objects, counts the
+// heap allocations of reading a large table of records, and times it against reading the records one by one
+//     shapes [records]
+
+typedef chrono::steady_clock Clock;
+
+static atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+	allocations++;
+	void *memory = malloc(size ? size : 1);
+	if (!memory) throw bad_alloc();
+	return memory;
+}
+
+void operator delete(void *memory) noexcept {
+	free(memory);
+}
+
+json::Value parse(const string &text) {
+	json::Reader reader(text);
+	json::Value value;
+	reader.getValue(value);
+	return value;
+}
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+double since(Clock::time_point start) {
+	return chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+}
+
+string record(size_t i) {
+	return "{\"channel\": " + to_string(i % 32) + ", \"card\": " + to_string(i % 16) + ", \"crate\": " + to_string(i % 19)
+		+ ", \"pedestal_mean\": " + to_string(i % 100) + ".5, \"pedestal_sigma\": 1.25, \"threshold_adc\": " + to_string(i % 7)
+		+ ", \"enabled\": true, \"comment\": \"pmt" + to_string(i) + "\"}";
+}
+
+int main(int argc, char **argv) {
+
+	const size_t nrecords = argc > 1 ? atoi(argv[1]) : 200000;
+	bool ok = true;
+
+	json::Value rows = parse("[{\"x\": 1, \"y\": 2.5, \"name\": \"a\"}, {\"name\": \"b\", \"x\": 3, \"y\": 4}, {x: 5}, 7]");
+	json::Value same(json::TOBJECT);
+	same.setMember("x",json::Value(3));
+	same.setMember("y",json::Value(4));
+	same.setMember("name",json::Value(string("b")));
+	ok = check("members are found through the shared keys", rows[0]["x"].getInteger() == 1 && rows[1]["name"].getString() == "b"
+		&& rows[1]["y"].getInteger() == 4 && rows[2]["x"].getInteger() == 5 && rows[3].getInteger() == 7) && ok;
+	ok = check("keys in key order", rows[0].getMembers() == vector<string>({ "name", "x", "y" }) && rows[2].getMembers() == vector<string>({ "x" })
+		&& rows[1].isMember("y") && !rows[1].isMember("z") && !rows[1].isMember("")) && ok;
+	ok = check("written as before", written(rows[1]) == written(same)) && ok;
+	json::Value duplicates = parse("[{\"a\": 1, \"b\": 0, \"a\": 2}, {\"a\": 3, \"b\": 0, \"a\": 4}]");
+	ok = check("later duplicate keys replace earlier ones", duplicates[0]["a"].getInteger() == 2 && duplicates[1]["a"].getInteger() == 4
+		&& duplicates[1].getMembers().size() == 2) && ok;
+
+	json::Value first = rows[0];
+	rows[0].setMember("y",json::Value(9));
+	json::Value &x = rows[0]["x"];
+	x = json::Value(10);
+	ok = check("setting members in place", first["y"].getInteger() == 9 && first["x"].getInteger() == 10 && rows[1]["x"].getInteger() == 3) && ok;
+	rows[0]["z"] = json::Value(11);
+	rows[1].setMember("w",1,json::Value(12));
+	ok = check("adding members makes ordinary objects", first.getMembers() == vector<string>({ "name", "x", "y", "z" })
+		&& first["x"].getInteger() == 10 && rows[1]["w"].getInteger() == 12 && rows[1]["x"].getInteger() == 3
+		&& rows[2].getMembers().size() == 1 && written(rows[1]) != written(same)) && ok;
+
+	json::Value table = parse("[" + record(0) + ", " + record(1) + ", " + record(2) + ", " + record(32) + "]");
+	json::Frozen frozen(table);
+	ok = check("indexes and frozen copies", table.findElements("channel",json::Value(0)) == vector<size_t>({ 0, 3 })
+		&& frozen.root().getIndex(2).getMember("comment").getString() == "pmt2" && frozen.root().getIndex(3).getMemberCount() == 8
+		&& written(frozen.root().thaw()) == written(table)) && ok;
+
+	// distinct records sharing keys are changed and dropped on several threads at once
+	string many = "[";
+	for (size_t i = 0; i < 4000; i++) many += (i ? ", " : "") + record(i);
+	json::Value shared = parse(many + "]");
+	vector<thread> threads;
+	for (size_t t = 0; t < 4; t++) {
+		threads.push_back(thread([&shared,t]() {
+			for (size_t i = t; i < 4000; i += 4) {
+				json::Value &row = shared[i];
+				if (i % 8 < 4) row["extra"] = json::Value((int)i);
+				else row = json::Value(string("dropped"));
+			}
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+	bool changed = true;
+	for (size_t i = 0; i < 4000; i++) {
+		changed = changed && (i % 8 < 4 ? shared[i]["extra"].getInteger() == (int)i && shared[i]["crate"].getInteger() == (int)(i % 19)
+			: shared[i].getString() == "dropped");
+	}
+	ok = check("records changed on several threads", changed) && ok;
+
+	// a large table of records, and the same records one per line (which do not share keys)
+	string text = "[", lines;
+	for (size_t i = 0; i < nrecords; i++) {
+		text += (i ? ",\n" : "") + record(i);
+		lines += record(i) + "\n";
+	}
+	text += "]";
+	json::Reader reader(text);
+	json::Value large;
+	size_t before = allocations;
+	Clock::time_point start = Clock::now();
+	reader.getValue(large);
+	const double sharedTime = since(start);
+	const size_t sharedAllocations = allocations - before;
+	json::Reader lineReader(lines);
+	vector<json::Value> records(nrecords);
+	before = allocations;
+	start = Clock::now();
+	for (size_t i = 0; i < nrecords; i++) lineReader.getValue(records[i]);
+	const double mapTime = since(start);
+	const size_t mapAllocations = allocations - before - 1;
+	bool agree = large.getArraySize() == nrecords;
+	for (size_t i = 0; agree && i < nrecords; i += 997) {
+		agree = written(large.getElement(i)) == written(records[i]) && large[i]["comment"].getString() == "pmt" + to_string(i);
+	}
+	ok = check("the table is read with shared keys", agree && sharedAllocations < mapAllocations/2) && ok;
+	cout << nrecords << " records: read with shared keys in " << sharedTime*1e3 << " ms with " << sharedAllocations << " allocations, as maps in "
+	     << mapTime*1e3 << " ms with " << mapAllocations << " allocations\n";
+
+	return finish(ok,"shape checks failed");
+
+}
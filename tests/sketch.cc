@@ -0,0 +1,123 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include "sketch.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks distinct counts, quantiles and frequent values of fields of generated records against exact answers,
+// checks that statistics of parts of a stream read on several threads merge into those of the whole, and times
+// the sketches against reading every record into a Value
+//     sketch [records]
+
+typedef chrono::steady_clock Clock;
+
+string record(size_t i) {
+	stringstream text;
+	// users: u0 in 3 of 10 records, u1 in 2 of 10, the rest spread over 500 others
+	const size_t user = i % 10 < 3 ? 0 : i % 10 < 5 ? 1 : 2 + (i/10*7919) % 500;
+	text << "{\"id\":" << i << ",\"user\":\"u" << user << "\",\"latency\":" << (i*7) % 1000 + 0.5
+	     << ",\"tags\":[\"a\",\"b\"],\"detector\":{\"crate\":" << i % 19 << "}";
+	if (i % 4 == 0) text << ",\"error\":" << (i % 8 == 0 ? "true" : "null");
+	text << "}\n";
+	return text.str();
+}
+
+int main(int argc, char **argv) {
+
+	const size_t records = argc > 1 ? atoi(argv[1]) : 200000;
+	bool ok = true;
+
+	string text;
+	for (size_t i = 0; i < records; i++) text += record(i);
+	const vector<string> paths = { "id", "user", "latency", "tags", "detector.crate", "error", "missing" };
+
+	Clock::time_point start = Clock::now();
+	json::FieldStatistics whole(paths);
+	istringstream in(text);
+	whole.add(in);
+	const double sketchTime = chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+
+	const json::FieldSketch &id = whole.getField(0), &user = whole.getField(1), &latency = whole.getField(2);
+	ok = check("records and values", whole.getRecords() == records && id.records == records && whole.getField(3).values == 2*records
+		&& whole.getField(5).records == records/4 && whole.getField(6).records == 0) && ok;
+	ok = check("distinct counts within 5%", fabs(id.distinct.estimate()/records - 1) < 0.05 && fabs(user.distinct.estimate()/502 - 1) < 0.05
+		&& fabs(whole.getField(4).distinct.estimate() - 19) < 1 && fabs(whole.getField(3).distinct.estimate() - 2) < 0.5) && ok;
+	bool quantiles = latency.quantiles.getMin() == 0.5 && latency.quantiles.getMax() == 999.5;
+	for (double q = 0.1; q < 1; q += 0.1) quantiles = quantiles && fabs(latency.quantiles.quantile(q) - 1000*q) < 15;
+	ok = check("quantiles within 1.5% of rank", quantiles) && ok;
+	vector<pair<string,uint64_t> > top = user.frequent.top(2);
+	ok = check("most frequent users", top.size() == 2 && top[0].first == "\"u0\"" && top[1].first == "\"u1\""
+		&& top[0].second >= 3*records/10 && top[0].second <= 3*records/10 + records/64) && ok;
+
+	// four parts read on their own threads
+	vector<json::FieldStatistics> parts(4,json::FieldStatistics(paths));
+	vector<thread> threads;
+	for (size_t p = 0; p < parts.size(); p++) {
+		threads.push_back(thread([&,p]() {
+			string part;
+			for (size_t i = p*records/4; i < (p+1)*records/4; i++) part += record(i);
+			istringstream partIn(part);
+			parts[p].add(partIn);
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+	json::FieldStatistics merged(paths);
+	for (size_t p = 0; p < parts.size(); p++) merged.merge(parts[p]);
+	ok = check("merged parts match the whole stream", merged.getRecords() == records && merged.getField(0).distinct.estimate() == id.distinct.estimate()
+		&& merged.getField(1).frequent.top(1)[0].first == "\"u0\"" && fabs(merged.getField(2).quantiles.quantile(0.5) - 500) < 15) && ok;
+
+	json::FieldStatistics ratdb(vector<string>({ "v", "w[1]" }));
+	istringstream repeated("{ v: [1.5 : 3, 2, 4 : 0], w: [0x10, 7u, 3d2] }\n{ v: 2.5 }");
+	ratdb.add(repeated);
+	json::Value summary = ratdb.summary();
+	ok = check("RATDB repetitions and numbers", ratdb.getField(0).values == 5 && ratdb.getField(0).quantiles.getMax() == 2.5
+		&& ratdb.getField(1).quantiles.getMin() == 7 && summary["v"]["top"][0]["value"].getReal() == 1.5
+		&& summary["v"]["top"][0]["count"].getUInteger() == 3 && summary["v"]["records"].getUInteger() == 2) && ok;
+
+	// a repetition is one weighted insert, however many times it repeats
+	json::FieldStatistics huge(vector<string>({ "v" }));
+	istringstream repeats("{ v: [0 : 4000000000, 1, 2 : 1000000000] }");
+	huge.add(repeats);
+	const json::QuantileSketch &weighted = huge.getField(0).quantiles;
+	ok = check("huge repetitions are weighted inserts", weighted.getCount() == 5000000001ull
+		&& weighted.quantile(0.5) == 0 && weighted.quantile(0.9) == 2 && weighted.getMax() == 2) && ok;
+	json::QuantileSketch once, each;
+	for (int x = 0; x < 1000; x++) {
+		once.add(x,x % 50 + 1);
+		for (int i = 0; i <= x % 50; i++) each.add(x);
+	}
+	ok = check("weighted inserts match repeated ones", once.getCount() == each.getCount()
+		&& fabs(once.quantile(0.25) - each.quantile(0.25)) < 30 && fabs(once.quantile(0.75) - each.quantile(0.75)) < 30) && ok;
+
+	// the same statistics exactly, reading every record into a Value
+	start = Clock::now();
+	json::Reader reader(text);
+	json::Value value;
+	set<json::TInteger> ids;
+	map<string,size_t> users;
+	vector<double> latencies;
+	const json::Path idPath("id"), userPath("user"), latencyPath("latency");
+	while (reader.getValue(value)) {
+		ids.insert(idPath.get(value).getInteger());
+		users[userPath.get(value).getString()]++;
+		latencies.push_back(latencyPath.get(value).getReal());
+	}
+	sort(latencies.begin(),latencies.end());
+	const double exactTime = chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+	ok = check("exact answers agree", ids.size() == records && users.size() == 502 && users["u0"] <= top[0].second
+		&& fabs(latencies[latencies.size()/2] - latency.quantiles.quantile(0.5)) < 15) && ok;
+	cout << text.size()/1e6 << " MB of " << records << " records, " << paths.size() << " fields: sketches " << text.size()/sketchTime/1e6
+	     << " MB/s, Values with exact statistics of 3 fields " << text.size()/exactTime/1e6 << " MB/s\n";
+
+	return finish(ok,"sketch checks failed");
+
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <fstream>
+
+#include "json.hh"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    
+    ifstream file;
+    file.open(argv[1]);
+    json::Reader reader(file);
+    
+    json::Writer writer(cout);
+
+    // slices past the end of an empty array are errors
+    try {
+		json::Value(json::TARRAY).slice(1,0,2);
+		cout << "FAIL slicing [1,0) of an empty array did not throw\n";
+		return 1;
+	} catch (runtime_error &e) {
+		cout << "slicing [1,0) of an empty array: " << e.what() << '\n';
+	}
+
+    // views of elements their parent no longer has are errors
+    {
+		json::Value parent(json::TARRAY);
+		parent.setArraySize(10);
+		json::Value view = parent.slice(5,10);
+		parent.setArraySize(2);
+		size_t threw = 0;
+		try {
+			view.setIndex(4,json::Value(1));
+		} catch (runtime_error &e) {
+			threw++;
+		}
+		try {
+			view.getArraySize();
+		} catch (runtime_error &e) {
+			threw++;
+		}
+		try {
+			view.getElement(0);
+		} catch (runtime_error &e) {
+			cout << "reading a view past its shrunk parent: " << e.what() << '\n';
+			threw++;
+		}
+		if (threw != 3) {
+			cout << "FAIL a view past its shrunk parent was used\n";
+			return 1;
+		}
+		parent.setArraySize(10);
+		view.setIndex(4,json::Value(1));
+		cout << "view of a regrown parent: ";
+		writer.putValue(parent);
+	}
+
+    try {
+		json::Value value;
+		while (reader.getValue(value)) {
+			if (value.getType() != json::TARRAY) continue;
+			const size_t size = value.getArraySize();
+			cout << "slicing ";
+			writer.putValue(value);
+			json::Value tail = value.slice(size/2,size);
+			cout << "second half: ";
+			writer.putValue(tail);
+			if (size < 2) continue; //no odd indices to slice or write through
+			json::Value odd = value.slice(1,size,2);
+			cout << "odd indices: ";
+			writer.putValue(odd);
+			cout << "odd of second half: ";
+			writer.putValue(tail.slice(1,tail.getArraySize(),2));
+			try {
+				vector<double> arr = odd.toVector<double>();
+				cout << "odd as double[]: ";
+				writer.putValue(json::Value(arr));
+				cout << "sum of odd: " << odd.sum() << '\n';
+			} catch (runtime_error &e) {
+				cout << e.what() << '\n';
+			}
+			odd.setIndex(0,json::Value(string("written through")));
+			cout << "after writing through: ";
+			writer.putValue(value);
+			odd.setArraySize(1);
+			odd.setIndex(0,json::Value(string("detached")));
+			cout << "after detaching: ";
+			writer.putValue(value);
+			writer.putValue(odd);
+		}
+	} catch (json::parser_error &e) {
+		cout << "ERROR: " << e.what() << '\n';
+	}
+
+}
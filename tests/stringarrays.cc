@@ -0,0 +1,115 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "json.hh"
+#include "frozen.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks that arrays of strings read into one character buffer behave like arrays of Values, counts the heap
+// allocations of reading a large one, and times reading it packed against expanding it into Values
+//     stringarrays [strings]
+
+typedef chrono::steady_clock Clock;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+	allocations++;
+	void *memory = malloc(size ? size : 1);
+	if (!memory) throw bad_alloc();
+	return memory;
+}
+
+void operator delete(void *memory) noexcept {
+	free(memory);
+}
+
+json::Value parse(const string &text) {
+	json::Reader reader(text);
+	json::Value value;
+	reader.getValue(value);
+	return value;
+}
+
+string written(const json::Value &value) {
+	stringstream out;
+	json::Writer writer(out);
+	writer.putValue(value);
+	return out.str();
+}
+
+double since(Clock::time_point start) {
+	return chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+}
+
+int main(int argc, char **argv) {
+
+	const size_t nstrings = argc > 1 ? atoi(argv[1]) : 1000000;
+	bool ok = true;
+
+	json::Value names = parse("[\"north\", \"south\", \"a\\\"b\\tA\", \"\"]");
+	size_t length;
+	const char *chars = names.getChars(2,length);
+	ok = check("strings are read as they were", names.getArraySize() == 4 && names.shape() == vector<size_t>(1,4)
+		&& names.getElement(2).getString() == "a\"b\tA" && names.getElement(3).getString() == ""
+		&& names.toVector<string>() == vector<string>({ "north", "south", "a\"b\tA", "" })) && ok;
+	ok = check("borrowed characters are NUL terminated", length == 5 && !strcmp(chars,"a\"b\tA")
+		&& !strcmp(names.getChars(0,length),"north") && length == 5) && ok;
+	ok = check("written as before", written(names) == "[\"north\", \"south\", \"a\\\"b\\tA\", \"\"]\n") && ok;
+
+	ok = check("repetitions", parse("[\"x\" : 3, \"y\", \"z\" : 0]").toVector<string>() == vector<string>({ "x", "x", "x", "y" })
+		&& parse("[\"z\" : 0]").getArraySize() == 0 && parse("[\"z\" : 0, \"w\"]").getElement(0).getString() == "w") && ok;
+	json::Value mixed = parse("[\"a\", \"b\", 1, \"c\"]");
+	ok = check("mixed arrays hold Values", mixed.getArraySize() == 4 && mixed.getElement(1).getString() == "b"
+		&& mixed.getElement(2).getInteger() == 1 && !strcmp(mixed.getChars(3,length),"c")) && ok;
+	json::Value table = parse("[[\"a\", \"bb\"], [\"ccc\", \"\"], [\"e\", \"f\"]]");
+	ok = check("nested arrays of strings are packed together", table.shape() == vector<size_t>({ 3, 2 })
+		&& table.getElement(vector<size_t>({ 1, 0 })).getString() == "ccc" && table.getElement(2).getElement(1).getString() == "f"
+		&& table.getElement(1).getChars(1,length) && length == 0 && written(table) == "[[\"a\", \"bb\"], [\"ccc\", \"\"], [\"e\", \"f\"]]\n") && ok;
+
+	json::Value copy = names;
+	names[1].setString("east");
+	ok = check("getIndex and setters expand the strings", names[1].getString() == "east" && copy.getElement(1).getString() == "east"
+		&& names.getElement(0).getString() == "north" && !strcmp(names.getChars(1,length),"east")) && ok;
+	bool threw = false;
+	try {
+		parse("[\"1\", \"2\"]").sum();
+	} catch (runtime_error &e) {
+		threw = true;
+	}
+	ok = check("strings are not numbers", threw) && ok;
+	json::Frozen frozen(table);
+	json::Value slice = parse("[\"a\", \"b\", \"c\", \"d\"]").slice(1,4,2);
+	ok = check("frozen and sliced", frozen.root().getIndex(1).getIndex(0).getString() == "ccc" && slice.toVector<string>() == vector<string>({ "b", "d" })
+		&& !strcmp(slice.getChars(1,length),"d")) && ok;
+
+	// a large array of channel names
+	string text = "[";
+	for (size_t i = 0; i < nstrings; i++) text += (i ? ", \"crate" : "\"crate") + to_string(i % 19) + "_card" + to_string(i % 16) + "_channel" + to_string(i % 32) + "\"";
+	text += "]";
+	json::Reader reader(text);
+	json::Value large;
+	const size_t before = allocations;
+	Clock::time_point start = Clock::now();
+	reader.getValue(large);
+	const double packedTime = since(start);
+	const size_t packedAllocations = allocations - before;
+	ok = check("a large array is read with a few allocations", large.getArraySize() == nstrings && packedAllocations < 100
+		&& large.getElement(nstrings-1).getString() == "crate" + to_string((nstrings-1) % 19) + "_card" + to_string((nstrings-1) % 16)
+			+ "_channel" + to_string((nstrings-1) % 32)) && ok;
+	const size_t expandBefore = allocations;
+	start = Clock::now();
+	large.getIndex(0);
+	const double expandTime = since(start);
+	cout << nstrings << " strings: read packed in " << packedTime*1e3 << " ms with " << packedAllocations << " allocations, expanded into Values in "
+	     << expandTime*1e3 << " ms with " << allocations - expandBefore << " allocations\n";
+
+	return finish(ok,"string array checks failed");
+
+}
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+#include "json.hh"
+
+using namespace std;
+
+// Throughput of lookups, copies, iteration and parsing on 1..N threads that either share one document or each
+// parse their own. Copies of a shared document update shared reference counts, so they need a build with
+// -DJSON_ATOMIC_REFCOUNT, and the shared/private ratio shows the cost of contention on those cache lines.
+//     threadbench [max threads] [milliseconds per measurement]
+
+typedef chrono::steady_clock Clock;
+
+const size_t NCHANNELS = 1000, NSAMPLES = 4096;
+
+string document() {
+	stringstream text;
+	text << "{\nname: \"threadbench\",\nchannels: [\n";
+	for (size_t i = 0; i < NCHANNELS; i++) {
+		text << (i ? ",\n" : "") << "{ id: " << i << ", gain: " << 1.0 + i*1e-3 << ", position: [" << i << ".5, 2.5, 3.5] }";
+	}
+	text << "],\nsamples: [";
+	for (size_t i = 0; i < NSAMPLES; i++) text << (i ? ", " : "") << i*0.25 + 0.125;
+	text << "]\n}\n";
+	return text.str();
+}
+
+json::Value parse(const string &text) {
+	json::Reader reader(text);
+	json::Value value;
+	reader.getValue(value);
+	return value;
+}
+
+// One unit of each kind of work, returning something to keep the compiler honest
+double lookupGain(json::Value &doc, size_t i) {
+	return doc["channels"][i % NCHANNELS]["gain"].cast<double>();
+}
+
+double copyChannel(json::Value &doc, size_t i) {
+	const json::Value channel = doc["channels"][i % NCHANNELS];
+	return channel.getType();
+}
+
+double sumSamples(json::Value &doc, size_t) {
+	const json::Value &samples = doc["samples"];
+	double sum = 0;
+	for (size_t i = 0; i < NSAMPLES; i++) sum += samples[i].getReal();
+	return sum;
+}
+
+double parseText(const string &text) {
+	return parse(text)["channels"].getArraySize();
+}
+
+// Runs work on nthreads threads for about ms milliseconds and returns operations per second
+template <typename Work> double measure(unsigned int nthreads, unsigned int ms, Work work) {
+	atomic<bool> stop(false);
+	atomic<unsigned int> ready(0);
+	atomic<size_t> total(0);
+	vector<thread> threads;
+	for (unsigned int t = 0; t < nthreads; t++) {
+		threads.push_back(thread([&stop,&ready,&total,&work,t]() {
+			size_t ops = 0;
+			double sink = 0;
+			ready++;
+			while (!stop) sink += work(t,ops++);
+			total += ops + (sink == -1);
+		}));
+	}
+	while (ready < nthreads) this_thread::yield();
+	const Clock::time_point start = Clock::now();
+	this_thread::sleep_for(chrono::milliseconds(ms));
+	stop = true;
+	for (unsigned int t = 0; t < nthreads; t++) threads[t].join();
+	return total / chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+}
+
+struct Curve {
+	string name;
+	vector<double> rate;
+};
+
+void report(const Curve &curve, const vector<unsigned int> &counts) {
+	const bool millions = curve.rate[0] > 1e6;
+	for (size_t i = 0; i < counts.size(); i++) {
+		cout << setw(16) << left << curve.name << right << setw(4) << counts[i] << " threads " << setw(10) << fixed << setprecision(3)
+		     << curve.rate[i]/(millions ? 1e6 : 1e3) << (millions ? " Mops/s" : " kops/s") << "  speedup " << setprecision(2)
+		     << curve.rate[i]/curve.rate[0] << '\n';
+	}
+}
+
+int main(int argc, char **argv) {
+
+	const unsigned int maxthreads = argc > 1 ? atoi(argv[1]) : max(thread::hardware_concurrency(),4u);
+	const unsigned int ms = argc > 2 ? atoi(argv[2]) : 100;
+	vector<unsigned int> counts;
+	for (unsigned int n = 1; n < maxthreads; n *= 2) counts.push_back(n);
+	counts.push_back(maxthreads);
+
+	const string text = document();
+	json::Value shared = parse(text);
+	vector<json::Value> own(maxthreads);
+	for (unsigned int t = 0; t < maxthreads; t++) own[t] = parse(text);
+
+	// iteration indexes the samples through a const Value, which reads the packed numbers in place
+	double (*ops[])(json::Value&,size_t) = { lookupGain, copyChannel, sumSamples };
+	const char *names[] = { "lookup", "copy", "iterate" };
+	vector<Curve> curves;
+	for (int op = 0; op < 3; op++) {
+		Curve mine = { string(names[op]) + "/private", vector<double>() };
+		Curve ours = { string(names[op]) + "/shared", vector<double>() };
+		double (*work)(json::Value&,size_t) = ops[op];
+		for (size_t i = 0; i < counts.size(); i++) {
+			mine.rate.push_back(measure(counts[i],ms,[&own,work](unsigned int t, size_t n) { return work(own[t],n); }));
+#ifndef JSON_ATOMIC_REFCOUNT
+			if (work == copyChannel) continue;
+#endif
+			ours.rate.push_back(measure(counts[i],ms,[&shared,work](unsigned int, size_t n) { return work(shared,n); }));
+		}
+		curves.push_back(mine);
+		if (!ours.rate.empty()) curves.push_back(ours);
+	}
+	Curve parsing = { "parse", vector<double>() };
+	for (size_t i = 0; i < counts.size(); i++) {
+		parsing.rate.push_back(measure(counts[i],ms,[&text](unsigned int, size_t) { return parseText(text); }));
+	}
+	curves.push_back(parsing);
+
+	for (size_t c = 0; c < curves.size(); c++) report(curves[c],counts);
+
+	// contention: how much slower the shared document is than private ones at the most threads
+	cout << "\nshared/private throughput at " << maxthreads << " threads:\n";
+	for (size_t c = 0; c + 1 < curves.size(); c++) {
+		const string &name = curves[c].name;
+		if (name.find("/private") == string::npos || curves[c+1].name.find("/shared") == string::npos) continue;
+		cout << "    " << name.substr(0,name.find('/')) << ": " << setprecision(2) << curves[c+1].rate.back()/curves[c].rate.back() << '\n';
+	}
+#ifndef JSON_ATOMIC_REFCOUNT
+	cout << "    copy: not measured, shared copies need -DJSON_ATOMIC_REFCOUNT\n";
+#endif
+
+}
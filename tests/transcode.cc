@@ -0,0 +1,117 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+
+#include "transcoder.hh"
+#include "check.hh"
+
+using namespace std;
+
+// Checks that streaming transcoding gives the same Values as Reader in every output style, and compares its
+// speed with a Reader and Writer pass and with copying the text
+//     transcode [files...]
+
+typedef chrono::steady_clock Clock;
+
+string transcoded(const string &text, bool strict, bool expand, unsigned int indent) {
+	json::TranscodeOptions options;
+	options.strict = strict;
+	options.expand = expand;
+	options.indent = indent;
+	istringstream in(text);
+	ostringstream out;
+	{
+		json::Transcoder transcoder(in,out,options);
+		transcoder.transcode();
+	}
+	return out.str();
+}
+
+// Every value of a text as Writer would print it
+string values(const string &text) {
+	json::Reader reader(text);
+	json::Value value;
+	ostringstream out;
+	json::Writer writer(out);
+	while (reader.getValue(value)) writer.putValue(value);
+	return out.str();
+}
+
+bool sameValues(const string &what, const string &text) {
+	const string expected = values(text);
+	bool ok = true;
+	const char *styles[] = { "strict pretty", "strict minified", "ratdb pretty", "ratdb minified", "ratdb expanded" };
+	for (int s = 0; s < 5; s++) {
+		const string result = transcoded(text,s < 2,s == 4,s % 2 ? 0 : 4);
+		ok &= check(what + " " + styles[s],values(result) == expected);
+	}
+	return ok;
+}
+
+double seconds(const Clock::time_point &start) {
+	return chrono::duration_cast<chrono::duration<double> >(Clock::now()-start).count();
+}
+
+int main(int argc, char **argv) {
+
+	bool ok = true;
+	for (int i = 1; i < argc; i++) {
+		ifstream file(argv[i]);
+		stringstream contents;
+		contents << file.rdbuf();
+		ok &= sameValues(argv[i],contents.str());
+	}
+
+	ok &= sameValues("dialect","{ a: 0x10, b: 5u, c: 2d3, d: 3f, e: +.5, f: [1 : 3, {x: [0 : 2]} : 2], \"g h\": \"tab\\tline\" } // end\n");
+	ok &= check("strict numbers",transcoded("[0x10, 5u, 2d3, 3f, +.5, -0.25, 1e3]",true,false,0) == "[16,5,2000.0,3.0,0.5,-0.25,1e3]\n");
+	ok &= check("strict keys",transcoded("{ bare: 1, \"quoted\": 2 }",true,false,0) == "{\"bare\":1,\"quoted\":2}\n");
+	ok &= check("preserved repetition",transcoded("[1.5 : 3]",false,false,0) == "[1.5:3]\n");
+	ok &= check("removed by repetition",transcoded("[1, 2 : 0, 3]",true,false,0) == "[1,3]\n");
+
+	bool threw = false;
+	try {
+		transcoded("[\"" + string(json::Transcoder::REPEAT_BYTES*2,'x') + "\" : 2]",true,false,0);
+	} catch (json::parser_error &e) {
+		threw = true;
+	}
+	ok &= check("repeated value too large",threw);
+
+	// a document much larger than a chunk, with tokens across chunk boundaries
+	stringstream generated;
+	for (int t = 0; t < 2000; t++) {
+		generated << "// table " << t << "\n{\n    name: \"TABLE\", index: \"t" << t << "\", run_range: [0, 100000],\n"
+		          << "    gains: [";
+		for (int i = 0; i < 100; i++) generated << (i ? ", " : "") << 1.0 + i*1e-3 + t;
+		generated << "],\n    flags: [0 : 64], mask: 0xff" << t % 10 << ", /* note */ comment: \"line\\n" << t << "\"\n}\n";
+	}
+	const string text = generated.str();
+	ok &= sameValues("generated",text);
+
+	const int passes = 5;
+	Clock::time_point start = Clock::now();
+	for (int p = 0; p < passes; p++) transcoded(text,true,false,0);
+	const double transcoding = seconds(start)/passes;
+	start = Clock::now();
+	for (int p = 0; p < passes; p++) {
+		json::Reader reader(text);
+		json::Value value;
+		ostringstream out;
+		json::Writer writer(out);
+		while (reader.getValue(value)) writer.putValue(value);
+	}
+	const double dom = seconds(start)/passes;
+	start = Clock::now();
+	for (int p = 0; p < passes; p++) {
+		istringstream in(text);
+		ostringstream out;
+		out << in.rdbuf();
+	}
+	const double copying = seconds(start)/passes;
+	const double mb = text.size()/1e6;
+	cout << "\n" << mb << " MB: transcoder " << mb/transcoding << " MB/s, Reader+Writer " << mb/dom << " MB/s, stream copy " << mb/copying << " MB/s\n";
+
+	return finish(ok,"transcoder checks failed");
+
+}
@@ -0,0 +1,343 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tokenizer.hh"
+
+#include <cstring>
+
+namespace json {
+
+    //Characters that may continue a number (a superset, checked when the number is converted)
+    class NumberChars {
+        public:
+            NumberChars() {
+                memset(table,0,sizeof(table));
+                for (int c = '0'; c <= '9'; c++) table[c] = true;
+                for (int c = 'a'; c <= 'z'; c++) table[c] = table[c-'a'+'A'] = true;
+                table['.'] = table['+'] = table['-'] = true;
+            }
+            bool table[256];
+    };
+    static const NumberChars numberChars;
+
+    static inline bool isNumberChar(char c) {
+        return numberChars.table[(unsigned char)c];
+    }
+
+    Tokenizer::Tokenizer(std::istream &in_) : in(in_), buffer(CHUNK+1), pos(0), limit(0), mark(0), marking(false), lastbr(0), line(1), expectKey(false) {
+        buffer[0] = '\0';
+        token.type = TOKEN_END;
+        token.text = NULL;
+        token.length = 0;
+        token.quoted = false;
+    }
+
+    void Tokenizer::fail(const char *desc) const {
+        throw parser_error(line,getColumn(),desc);
+    }
+
+    size_t Tokenizer::refill(size_t &start) {
+        const bool aliased = &start == &pos;
+        const size_t shift = marking && mark < start ? mark : start, keep = limit - shift;
+        memmove(&buffer[0],&buffer[shift],keep);
+        pos -= shift;
+        if (!aliased) start -= shift;
+        if (marking) mark -= shift;
+        lastbr -= (long)shift;
+        limit = keep;
+        if (buffer.size() < limit + CHUNK + 1) buffer.resize(limit + CHUNK + 1);
+        in.read(&buffer[limit],CHUNK);
+        const size_t got = in.gcount();
+        limit += got;
+        buffer[limit] = '\0';
+        return got;
+    }
+
+    bool Tokenizer::ensure(size_t n) {
+        if (limit - pos >= n) return true;
+        size_t start = pos;
+        while (limit - pos < n && refill(start)) { }
+        return limit - pos >= n;
+    }
+
+    bool Tokenizer::nextRecord(std::string &text) {
+        if (!stack.empty()) fail("Records are only read at the top level");
+        skip(false);
+        marking = true;
+        mark = pos;
+        try {
+            if (next().type == TOKEN_END) {
+                marking = false;
+                return false;
+            }
+            while (!stack.empty()) next();
+        } catch (...) {
+            marking = false;
+            throw;
+        }
+        text.assign(&buffer[mark],pos-mark);
+        marking = false;
+        return true;
+    }
+
+    void Tokenizer::skip(bool commas) {
+        for (;;) {
+            switch (buffer[pos]) {
+                case '\n':
+                    line++;
+                    lastbr = pos+1;
+                    pos++;
+                    break;
+                case '\r':
+                    lastbr = pos+1;
+                case ' ':
+                case '\t':
+                    pos++;
+                    break;
+                case ',':
+                    if (!commas) return;
+                    pos++;
+                    break;
+                case '/': //non-json comment
+                    if (!ensure(2)) fail("Malformed comment");
+                    if (buffer[pos+1] == '/') {
+                        pos += 2;
+                        while (buffer[pos] != '\n') {
+                            if (buffer[pos] != '\0') {
+                                pos++;
+                            } else if (pos < limit || !refill(pos)) {
+                                return;
+                            }
+                        }
+                    } else if (buffer[pos+1] == '*') {
+                        pos += 2;
+                        for (;;) {
+                            const char c = buffer[pos];
+                            if (c == '\0') {
+                                if (pos < limit || !refill(pos)) fail("Malformed comment");
+                                continue;
+                            }
+                            if (c == '\n') {
+                                line++;
+                                lastbr = pos+1;
+                            } else if (c == '*') {
+                                if (!ensure(2)) fail("Malformed comment");
+                                if (buffer[pos+1] == '/') break;
+                            }
+                            pos++;
+                        }
+                        pos += 2;
+                    } else {
+                        fail("Malformed comment");
+                    }
+                    break;
+                case '\0':
+                    if (pos < limit || !refill(pos)) return;
+                    break;
+                default:
+                    return;
+            }
+        }
+    }
+
+    void Tokenizer::scanNumber(size_t start) {
+        for (;;) {
+            while (isNumberChar(buffer[pos])) pos++;
+            if (pos < limit || !refill(start)) break;
+        }
+        token.text = &buffer[start];
+        token.length = pos - start;
+    }
+
+    void Tokenizer::scanString() {
+        size_t start = ++pos;
+        for (;;) {
+            switch (buffer[pos]) {
+                case '"':
+                    token.text = &buffer[start];
+                    token.length = pos - start;
+                    pos++;
+                    return;
+                case '\\':
+                    pos++; //definitely an escape, so skip next character
+                    if (pos == limit && !refill(start)) fail("Reached EOF while parsing string");
+                    pos++;
+                    break;
+                case '\n':
+                    line++;
+                    lastbr = pos+1;
+                    pos++;
+                    break;
+                case '\0':
+                    if (pos < limit || !refill(start)) fail("Reached EOF while parsing string");
+                    break;
+                default:
+                    pos++;
+            }
+        }
+    }
+
+    void Tokenizer::scanKey() {
+        size_t start = pos;
+        for (;;) {
+            switch (buffer[pos]) {
+                case ' ':
+                case '\t':
+                case '\r':
+                case '\n':
+                case ':':
+                case ',':
+                case '/':
+                case '{':
+                case '}':
+                case '[':
+                case ']':
+                case '"':
+                    token.text = &buffer[start];
+                    token.length = pos - start;
+                    return;
+                case '\0':
+                    if (pos < limit || !refill(start)) fail("Reached EOF while parsing object");
+                    break;
+                default:
+                    pos++;
+            }
+        }
+    }
+
+    const Token& Tokenizer::next() {
+        token.text = NULL;
+        token.length = 0;
+        token.quoted = false;
+        const char context = stack.empty() ? '\0' : stack.back();
+        skip(context != '\0');
+        const char c = buffer[pos];
+        if (c == '\0') {
+            if (context == '{') fail("Reached EOF while parsing object");
+            if (context == '[') fail("Reached EOF while parsing array");
+            token.type = TOKEN_END;
+            return token;
+        }
+        if (context == '{' && expectKey) {
+            if (c == '}') {
+                pos++;
+                stack.pop_back();
+                endValue();
+                token.type = TOKEN_END_OBJECT;
+                return token;
+            }
+            if (c == ':') fail(": found where field expected");
+            if (c == '"') {
+                scanString();
+                token.quoted = true;
+            } else {
+                scanKey();
+            }
+            // the key text stays in the buffer while the separator is skipped
+            const size_t length = token.length;
+            size_t start = token.text - &buffer[0];
+            for (;;) {
+                while (buffer[pos] == ' ' || buffer[pos] == '\t' || buffer[pos] == '\r' || buffer[pos] == '\n') {
+                    if (buffer[pos] == '\n') {
+                        line++;
+                        lastbr = pos+1;
+                    }
+                    pos++;
+                }
+                if (buffer[pos] != '\0' || pos < limit || !refill(start)) break;
+            }
+            if (buffer[pos] != ':') fail("Expected : after field name");
+            pos++;
+            expectKey = false;
+            token.type = TOKEN_KEY;
+            token.text = &buffer[start];
+            token.length = length;
+            return token;
+        }
+        if (context == '[') {
+            if (c == ']') {
+                pos++;
+                stack.pop_back();
+                endValue();
+                token.type = TOKEN_END_ARRAY;
+                return token;
+            }
+            if (c == ':') { //non-json value repetition
+                pos++;
+                skip(false);
+                if (buffer[pos] < '0' || buffer[pos] > '9') fail("Array value repetition syntax error");
+                scanNumber(pos);
+                token.type = TOKEN_REPEAT;
+                return token;
+            }
+        }
+        if (context == '{' && c == '}') fail("} found where value expected");
+        switch (c) {
+            case '{':
+                pos++;
+                stack.push_back('{');
+                expectKey = true;
+                token.type = TOKEN_BEGIN_OBJECT;
+                return token;
+            case '[':
+                pos++;
+                stack.push_back('[');
+                token.type = TOKEN_BEGIN_ARRAY;
+                return token;
+            case '"':
+                scanString();
+                token.type = TOKEN_STRING;
+                break;
+            case '-':
+            case '+':
+            case '.':
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+                scanNumber(pos);
+                token.type = TOKEN_NUMBER;
+                break;
+            case 'n': //https://tools.ietf.org/rfc/rfc7159.txt
+                if (!ensure(4) || memcmp(&buffer[pos],"null",4)) fail("Unexpected character");
+                pos += 4;
+                token.type = TOKEN_NULL;
+                break;
+            case 't':
+                if (!ensure(4) || memcmp(&buffer[pos],"true",4)) fail("Unexpected character");
+                pos += 4;
+                token.type = TOKEN_TRUE;
+                break;
+            case 'f':
+                if (!ensure(5) || memcmp(&buffer[pos],"false",5)) fail("Unexpected character");
+                pos += 5;
+                token.type = TOKEN_FALSE;
+                break;
+            default:
+                fail("Unexpected character");
+        }
+        endValue();
+        return token;
+    }
+
+}
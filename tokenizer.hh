@@ -0,0 +1,119 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_TOKENIZER
+#define _JSON_TOKENIZER
+
+#include "json.hh"
+
+#include <istream>
+
+namespace json {
+
+    //Kinds of tokens in the RATDB/JSON dialect read by Reader
+    enum TokenType {
+        TOKEN_END,          //end of the input
+        TOKEN_BEGIN_OBJECT,
+        TOKEN_END_OBJECT,
+        TOKEN_BEGIN_ARRAY,
+        TOKEN_END_ARRAY,
+        TOKEN_KEY,          //a member name, quoted or bare (the following ':' is consumed)
+        TOKEN_STRING,
+        TOKEN_NUMBER,       //any number Reader accepts, including hex and u/d/f suffixes
+        TOKEN_TRUE,
+        TOKEN_FALSE,
+        TOKEN_NULL,
+        TOKEN_REPEAT        //the count of a non-json array value repetition [value : count]
+    };
+
+    struct Token {
+        TokenType type;
+        const char *text;   //characters of keys, strings (still escaped, without quotes), numbers and counts
+        size_t length;
+        bool quoted;        //true for keys that were quoted
+    };
+
+    //Splits a stream into tokens without building Values, using memory for the nesting and the longest token
+    //rather than the document. Comments and commas are skipped, and structure is checked as Reader would.
+    class Tokenizer {
+        public:
+            // Reads from the stream in chunks as tokens are requested
+            explicit Tokenizer(std::istream &in);
+
+            // Returns the next token, throwing a parser_error for malformed input. The text of the token is only
+            // valid until the next call.
+            const Token& next();
+
+            // Reads the next top level value and copies its text as it appears in the input (without surrounding
+            // whitespace and comments), checking its syntax. Returns false at the end of the input.
+            bool nextRecord(std::string &text);
+
+            // Number of arrays and objects open
+            inline size_t getDepth() const { return stack.size(); }
+
+            // Position of the last token for error messages
+            inline int getLine() const { return line; }
+            inline int getColumn() const { return (int)((long)pos - lastbr); }
+
+            // Bytes read per chunk
+            static const size_t CHUNK = 1 << 16;
+
+        protected:
+            std::istream &in;
+
+            //Unread input in buffer[pos,limit), followed by a NUL sentinel. While marking, refills also keep the
+            //input from mark, the start of the record being read by nextRecord.
+            std::vector<char> buffer;
+            size_t pos, limit, mark;
+            bool marking;
+            long lastbr;
+            int line;
+
+            //Open containers ('{' or '[') and whether an open object expects a key next
+            std::vector<char> stack;
+            bool expectKey;
+
+            Token token;
+
+            //Moves buffer[start,limit) (or from mark) to the front and reads another chunk after it, adjusting
+            //start. Returns the number of bytes read.
+            size_t refill(size_t &start);
+
+            //Skips whitespace and comments (and commas inside containers), refilling as needed
+            void skip(bool commas);
+
+            //Makes n bytes from pos available if the input has them
+            bool ensure(size_t n);
+
+            //Scans the rest of a token made of number characters starting at start
+            void scanNumber(size_t start);
+
+            //Scans a quoted string at pos into the token text
+            void scanString();
+
+            //Scans a bare member name at pos into the token text
+            void scanKey();
+
+            //Marks the end of a value in the enclosing container
+            inline void endValue() { if (!stack.empty() && stack.back() == '{') expectKey = true; }
+
+            void fail(const char *desc) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,7 @@
+#!/bin/bash
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o ratdbd  ../*.cc ratdbd.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o ratdbq  ../*.cc ratdbq.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o ratdbfmt  ../*.cc ratdbfmt.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o ratdbembed  ../*.cc ratdbembed.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o ratdbsort  ../*.cc ratdbsort.cc
+g++ -O4 -pedantic -Wall -std=c++11 -pthread -I ../ -o ratdbstat  ../*.cc ratdbstat.cc
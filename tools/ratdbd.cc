@@ -0,0 +1,39 @@
+#include <iostream>
+#include <csignal>
+
+#include "dbserver.hh"
+
+using namespace std;
+
+// Serves the tables of RATDB files to local clients until interrupted
+//     ratdbd /tmp/ratdb.sock file.ratdb [file.ratdb ...]
+
+json::DBServer *server = NULL;
+
+void shutdown(int signal) {
+	if (server) server->stop();
+}
+
+int main(int argc, char **argv) {
+
+	if (argc < 3) {
+		cerr << "usage: " << argv[0] << " socket file.ratdb [file.ratdb ...]\n";
+		return 1;
+	}
+	try {
+		json::DBServer db(argv[1]);
+		for (int i = 2; i < argc; i++) {
+			db.load(argv[i]);
+		}
+		db.freeze();
+		server = &db;
+		signal(SIGINT,shutdown);
+		signal(SIGTERM,shutdown);
+		db.run();
+		server = NULL;
+	} catch (exception &e) {
+		cerr << "ERROR: " << e.what() << '\n';
+		return 1;
+	}
+
+}
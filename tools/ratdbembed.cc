@@ -0,0 +1,88 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+#include "frozen.hh"
+
+using namespace std;
+
+// Compiles RATDB/JSON files into C++ source, so built-in tables need no parsing at startup. Each file becomes
+// a function returning a FrozenValue array of the values in the file, read in place from a constant frozen
+// buffer in the program's read-only data.
+//     ratdbembed [-n namespace] prefix file.ratdb [file.ratdb ...]
+// writes prefix.hh and prefix.cc
+
+// Name of the function for a file: its base name without extension as an identifier
+string identifier(const string &filename) {
+	string name = filename.substr(filename.rfind('/') == string::npos ? 0 : filename.rfind('/')+1);
+	name = name.substr(0,name.find('.'));
+	for (size_t i = 0; i < name.size(); i++) {
+		if (!isalnum((unsigned char)name[i])) name[i] = '_';
+	}
+	if (name.empty() || isdigit((unsigned char)name[0])) name = "_" + name;
+	return name;
+}
+
+int main(int argc, char **argv) {
+
+	string space = "ratdb";
+	int first = 1;
+	if (argc > 2 && !strcmp(argv[1],"-n")) {
+		space = argv[2];
+		first = 3;
+	}
+	if (argc - first < 2) {
+		cerr << "usage: " << argv[0] << " [-n namespace] prefix file.ratdb [file.ratdb ...]\n";
+		return 1;
+	}
+	const string prefix = argv[first];
+	const string base = prefix.substr(prefix.rfind('/') == string::npos ? 0 : prefix.rfind('/')+1);
+	string guard = "_EMBEDDED_" + identifier(base);
+	for (size_t i = 0; i < guard.size(); i++) guard[i] = toupper((unsigned char)guard[i]);
+
+	stringstream header, source;
+	header << "// Generated by ratdbembed, do not edit\n\n#ifndef " << guard << "\n#define " << guard << "\n\n#include \"frozen.hh\"\n\n"
+	       << "namespace " << space << " {\n\n";
+	source << "// Generated by ratdbembed, do not edit\n\n#include \"" << base << ".hh\"\n\nnamespace " << space << " {\n\n";
+
+	try {
+		for (int f = first+1; f < argc; f++) {
+			ifstream file(argv[f]);
+			if (!file) throw runtime_error(string("Could not open ") + argv[f]);
+			json::Reader reader(file);
+			json::Value values(json::TARRAY), value;
+			size_t count = 0;
+			while (reader.getValue(value)) {
+				values.setArraySize(count+1);
+				values.setIndex(count++,value);
+			}
+			const json::Frozen frozen(values);
+			const string name = identifier(argv[f]);
+
+			header << "    // Values of " << argv[f] << " as an array of " << count << "\n"
+			       << "    json::FrozenValue " << name << "();\n\n";
+
+			// whole words keep the buffer 8 byte aligned
+			const size_t words = (frozen.size() + 7)/8;
+			vector<uint64_t> data(words,0);
+			memcpy(&data[0],frozen.bytes(),frozen.size());
+			source << "    static const uint64_t " << name << "_data[" << words << "] = {";
+			for (size_t i = 0; i < words; i++) {
+				source << (i % 6 ? " " : "\n        ") << "0x" << hex << setw(16) << setfill('0') << data[i] << dec << "ull" << (i+1 < words ? "," : "");
+			}
+			source << "\n    };\n\n    json::FrozenValue " << name << "() {\n"
+			       << "        return json::Frozen::view((const char*)" << name << "_data," << frozen.size() << ");\n    }\n\n";
+		}
+	} catch (exception &e) {
+		cerr << "ERROR: " << e.what() << '\n';
+		return 1;
+	}
+
+	header << "}\n\n#endif\n";
+	source << "}\n";
+	ofstream(prefix + ".hh") << header.str();
+	ofstream(prefix + ".cc") << source.str();
+
+}
@@ -0,0 +1,50 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+#include "transcoder.hh"
+
+using namespace std;
+
+// Rewrites RATDB/JSON files as strict JSON (default) or reformatted RATDB without parsing them into Values
+//     ratdbfmt [-r keep RATDB syntax] [-x expand repetitions] [-m minify | -i spaces] [files...]
+
+int main(int argc, char **argv) {
+
+	json::TranscodeOptions options;
+	int first = 1;
+	for ( ; first < argc && argv[first][0] == '-' && argv[first][1]; first++) {
+		if (!strcmp(argv[first],"-r")) {
+			options.strict = false;
+		} else if (!strcmp(argv[first],"-x")) {
+			options.expand = true;
+		} else if (!strcmp(argv[first],"-m")) {
+			options.indent = 0;
+		} else if (!strcmp(argv[first],"-i") && first+1 < argc) {
+			options.indent = atoi(argv[++first]);
+		} else {
+			cerr << "usage: " << argv[0] << " [-r] [-x] [-m | -i spaces] [files...]\n";
+			return 1;
+		}
+	}
+	try {
+		if (first == argc) {
+			json::Transcoder transcoder(cin,cout,options);
+			transcoder.transcode();
+		}
+		for (int i = first; i < argc; i++) {
+			ifstream file(argv[i]);
+			if (!file) {
+				cerr << "ERROR: could not open " << argv[i] << '\n';
+				return 1;
+			}
+			json::Transcoder transcoder(file,cout,options);
+			transcoder.transcode();
+		}
+	} catch (json::parser_error &e) {
+		cerr << "ERROR: " << e.what() << '\n';
+		return 1;
+	}
+
+}
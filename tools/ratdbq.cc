@@ -0,0 +1,30 @@
+#include <iostream>
+
+#include "dbserver.hh"
+
+using namespace std;
+
+// Prints a table (or a path inside it) served by ratdbd
+//     ratdbq /tmp/ratdb.sock NAME [index] [path]
+
+int main(int argc, char **argv) {
+
+	if (argc < 3) {
+		cerr << "usage: " << argv[0] << " socket name [index] [path]\n";
+		return 1;
+	}
+	try {
+		json::DBClient db(argv[1]);
+		json::FrozenValue value = db.lookup(argv[2],argc > 3 ? argv[3] : "",argc > 4 ? argv[4] : "");
+		if (value.getType() == json::TNULL) {
+			cerr << "not found\n";
+			return 1;
+		}
+		json::Writer writer(cout);
+		writer.putValue(value.thaw());
+	} catch (exception &e) {
+		cerr << "ERROR: " << e.what() << '\n';
+		return 1;
+	}
+
+}
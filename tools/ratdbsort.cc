@@ -0,0 +1,62 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+#include "extsort.hh"
+
+using namespace std;
+
+// Sorts the records of RATDB/NDJSON files (or stdin) by a key path without holding them all in memory, writing
+// one JSON record per line, or one {"key","records","count"} object per distinct key with -g
+//     ratdbsort -k path [-r descending] [-g group] [-m megabytes] [-j threads] [-t tmpdir] [files...]
+
+int main(int argc, char **argv) {
+
+	json::SortOptions options;
+	bool keyed = false;
+	int first = 1;
+	for ( ; first < argc && argv[first][0] == '-' && argv[first][1]; first++) {
+		if (!strcmp(argv[first],"-k") && first+1 < argc) {
+			options.key = argv[++first];
+			keyed = true;
+		} else if (!strcmp(argv[first],"-r")) {
+			options.descending = true;
+		} else if (!strcmp(argv[first],"-g")) {
+			options.group = true;
+		} else if (!strcmp(argv[first],"-m") && first+1 < argc) {
+			options.memory = (size_t)atoi(argv[++first]) << 20;
+		} else if (!strcmp(argv[first],"-j") && first+1 < argc) {
+			options.threads = atoi(argv[++first]);
+		} else if (!strcmp(argv[first],"-t") && first+1 < argc) {
+			options.directory = argv[++first];
+		} else {
+			keyed = false;
+			break;
+		}
+	}
+	if (!keyed) {
+		cerr << "usage: " << argv[0] << " -k path [-r] [-g] [-m megabytes] [-j threads] [-t tmpdir] [files...]\n";
+		return 1;
+	}
+	try {
+		json::ExternalSort sort(options);
+		if (first == argc) sort.add(cin);
+		for (int i = first; i < argc; i++) {
+			ifstream file(argv[i]);
+			if (!file) {
+				cerr << "ERROR: could not open " << argv[i] << '\n';
+				return 1;
+			}
+			sort.add(file);
+		}
+		sort.write(cout);
+	} catch (json::parser_error &e) {
+		cerr << "ERROR: " << e.what() << '\n';
+		return 1;
+	} catch (runtime_error &e) {
+		cerr << "ERROR: " << e.what() << '\n';
+		return 1;
+	}
+
+}
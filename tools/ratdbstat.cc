@@ -0,0 +1,74 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+
+#include "sketch.hh"
+
+using namespace std;
+
+// Prints the distinct count, quantiles and most frequent values of fields of the records of RATDB/NDJSON files
+// (or stdin), reading each file on its own thread
+//     ratdbstat -f path [-f path...] [-n top] [files...]
+
+int main(int argc, char **argv) {
+
+	vector<string> paths;
+	json::SketchOptions options;
+	int first = 1;
+	for ( ; first < argc && argv[first][0] == '-' && argv[first][1]; first++) {
+		if (!strcmp(argv[first],"-f") && first+1 < argc) {
+			paths.push_back(argv[++first]);
+		} else if (!strcmp(argv[first],"-n") && first+1 < argc) {
+			options.top = atoi(argv[++first]);
+		} else {
+			paths.clear();
+			break;
+		}
+	}
+	if (paths.empty()) {
+		cerr << "usage: " << argv[0] << " -f path [-f path...] [-n top] [files...]\n";
+		return 1;
+	}
+	try {
+		json::FieldStatistics statistics(paths,options);
+		if (first == argc) statistics.add(cin);
+		vector<json::FieldStatistics> parts(argc-first,statistics);
+		vector<string> errors(parts.size());
+		vector<thread> threads;
+		for (size_t i = 0; i < parts.size(); i++) {
+			threads.push_back(thread([&,i]() {
+				ifstream file(argv[first+i]);
+				if (!file) {
+					errors[i] = string("could not open ") + argv[first+i];
+					return;
+				}
+				try {
+					parts[i].add(file);
+				} catch (json::parser_error &e) {
+					errors[i] = string(argv[first+i]) + ": " + e.what();
+				} catch (runtime_error &e) {
+					errors[i] = string(argv[first+i]) + ": " + e.what();
+				}
+			}));
+		}
+		for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+		for (size_t i = 0; i < parts.size(); i++) {
+			if (!errors[i].empty()) {
+				cerr << "ERROR: " << errors[i] << '\n';
+				return 1;
+			}
+			statistics.merge(parts[i]);
+		}
+		json::Writer writer(cout);
+		writer.putValue(statistics.summary());
+	} catch (json::parser_error &e) {
+		cerr << "ERROR: " << e.what() << '\n';
+		return 1;
+	} catch (runtime_error &e) {
+		cerr << "ERROR: " << e.what() << '\n';
+		return 1;
+	}
+
+}
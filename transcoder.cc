@@ -0,0 +1,309 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transcoder.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+
+namespace json {
+
+    static const size_t NONE = (size_t)-1;
+
+    //https://tools.ietf.org/rfc/rfc7159.txt -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    static bool isJSONNumber(const char *text, size_t length) {
+        const char *c = text, *end = text + length;
+        if (c < end && *c == '-') c++;
+        if (c == end) return false;
+        if (*c == '0') {
+            c++;
+        } else if (*c >= '1' && *c <= '9') {
+            while (c < end && *c >= '0' && *c <= '9') c++;
+        } else {
+            return false;
+        }
+        if (c < end && *c == '.') {
+            const char *digits = ++c;
+            while (c < end && *c >= '0' && *c <= '9') c++;
+            if (c == digits) return false;
+        }
+        if (c < end && (*c == 'e' || *c == 'E')) {
+            c++;
+            if (c < end && (*c == '+' || *c == '-')) c++;
+            const char *digits = c;
+            while (c < end && *c >= '0' && *c <= '9') c++;
+            if (c == digits) return false;
+        }
+        return c == end;
+    }
+
+    Transcoder::Transcoder(std::istream &in, std::ostream &out_, const TranscodeOptions &options_) : tokens(in), out(out_), options(options_), objects(0) {
+        expand = options.strict || options.expand;
+        buffer.resize(2*FLUSH_BYTES);
+        used = 0;
+    }
+
+    Transcoder::~Transcoder() {
+        out.write(&buffer[0],used);
+        out.flush();
+    }
+
+    void Transcoder::fail(const char *desc) const {
+        throw parser_error(tokens.getLine(),tokens.getColumn(),desc);
+    }
+
+    size_t Transcoder::transcode() {
+        size_t count = 0;
+        while (transcodeValue()) count++;
+        return count;
+    }
+
+    bool Transcoder::transcodeValue() {
+        do {
+            const Token &token = tokens.next();
+            switch (token.type) {
+                case TOKEN_END:
+                    return false;
+                case TOKEN_BEGIN_OBJECT: {
+                    beginValue();
+                    put('{');
+                    const Level level = { true, 0, NONE, NONE };
+                    levels.push_back(level);
+                    objects++;
+                    break;
+                }
+                case TOKEN_END_OBJECT:
+                    objects--;
+                    if (levels.back().count) newline(objects);
+                    put('}');
+                    levels.pop_back();
+                    break;
+                case TOKEN_BEGIN_ARRAY: {
+                    beginValue();
+                    put('[');
+                    const Level level = { false, 0, NONE, NONE };
+                    levels.push_back(level);
+                    break;
+                }
+                case TOKEN_END_ARRAY:
+                    put(']');
+                    levels.pop_back();
+                    break;
+                case TOKEN_KEY:
+                    if (levels.back().count++) put(',');
+                    newline(objects);
+                    writeKey(token);
+                    put(options.indent ? " : " : ":");
+                    break;
+                case TOKEN_STRING:
+                    beginValue();
+                    put('"');
+                    writeString(token.text,token.length);
+                    put('"');
+                    break;
+                case TOKEN_NUMBER:
+                    beginValue();
+                    writeNumber(token);
+                    break;
+                case TOKEN_TRUE:
+                    beginValue();
+                    put("true");
+                    break;
+                case TOKEN_FALSE:
+                    beginValue();
+                    put("false");
+                    break;
+                case TOKEN_NULL:
+                    beginValue();
+                    put("null");
+                    break;
+                case TOKEN_REPEAT:
+                    repeat(token);
+                    break;
+            }
+            if (used >= FLUSH_BYTES) flush();
+        } while (!levels.empty());
+        put('\n');
+        return true;
+    }
+
+    void Transcoder::beginValue() {
+        if (levels.empty() || levels.back().object) return;
+        Level &level = levels.back();
+        level.separator = used;
+        if (level.count++) put(options.indent ? ", " : ",");
+        level.element = used;
+    }
+
+    void Transcoder::newline(size_t depth) {
+        if (!options.indent) return;
+        put('\n');
+        for (size_t i = depth*options.indent; i; i--) put(' ');
+    }
+
+    void Transcoder::writeKey(const Token &token) {
+        if (!token.quoted && !options.strict) {
+            put(token.text,token.length);
+            return;
+        }
+        put('"');
+        if (token.quoted) {
+            writeString(token.text,token.length);
+        } else {
+            // bare keys are literal text
+            for (size_t i = 0; i < token.length; i++) {
+                const char c = token.text[i];
+                if (c == '"' || c == '\\') put('\\');
+                put(c);
+            }
+        }
+        put('"');
+    }
+
+    void Transcoder::writeString(const char *text, size_t length) {
+        if (!options.strict) {
+            put(text,length);
+            return;
+        }
+        // strings are copied in runs between the control characters JSON requires to be escaped
+        size_t last = 0;
+        for (size_t i = 0; i < length; i++) {
+            const unsigned char c = text[i];
+            if (c >= 0x20) continue;
+            put(text+last,i-last);
+            last = i+1;
+            switch (c) {
+                case '\b': put("\\b"); break;
+                case '\f': put("\\f"); break;
+                case '\n': put("\\n"); break;
+                case '\r': put("\\r"); break;
+                case '\t': put("\\t"); break;
+                default: {
+                    char escape[8];
+                    snprintf(escape,sizeof(escape),"\\u%04x",c);
+                    put(escape);
+                }
+            }
+        }
+        put(text+last,length-last);
+    }
+
+    void Transcoder::writeNumber(const Token &token) {
+        if (!options.strict || isJSONNumber(token.text,token.length)) {
+            put(token.text,token.length);
+            return;
+        }
+        // converted with the rules of Reader::readNumber
+        std::string number(token.text,token.length);
+        const char last = number[number.size()-1];
+        char *end;
+        char text[32];
+        errno = 0;
+        if (number.size() > 2 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X')) {
+            const TUInteger ui = strtoul(number.c_str()+2,&end,16);
+            if (*end || errno == ERANGE) fail("Malformed hex number");
+            snprintf(text,sizeof(text),"%lu",ui);
+        } else if (last == 'u') {
+            number.erase(number.size()-1);
+            const TUInteger ui = strtoul(number.c_str(),&end,10);
+            if (*end || number.empty() || errno == ERANGE) fail("Malformed integer");
+            snprintf(text,sizeof(text),"%lu",ui);
+        } else if (number.find_first_of(".edf") != std::string::npos) {
+            if (last == 'd' || last == 'f') number.erase(number.size()-1);
+            const size_t d = number.find('d');
+            if (d != std::string::npos) number[d] = 'e'; //the strange exponential
+            const TReal real = strtod(number.c_str(),&end);
+            if (*end || number.empty()) fail("Malformed real");
+            if (std::isinf(real) || std::isnan(real)) fail("Real has no JSON representation");
+            snprintf(text,sizeof(text),"%.17g",real);
+            if (!strpbrk(text,".e")) strcat(text,".0"); //stays a real when read back
+        } else {
+            const TInteger i = strtol(number.c_str(),&end,10);
+            if (*end || number.empty()) fail("Malformed integer");
+            if (errno == ERANGE && i == LONG_MIN) fail("Signed integer out of bounds.");
+            if (errno == ERANGE) {
+                errno = 0;
+                const TUInteger ui = strtoul(number.c_str(),NULL,10);
+                if (errno == ERANGE) fail("Unsigned integer out of bounds.");
+                snprintf(text,sizeof(text),"%lu",ui);
+            } else {
+                snprintf(text,sizeof(text),"%ld",i);
+            }
+        }
+        put(text);
+    }
+
+    void Transcoder::repeat(const Token &token) {
+        Level &level = levels.back();
+        char *end;
+        const std::string count(token.text,token.length);
+        errno = 0;
+        const TInteger nreps = strtol(count.c_str(),&end,10);
+        if (*end || nreps < 0 || errno == ERANGE || level.count == 0) fail("Array value repetition syntax error");
+        if (!expand) {
+            put(options.indent ? " : " : ":");
+            put(count.data(),count.size());
+            return;
+        }
+        if (level.element == NONE) fail("Repeated value too large to expand while streaming");
+        // The value to be repeated has already been written once
+        if (nreps == 0) {
+            used = level.separator;
+            level.count--;
+            level.element = NONE;
+            return;
+        }
+        const std::string element(&buffer[level.element],used-level.element);
+        const char *separator = options.indent ? ", " : ",";
+        for (TInteger i = 1; i < nreps; i++) {
+            level.separator = used;
+            put(separator);
+            level.element = used;
+            put(element.data(),element.size());
+            if (used >= FLUSH_BYTES) flush();
+        }
+        level.count += nreps-1;
+    }
+
+    void Transcoder::flush() {
+        size_t keep = used;
+        if (expand) {
+            for (size_t i = 0; i < levels.size(); i++) {
+                Level &level = levels[i];
+                if (level.element == NONE) continue;
+                if (used - level.separator > REPEAT_BYTES) {
+                    level.element = NONE;
+                } else if (level.separator < keep) {
+                    keep = level.separator;
+                }
+            }
+        }
+        out.write(&buffer[0],keep);
+        memmove(&buffer[0],&buffer[keep],used-keep);
+        used -= keep;
+        for (size_t i = 0; i < levels.size(); i++) {
+            if (levels[i].element == NONE) continue;
+            levels[i].separator -= keep;
+            levels[i].element -= keep;
+        }
+    }
+
+}
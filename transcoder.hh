@@ -0,0 +1,110 @@
+/**
+ *  Copyright 2014 by Benjamin Land (a.k.a. BenLand100)
+ *
+ *  fastjson is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  fastjson is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with fastjson. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSON_TRANSCODER
+#define _JSON_TRANSCODER
+
+#include "tokenizer.hh"
+
+#include <ostream>
+#include <cstring>
+
+namespace json {
+
+    //How a Transcoder rewrites its input
+    struct TranscodeOptions {
+        bool strict;            //write strict JSON: quote keys, convert hex and u/d/f numbers, expand repetitions
+        bool expand;            //expand [value : count] repetitions even when not strict
+        unsigned int indent;    //spaces per object level, or zero to minify
+
+        TranscodeOptions() : strict(true), expand(false), indent(4) { }
+    };
+
+    //Rewrites RATDB/JSON text token by token without building Values, so memory does not grow with the document.
+    //Comments are dropped, and pretty output puts one object member per line and arrays on one line like Writer.
+    //Each top level value is followed by a newline.
+    class Transcoder {
+        public:
+            Transcoder(std::istream &in, std::ostream &out, const TranscodeOptions &options = TranscodeOptions());
+
+            // Flushes the output
+            ~Transcoder();
+
+            // Rewrites the next top level value, returning false at the end of the input
+            bool transcodeValue();
+
+            // Rewrites all remaining values and returns how many there were
+            size_t transcode();
+
+            // Output is written in pieces of about this size
+            static const size_t FLUSH_BYTES = 1 << 16;
+
+            // Largest repeated value that can be expanded, since it must still be in the output buffer when its
+            // count is read (larger ones throw a parser_error)
+            static const size_t REPEAT_BYTES = 1 << 16;
+
+        protected:
+            Tokenizer tokens;
+            std::ostream &out;
+            TranscodeOptions options;
+            bool expand;
+
+            //Output not yet written to the stream in buffer[0,used)
+            std::vector<char> buffer;
+            size_t used;
+
+            //Appends to the buffer (cheaper than appending to a std::string for short tokens)
+            inline void put(const char *text, size_t length) {
+                if (used + length > buffer.size()) buffer.resize(2*(used + length));
+                memcpy(&buffer[used],text,length);
+                used += length;
+            }
+            inline void put(const char *text) { put(text,strlen(text)); }
+            inline void put(char c) {
+                if (used == buffer.size()) buffer.resize(2*used);
+                buffer[used++] = c;
+            }
+
+            //An open container with the buffer offsets of the separator and text of its last element (if still
+            //buffered) for repetitions
+            struct Level {
+                bool object;
+                size_t count, separator, element;
+            };
+            std::vector<Level> levels;
+            size_t objects;
+
+            //Starts a value inside an array (or at the top level) by writing a separator
+            void beginValue();
+
+            //Writes a newline and the indentation of the open objects
+            void newline(size_t depth);
+
+            void writeKey(const Token &token);
+            void writeString(const char *text, size_t length);
+            void writeNumber(const Token &token);
+            void repeat(const Token &token);
+
+            //Writes the buffer to the stream, keeping repeatable elements
+            void flush();
+
+            void fail(const char *desc) const;
+    };
+
+}
+
+#endif